@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+#include "../Culling.h"
+
+// Times CullSpheres() against a plain scalar loop on a fixed, seeded scene, so runs on different machines cull the same spheres.
+// Usage: CullingBenchmark [sphere count = 100000] [repetitions = 200]
+
+namespace
+{
+	constexpr unsigned int SCENE_SEED = 20240611;
+
+	void CullSpheresScalar(const Frustum& frustum, const std::vector<glm::vec4>& spheres, std::vector<uint32_t>& visible)
+	{
+		visible.clear();
+		for (size_t i = 0; i < spheres.size(); ++i)
+		{
+			const auto& sphere = spheres[i];
+			auto is_inside = true;
+			for (const auto& plane : frustum.Planes)
+				is_inside = is_inside && plane.x * sphere.x + plane.w + plane.y * sphere.y + plane.z * sphere.z + sphere.w >= 0.0f;
+
+			if (is_inside) visible.emplace_back(static_cast<uint32_t>(i));
+		}
+	}
+
+	template <typename Function>
+	std::pair<double, double> Measure(size_t repetitionCount, Function&& function)
+	{
+		using namespace std::chrono;
+
+		// One untimed pass brings the spheres into cache and grows the output.
+		function();
+
+		auto total = 0.0;
+		auto best = std::numeric_limits<double>::max();
+		for (size_t i = 0; i < repetitionCount; ++i)
+		{
+			auto start = steady_clock::now();
+			function();
+			auto elapsed = duration<double, std::milli>(steady_clock::now() - start).count();
+			total += elapsed;
+			best = std::min(best, elapsed);
+		}
+
+		return { total / static_cast<double>(repetitionCount), best };
+	}
+}
+
+int main(int argc, char** argv)
+{
+	auto sphere_count = argc > 1 ? static_cast<size_t>(std::strtoull(argv[1], nullptr, 10)) : size_t(100000);
+	auto repetition_count = std::max<size_t>(argc > 2 ? static_cast<size_t>(std::strtoull(argv[2], nullptr, 10)) : size_t(200), 1);
+
+	// Spheres spread through a 2 km cube around a camera with a 60 degree field of view, which leaves roughly a tenth of them visible.
+	auto random = std::mt19937(SCENE_SEED);
+	auto position = std::uniform_real_distribution<float>(-1000.0f, 1000.0f);
+	auto radius = std::uniform_real_distribution<float>(0.5f, 5.0f);
+	auto spheres = std::vector<glm::vec4>();
+	auto bounds = CullingBounds();
+	spheres.reserve(sphere_count);
+	for (size_t i = 0; i < sphere_count; ++i)
+	{
+		auto& sphere = spheres.emplace_back(position(random), position(random), position(random), radius(random));
+		bounds.Add(sphere);
+	}
+
+	auto view = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	auto projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+	auto frustum = Frustum::FromViewProjection(projection * view);
+
+	auto visible = std::vector<uint32_t>();
+	auto reference = std::vector<uint32_t>();
+	auto [simd_average, simd_best] = Measure(repetition_count, [&]() { CullSpheres(frustum, bounds, visible); });
+	auto [scalar_average, scalar_best] = Measure(repetition_count, [&]() { CullSpheresScalar(frustum, spheres, reference); });
+
+	std::cout << sphere_count << " spheres, " << repetition_count << " repetitions, " << visible.size() << " visible\n";
+	std::cout << std::setw(10) << "kernel" << std::setw(12) << "avg ms" << std::setw(12) << "best ms" << std::setw(14) << "ns/sphere" << '\n';
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << std::setw(10) << "simd" << std::setw(12) << simd_average << std::setw(12) << simd_best << std::setw(14) << simd_average * 1.0e6 / static_cast<double>(sphere_count) << '\n';
+	std::cout << std::setw(10) << "scalar" << std::setw(12) << scalar_average << std::setw(12) << scalar_best << std::setw(14) << scalar_average * 1.0e6 / static_cast<double>(sphere_count) << '\n';
+	std::cout << "speedup " << scalar_average / simd_average << "x\n";
+
+	// The kernels may sum the plane terms in a different order, so a sphere grazing a plane can land on either side.
+	auto mismatches = std::vector<uint32_t>();
+	std::set_symmetric_difference(visible.begin(), visible.end(), reference.begin(), reference.end(), std::back_inserter(mismatches));
+	std::cout << mismatches.size() << " spheres classified differently by the two kernels\n";
+
+	return 0;
+}
@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "../GLVK/WindowGLVK.h"
+#include "../GLVK/VK/GraphicsEngineVK.h"
+#include "../Interfaces/IResourceManager.h"
+
+// Times secondary command buffer recording of an unbatched draw list across worker counts.
+// Usage: RecordingBenchmark [draw count = 10000] [repetitions = 20]
+
+int main(int argc, char** argv)
+{
+	auto draw_count = argc > 1 ? static_cast<size_t>(std::strtoull(argv[1], nullptr, 10)) : size_t(10000);
+	auto repetition_count = argc > 2 ? static_cast<size_t>(std::strtoull(argv[2], nullptr, 10)) : size_t(20);
+
+	// Powers of two up to the hardware thread count, and the thread count itself.
+	auto hardware_threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	auto worker_counts = std::vector<size_t>();
+	for (size_t count = 1; count < hardware_threads; count *= 2)
+		worker_counts.emplace_back(count);
+	worker_counts.emplace_back(hardware_threads);
+
+	auto window = std::make_unique<GLVK::Window>(L"Recording Benchmark", 640, 480, false);
+	auto resource_manager = std::make_unique<IResourceManager>();
+	auto graphics = std::unique_ptr<GLVK::VK::GraphicsEngine>();
+	auto exit_code = 0;
+
+	try
+	{
+		window->Initialize();
+		graphics = std::make_unique<GLVK::VK::GraphicsEngine>(reinterpret_cast<GLFWwindow*>(window->GetHandle()), window->GetWidth(), window->GetHeight(), resource_manager.get());
+		window->Setup(graphics.get());
+		graphics->CreateMesh(PrimitiveType::Cube, Vector3::Zero(), Vector3(1.0f), Vector3::Zero(), Vector4(1.0f));
+		graphics->Initialize();
+
+		auto results = graphics->BenchmarkRecording(draw_count, worker_counts, std::max<size_t>(repetition_count, 1));
+		auto single_worker = results.front().AverageMilliseconds;
+
+		std::cout << draw_count << " draws, " << repetition_count << " repetitions\n";
+		std::cout << std::setw(8) << "workers" << std::setw(8) << "slices" << std::setw(12) << "avg ms" << std::setw(12) << "best ms" << std::setw(10) << "speedup" << '\n';
+		std::cout << std::fixed << std::setprecision(3);
+		for (const auto& result : results)
+		{
+			std::cout << std::setw(8) << result.WorkerCount << std::setw(8) << result.SliceCount << std::setw(12) << result.AverageMilliseconds
+				<< std::setw(12) << result.BestMilliseconds << std::setw(10) << single_worker / result.AverageMilliseconds << '\n';
+		}
+	}
+	catch (const std::exception& ex)
+	{
+		std::cout << ex.what() << '\n';
+		exit_code = 1;
+	}
+
+	resource_manager.reset();
+	graphics.reset();
+	window.reset();
+	return exit_code;
+}
@@ -34,6 +34,11 @@ void Camera::Update(const Vector3& playerPos, float playerAngle)
 	}
 }
 
+Frustum Camera::GetFrustum() const noexcept
+{
+	return Frustum::FromViewProjection(GetProjectionMatrix<glm::mat4>() * GetViewMatrix<glm::mat4>());
+}
+
 void Camera::Watch(const Vector3& playerPos)
 {
 	Position = Vector3(0.0f, 10.0f, -15.0f);
@@ -2,6 +2,7 @@
 #include <DirectXMath.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include <type_traits>
+#include "Culling.h"
 #include "Structures/Vertex.h"
 
 class Camera
@@ -30,6 +31,11 @@ public:
 	template <typename T = glm::mat4>
 	T GetProjectionMatrix() const noexcept;
 
+	/// <summary>
+	/// The world space frustum of the current view and perspective projection.
+	/// </summary>
+	Frustum GetFrustum() const noexcept;
+
 	Vector3 Position = Vector3::Zero();
 	Vector3 Target = Vector3::Zero();
 	ProjectionObject Projection;
@@ -0,0 +1,173 @@
+#include "Culling.h"
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CULLING_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CULLING_SSE
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define CULLING_NEON
+#endif
+
+#if defined(max)
+#undef max
+#endif
+
+namespace
+{
+	void AddVisible(std::vector<uint32_t>& visible, size_t first, unsigned int mask)
+	{
+		while (mask != 0)
+		{
+			visible.emplace_back(static_cast<uint32_t>(first + std::countr_zero(mask)));
+			mask &= mask - 1;
+		}
+	}
+}
+
+Frustum Frustum::FromViewProjection(const glm::mat4& viewProjection) noexcept
+{
+	// Each plane is a sum or difference of rows of the matrix; glm stores columns, so row i is [0][i]..[3][i].
+	auto row = [&viewProjection](int i) {
+		return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	};
+
+	// Clip space depth runs from 0 to 1 (GLM_FORCE_DEPTH_ZERO_TO_ONE), so the near plane is the third row on its own.
+	auto frustum = Frustum();
+	frustum.Planes = {
+		row(3) + row(0), row(3) - row(0),
+		row(3) + row(1), row(3) - row(1),
+		row(2), row(3) - row(2)
+	};
+
+	for (auto& plane : frustum.Planes)
+		plane /= glm::length(glm::vec3(plane));
+
+	return frustum;
+}
+
+void CullingBounds::Clear() noexcept
+{
+	m_centerX.clear();
+	m_centerY.clear();
+	m_centerZ.clear();
+	m_radius.clear();
+	m_count = 0;
+}
+
+void CullingBounds::Add(const glm::vec4& sphere)
+{
+	// Grow a whole block at a time; the unused tail has a negative infinite radius and fails every plane test.
+	if (m_count == m_radius.size())
+	{
+		auto size = m_count + LANE_COUNT;
+		m_centerX.resize(size, 0.0f);
+		m_centerY.resize(size, 0.0f);
+		m_centerZ.resize(size, 0.0f);
+		m_radius.resize(size, std::numeric_limits<float>::lowest());
+	}
+
+	m_centerX[m_count] = sphere.x;
+	m_centerY[m_count] = sphere.y;
+	m_centerZ[m_count] = sphere.z;
+	m_radius[m_count] = sphere.w;
+	++m_count;
+}
+
+glm::vec4 TransformBoundingSphere(const BoundingSphere& sphere, const glm::mat4& world) noexcept
+{
+	if (!sphere.IsValid()) return glm::vec4(0.0f, 0.0f, 0.0f, std::numeric_limits<float>::max());
+
+	auto center = world * glm::vec4(sphere.Center.x, sphere.Center.y, sphere.Center.z, 1.0f);
+	auto scale = std::max({ glm::length(glm::vec3(world[0])), glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2])) });
+
+	return glm::vec4(glm::vec3(center), sphere.Radius * scale);
+}
+
+void CullSpheres(const Frustum& frustum, const CullingBounds& bounds, std::vector<uint32_t>& visible)
+{
+	// A sphere is outside when its center lies further than its radius behind any plane: dot(plane.xyz, center) + plane.w + radius < 0.
+	visible.clear();
+	visible.reserve(bounds.GetCount());
+
+	const auto* center_x = bounds.GetCenterX();
+	const auto* center_y = bounds.GetCenterY();
+	const auto* center_z = bounds.GetCenterZ();
+	const auto* radius = bounds.GetRadius();
+	const auto& planes = frustum.Planes;
+	auto count = bounds.GetPaddedCount();
+
+#if defined(CULLING_AVX)
+	for (size_t i = 0; i < count; i += 8)
+	{
+		auto x = _mm256_loadu_ps(center_x + i);
+		auto y = _mm256_loadu_ps(center_y + i);
+		auto z = _mm256_loadu_ps(center_z + i);
+		auto r = _mm256_loadu_ps(radius + i);
+		auto inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+		for (const auto& plane : planes)
+		{
+			auto distance = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane.x)), _mm256_set1_ps(plane.w));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(y, _mm256_set1_ps(plane.y)));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(z, _mm256_set1_ps(plane.z)));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, r), _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+
+		AddVisible(visible, i, static_cast<unsigned int>(_mm256_movemask_ps(inside)));
+	}
+#elif defined(CULLING_SSE)
+	for (size_t i = 0; i < count; i += 4)
+	{
+		auto x = _mm_loadu_ps(center_x + i);
+		auto y = _mm_loadu_ps(center_y + i);
+		auto z = _mm_loadu_ps(center_z + i);
+		auto r = _mm_loadu_ps(radius + i);
+		auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+		for (const auto& plane : planes)
+		{
+			auto distance = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_set1_ps(plane.w));
+			distance = _mm_add_ps(distance, _mm_mul_ps(y, _mm_set1_ps(plane.y)));
+			distance = _mm_add_ps(distance, _mm_mul_ps(z, _mm_set1_ps(plane.z)));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, r), _mm_setzero_ps()));
+		}
+
+		AddVisible(visible, i, static_cast<unsigned int>(_mm_movemask_ps(inside)));
+	}
+#elif defined(CULLING_NEON)
+	for (size_t i = 0; i < count; i += 4)
+	{
+		auto x = vld1q_f32(center_x + i);
+		auto y = vld1q_f32(center_y + i);
+		auto z = vld1q_f32(center_z + i);
+		auto r = vld1q_f32(radius + i);
+		auto inside = vdupq_n_u32(0xffffffffu);
+
+		for (const auto& plane : planes)
+		{
+			auto distance = vmlaq_n_f32(vaddq_f32(r, vdupq_n_f32(plane.w)), x, plane.x);
+			distance = vmlaq_n_f32(distance, y, plane.y);
+			distance = vmlaq_n_f32(distance, z, plane.z);
+			inside = vandq_u32(inside, vcgeq_f32(distance, vdupq_n_f32(0.0f)));
+		}
+
+		auto mask = (vgetq_lane_u32(inside, 0) & 1u) | (vgetq_lane_u32(inside, 1) & 2u) | (vgetq_lane_u32(inside, 2) & 4u) | (vgetq_lane_u32(inside, 3) & 8u);
+		AddVisible(visible, i, mask);
+	}
+#else
+	for (size_t i = 0; i < count; ++i)
+	{
+		auto is_inside = std::all_of(planes.cbegin(), planes.cend(), [&](const glm::vec4& plane) {
+			return plane.x * center_x[i] + plane.y * center_y[i] + plane.z * center_z[i] + plane.w + radius[i] >= 0.0f;
+			});
+
+		if (is_inside) visible.emplace_back(static_cast<uint32_t>(i));
+	}
+#endif
+}
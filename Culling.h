@@ -0,0 +1,81 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "Structures/MeshData.h"
+#include "Structures/Vertex.h"
+
+/// <summary>
+/// The six planes of a view frustum, normalized and pointing inwards: left, right, bottom, top, near, far.
+/// </summary>
+struct Frustum
+{
+	std::array<glm::vec4, 6> Planes = {};
+
+	/// <summary>
+	/// Extract the planes from a projection * view matrix, or projection * view * world to get them in object space.
+	/// </summary>
+	static Frustum FromViewProjection(const glm::mat4& viewProjection) noexcept;
+};
+
+/// <summary>
+/// World space bounding spheres stored as separate arrays per component, so the culling kernel can load a full SIMD register per component.
+/// The arrays are padded to a multiple of LANE_COUNT with spheres that are always culled.
+/// </summary>
+class CullingBounds
+{
+public:
+	inline static constexpr size_t LANE_COUNT = 8;
+
+	void Clear() noexcept;
+	void Add(const glm::vec4& sphere);
+
+	[[nodiscard]] size_t GetCount() const noexcept
+	{
+		return m_count;
+	}
+
+	[[nodiscard]] const float* GetCenterX() const noexcept
+	{
+		return m_centerX.data();
+	}
+
+	[[nodiscard]] const float* GetCenterY() const noexcept
+	{
+		return m_centerY.data();
+	}
+
+	[[nodiscard]] const float* GetCenterZ() const noexcept
+	{
+		return m_centerZ.data();
+	}
+
+	[[nodiscard]] const float* GetRadius() const noexcept
+	{
+		return m_radius.data();
+	}
+
+	[[nodiscard]] size_t GetPaddedCount() const noexcept
+	{
+		return m_radius.size();
+	}
+
+private:
+	std::vector<float> m_centerX;
+	std::vector<float> m_centerY;
+	std::vector<float> m_centerZ;
+	std::vector<float> m_radius;
+	size_t m_count = 0;
+};
+
+/// <summary>
+/// Move a mesh's object space bounding sphere into world space (xyz center, w radius). The radius grows with the largest axis scale,
+/// and a mesh without a valid sphere gets an infinite one so it is never culled.
+/// </summary>
+glm::vec4 TransformBoundingSphere(const BoundingSphere& sphere, const glm::mat4& world) noexcept;
+
+/// <summary>
+/// Test every sphere in bounds against the frustum and write the indices of those that are at least partly inside into visible, in ascending order.
+/// Uses AVX, SSE2 or NEON when the target has them, with a scalar loop as fallback.
+/// </summary>
+void CullSpheres(const Frustum& frustum, const CullingBounds& bounds, std::vector<uint32_t>& visible);
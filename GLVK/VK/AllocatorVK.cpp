@@ -0,0 +1,381 @@
+#include "AllocatorVK.h"
+#include <algorithm>
+#include <iterator>
+#include "UtilsVK.h"
+#include "../../UtilsCommon.h"
+
+GLVK::VK::FreeList::FreeList(vk::DeviceSize capacity)
+	: m_capacity(capacity), m_freeBytes(capacity)
+{
+	if (capacity > 0)
+		m_freeRanges.emplace(0, capacity);
+}
+
+std::optional<vk::DeviceSize> GLVK::VK::FreeList::Allocate(vk::DeviceSize size, vk::DeviceSize alignment)
+{
+	for (auto iter = m_freeRanges.begin(); iter != m_freeRanges.end(); ++iter)
+	{
+		auto range_offset = iter->first;
+		auto range_size = iter->second;
+		auto aligned_offset = AlignUp(range_offset, alignment);
+		auto padding = aligned_offset - range_offset;
+
+		if (padding + size > range_size)
+			continue;
+
+		m_freeRanges.erase(iter);
+
+		if (padding > 0)
+			m_freeRanges.emplace(range_offset, padding);
+
+		auto remaining = range_size - padding - size;
+		if (remaining > 0)
+			m_freeRanges.emplace(aligned_offset + size, remaining);
+
+		m_freeBytes -= size;
+		return aligned_offset;
+	}
+
+	return std::nullopt;
+}
+
+void GLVK::VK::FreeList::Free(vk::DeviceSize offset, vk::DeviceSize size)
+{
+	m_freeBytes += size;
+	auto next = m_freeRanges.lower_bound(offset);
+
+	if (next != m_freeRanges.begin())
+	{
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset)
+		{
+			offset = previous->first;
+			size += previous->second;
+			m_freeRanges.erase(previous);
+		}
+	}
+
+	if (next != m_freeRanges.end() && offset + size == next->first)
+	{
+		size += next->second;
+		m_freeRanges.erase(next);
+	}
+
+	m_freeRanges.emplace(offset, size);
+}
+
+vk::DeviceSize GLVK::VK::FreeList::GetLargestFreeRange() const noexcept
+{
+	vk::DeviceSize largest = 0;
+	for (const auto& range : m_freeRanges)
+		largest = std::max(largest, range.second);
+	return largest;
+}
+
+GLVK::VK::MemoryBlock::MemoryBlock(const vk::Device& device, uint32_t memoryTypeIndex, const vk::MemoryPropertyFlags& memoryProperties, vk::DeviceSize size, AllocationPool pool)
+	: m_logicalDevice(device), m_size(size), m_pool(pool)
+{
+	auto allocate_info = vk::MemoryAllocateInfo();
+	allocate_info.allocationSize = size;
+	allocate_info.memoryTypeIndex = memoryTypeIndex;
+	m_deviceMemory = m_logicalDevice.allocateMemory(allocate_info);
+
+	// Host visible blocks stay mapped for their whole lifetime; a VkDeviceMemory can only be mapped once,
+	// so every resource living in the block shares this pointer.
+	if (memoryProperties & vk::MemoryPropertyFlagBits::eHostVisible)
+		m_mappedData = m_logicalDevice.mapMemory(m_deviceMemory, 0, VK_WHOLE_SIZE);
+
+	if (m_pool == AllocationPool::FreeList)
+		m_freeList = std::make_unique<FreeList>(size);
+}
+
+GLVK::VK::MemoryBlock::~MemoryBlock()
+{
+	if (m_mappedData)
+		m_logicalDevice.unmapMemory(m_deviceMemory);
+
+	m_logicalDevice.freeMemory(m_deviceMemory);
+}
+
+std::optional<vk::DeviceSize> GLVK::VK::MemoryBlock::Allocate(vk::DeviceSize size, vk::DeviceSize alignment)
+{
+	auto offset = std::optional<vk::DeviceSize>();
+
+	if (m_pool == AllocationPool::FreeList)
+	{
+		offset = m_freeList->Allocate(size, alignment);
+	}
+	else
+	{
+		auto aligned_offset = AlignUp(m_linearHead, alignment);
+		if (aligned_offset + size <= m_size)
+		{
+			offset = aligned_offset;
+			m_linearHead = aligned_offset + size;
+		}
+	}
+
+	if (offset.has_value())
+	{
+		m_usedBytes += size;
+		++m_allocationCount;
+	}
+	return offset;
+}
+
+void GLVK::VK::MemoryBlock::Free(vk::DeviceSize offset, vk::DeviceSize size)
+{
+	if (m_pool == AllocationPool::FreeList)
+		m_freeList->Free(offset, size);
+
+	m_usedBytes -= size;
+	--m_allocationCount;
+
+	if (m_allocationCount == 0)
+		m_linearHead = 0;
+}
+
+vk::DeviceSize GLVK::VK::MemoryBlock::GetFreeBytes() const noexcept
+{
+	return m_pool == AllocationPool::FreeList ? m_freeList->GetFreeBytes() : m_size - m_linearHead;
+}
+
+vk::DeviceSize GLVK::VK::MemoryBlock::GetLargestFreeRange() const noexcept
+{
+	return m_pool == AllocationPool::FreeList ? m_freeList->GetLargestFreeRange() : m_size - m_linearHead;
+}
+
+GLVK::VK::Allocator::Allocator(const vk::Device& device, const vk::PhysicalDevice& physicalDevice, vk::DeviceSize blockSize)
+	: m_logicalDevice(device), m_blockSize(blockSize)
+{
+	m_memoryProperties = physicalDevice.getMemoryProperties();
+	m_nonCoherentAtomSize = std::max<vk::DeviceSize>(physicalDevice.getProperties().limits.nonCoherentAtomSize, 1);
+}
+
+GLVK::VK::Allocator::~Allocator()
+{
+	for (auto& allocation : m_dedicatedAllocations)
+	{
+		if (allocation.MappedData)
+			m_logicalDevice.unmapMemory(allocation.Memory);
+		m_logicalDevice.freeMemory(allocation.Memory);
+	}
+
+	m_dedicatedAllocations.clear();
+	m_blocks.clear();
+}
+
+GLVK::VK::Allocation GLVK::VK::Allocator::Allocate(const vk::MemoryRequirements& memoryRequirements, const vk::MemoryPropertyFlags& memoryProperties, AllocationPool pool, bool isImage, MemoryCategory category)
+{
+	auto memory_type_index = GetMemoryTypeIndex(memoryRequirements.memoryTypeBits, memoryProperties);
+	auto actual_properties = m_memoryProperties.memoryTypes[memory_type_index].propertyFlags;
+
+	// Flushes and invalidations of non-coherent memory work on whole atoms. Starting and ending every allocation on an atom
+	// boundary lets a range rounded out to atoms stay inside its own allocation.
+	auto requirements = memoryRequirements;
+	if ((actual_properties & vk::MemoryPropertyFlagBits::eHostVisible) && !(actual_properties & vk::MemoryPropertyFlagBits::eHostCoherent))
+	{
+		requirements.size = AlignUp(requirements.size, m_nonCoherentAtomSize);
+		requirements.alignment = std::max(requirements.alignment, m_nonCoherentAtomSize);
+	}
+
+	auto lock = std::lock_guard<std::mutex>{ m_mutex };
+	m_categoryUsage[static_cast<size_t>(category)] += requirements.size;
+
+	// Anything larger than half a block would leave most of the block unusable, so it gets its own allocation.
+	if (requirements.size > m_blockSize / 2)
+	{
+		auto dedicated = AllocateDedicated(requirements, memory_type_index);
+		dedicated.Category = category;
+		return dedicated;
+	}
+
+	auto& blocks = m_blocks[GetBlockKey(memory_type_index, pool, isImage)];
+
+	auto allocation = Allocation();
+	allocation.MemoryTypeIndex = memory_type_index;
+	allocation.MemoryProperties = actual_properties;
+	allocation.Size = requirements.size;
+	allocation.Category = category;
+
+	for (auto& block : blocks)
+	{
+		auto offset = block->Allocate(requirements.size, requirements.alignment);
+		if (!offset.has_value()) continue;
+
+		allocation.Block = block.get();
+		allocation.Memory = block->GetDeviceMemory();
+		allocation.Offset = offset.value();
+		break;
+	}
+
+	if (!allocation.Block)
+	{
+		auto& block = blocks.emplace_back(std::make_unique<MemoryBlock>(m_logicalDevice, memory_type_index, actual_properties, m_blockSize, pool));
+		allocation.Block = block.get();
+		allocation.Memory = block->GetDeviceMemory();
+		allocation.Offset = block->Allocate(requirements.size, requirements.alignment).value();
+	}
+
+	if (allocation.Block->GetMappedData())
+		allocation.MappedData = reinterpret_cast<uint8_t*>(allocation.Block->GetMappedData()) + allocation.Offset;
+
+	return allocation;
+}
+
+void GLVK::VK::Allocator::Free(Allocation& allocation)
+{
+	if (!allocation.IsValid()) return;
+
+	auto lock = std::lock_guard<std::mutex>{ m_mutex };
+	m_categoryUsage[static_cast<size_t>(allocation.Category)] -= allocation.Size;
+
+	if (allocation.IsDedicated())
+	{
+		auto iter = std::find_if(m_dedicatedAllocations.begin(), m_dedicatedAllocations.end(), [&](const Allocation& dedicated) {
+			return dedicated.Memory == allocation.Memory;
+			});
+
+		if (iter != m_dedicatedAllocations.end())
+		{
+			if (iter->MappedData)
+				m_logicalDevice.unmapMemory(iter->Memory);
+			m_logicalDevice.freeMemory(iter->Memory);
+			m_dedicatedAllocations.erase(iter);
+		}
+	}
+	else
+	{
+		allocation.Block->Free(allocation.Offset, allocation.Size);
+	}
+
+	allocation = Allocation();
+}
+
+GLVK::VK::AllocatorStatistics GLVK::VK::Allocator::GetStatistics() const
+{
+	auto lock = std::lock_guard<std::mutex>{ m_mutex };
+	auto statistics = AllocatorStatistics();
+
+	for (const auto& blocks : m_blocks)
+	{
+		for (const auto& block : blocks.second)
+			Accumulate(statistics, *block);
+	}
+
+	for (const auto& allocation : m_dedicatedAllocations)
+	{
+		++statistics.DedicatedAllocationCount;
+		++statistics.AllocationCount;
+		statistics.BytesReserved += allocation.Size;
+		statistics.BytesUsed += allocation.Size;
+	}
+
+	FinalizeStatistics(statistics);
+	return statistics;
+}
+
+GLVK::VK::AllocatorStatistics GLVK::VK::Allocator::GetStatistics(uint32_t memoryTypeIndex) const
+{
+	auto lock = std::lock_guard<std::mutex>{ m_mutex };
+	auto statistics = AllocatorStatistics();
+
+	for (const auto& blocks : m_blocks)
+	{
+		if ((blocks.first >> 8) != memoryTypeIndex) continue;
+		for (const auto& block : blocks.second)
+			Accumulate(statistics, *block);
+	}
+
+	for (const auto& allocation : m_dedicatedAllocations)
+	{
+		if (allocation.MemoryTypeIndex != memoryTypeIndex) continue;
+		++statistics.DedicatedAllocationCount;
+		++statistics.AllocationCount;
+		statistics.BytesReserved += allocation.Size;
+		statistics.BytesUsed += allocation.Size;
+	}
+
+	FinalizeStatistics(statistics);
+	return statistics;
+}
+
+uint32_t GLVK::VK::Allocator::GetMemoryTypeIndex(uint32_t memoryTypeBits, const vk::MemoryPropertyFlags& memoryProperties) const
+{
+	for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; ++i)
+	{
+		if ((memoryTypeBits & (1 << i)) &&
+			(m_memoryProperties.memoryTypes[i].propertyFlags & memoryProperties) == memoryProperties)
+		{
+			return i;
+		}
+	}
+
+	::ThrowIfFailed("Failed to find a suitable memory type.\n");
+	return 0;
+}
+
+GLVK::VK::MemoryCategoryUsage GLVK::VK::Allocator::GetCategoryUsage() const
+{
+	auto lock = std::lock_guard<std::mutex>{ m_mutex };
+	return m_categoryUsage;
+}
+
+std::vector<vk::DeviceSize> GLVK::VK::Allocator::GetHeapUsage() const
+{
+	auto lock = std::lock_guard<std::mutex>{ m_mutex };
+	auto heap_usage = std::vector<vk::DeviceSize>(m_memoryProperties.memoryHeapCount, 0);
+
+	for (const auto& blocks : m_blocks)
+	{
+		auto heap_index = m_memoryProperties.memoryTypes[static_cast<uint32_t>(blocks.first >> 8)].heapIndex;
+		for (const auto& block : blocks.second)
+			heap_usage[heap_index] += block->GetSize();
+	}
+
+	for (const auto& allocation : m_dedicatedAllocations)
+		heap_usage[m_memoryProperties.memoryTypes[allocation.MemoryTypeIndex].heapIndex] += allocation.Size;
+
+	return heap_usage;
+}
+
+void GLVK::VK::Allocator::Accumulate(AllocatorStatistics& statistics, const MemoryBlock& block) noexcept
+{
+	++statistics.BlockCount;
+	statistics.AllocationCount += block.GetAllocationCount();
+	statistics.BytesReserved += block.GetSize();
+	statistics.BytesUsed += block.GetUsedBytes();
+	statistics.BytesFree += block.GetFreeBytes();
+	statistics.LargestFreeRange = std::max(statistics.LargestFreeRange, block.GetLargestFreeRange());
+}
+
+void GLVK::VK::Allocator::FinalizeStatistics(AllocatorStatistics& statistics) noexcept
+{
+	if (statistics.BytesFree == 0)
+	{
+		statistics.Fragmentation = 0.0f;
+		return;
+	}
+
+	statistics.Fragmentation = 1.0f - static_cast<float>(statistics.LargestFreeRange) / static_cast<float>(statistics.BytesFree);
+}
+
+GLVK::VK::Allocation GLVK::VK::Allocator::AllocateDedicated(const vk::MemoryRequirements& requirements, uint32_t memoryTypeIndex)
+{
+	auto allocate_info = vk::MemoryAllocateInfo();
+	allocate_info.allocationSize = requirements.size;
+	allocate_info.memoryTypeIndex = memoryTypeIndex;
+
+	auto allocation = Allocation();
+	allocation.Memory = m_logicalDevice.allocateMemory(allocate_info);
+	allocation.MemoryTypeIndex = memoryTypeIndex;
+	allocation.MemoryProperties = m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+	allocation.Offset = 0;
+	allocation.Size = requirements.size;
+
+	if (allocation.MemoryProperties & vk::MemoryPropertyFlagBits::eHostVisible)
+		allocation.MappedData = m_logicalDevice.mapMemory(allocation.Memory, 0, VK_WHOLE_SIZE);
+
+	m_dedicatedAllocations.emplace_back(allocation);
+	return allocation;
+}
@@ -0,0 +1,206 @@
+#pragma once
+#include <array>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace GLVK
+{
+	namespace VK
+	{
+		enum class AllocationPool
+		{
+			FreeList, Linear
+		};
+
+		/// <summary>
+		/// What an allocation is used for, so memory pressure can be attributed and the right resources scaled down.
+		/// </summary>
+		enum class MemoryCategory
+		{
+			Other, Textures, Geometry, RenderTargets, Uniforms, Staging, Count
+		};
+
+		using MemoryCategoryUsage = std::array<vk::DeviceSize, static_cast<size_t>(MemoryCategory::Count)>;
+
+		/// <summary>
+		/// Offset based first-fit range allocator with coalescing of adjacent free ranges.
+		/// </summary>
+		class FreeList
+		{
+		public:
+			explicit FreeList(vk::DeviceSize capacity);
+
+			std::optional<vk::DeviceSize> Allocate(vk::DeviceSize size, vk::DeviceSize alignment);
+			void Free(vk::DeviceSize offset, vk::DeviceSize size);
+
+			[[nodiscard]] vk::DeviceSize GetCapacity() const noexcept
+			{
+				return m_capacity;
+			}
+
+			[[nodiscard]] vk::DeviceSize GetFreeBytes() const noexcept
+			{
+				return m_freeBytes;
+			}
+
+			[[nodiscard]] vk::DeviceSize GetLargestFreeRange() const noexcept;
+
+		private:
+			std::map<vk::DeviceSize, vk::DeviceSize> m_freeRanges;
+			vk::DeviceSize m_capacity = 0;
+			vk::DeviceSize m_freeBytes = 0;
+		};
+
+		class MemoryBlock;
+
+		struct Allocation
+		{
+			vk::DeviceMemory Memory = nullptr;
+			vk::DeviceSize Offset = 0;
+			vk::DeviceSize Size = 0;
+			uint32_t MemoryTypeIndex = 0;
+			vk::MemoryPropertyFlags MemoryProperties = {};
+			void* MappedData = nullptr;
+			MemoryBlock* Block = nullptr;
+			MemoryCategory Category = MemoryCategory::Other;
+
+			[[nodiscard]] bool IsValid() const noexcept
+			{
+				return static_cast<bool>(Memory);
+			}
+
+			[[nodiscard]] bool IsDedicated() const noexcept
+			{
+				return Block == nullptr;
+			}
+		};
+
+		struct AllocatorStatistics
+		{
+			size_t BlockCount = 0;
+			size_t DedicatedAllocationCount = 0;
+			size_t AllocationCount = 0;
+			vk::DeviceSize BytesReserved = 0;
+			vk::DeviceSize BytesUsed = 0;
+			vk::DeviceSize BytesFree = 0;
+			vk::DeviceSize LargestFreeRange = 0;
+
+			/// <summary>
+			/// 0 when all free space inside the blocks is one contiguous range, approaching 1 as it gets scattered.
+			/// </summary>
+			float Fragmentation = 0.0f;
+		};
+
+		/// <summary>
+		/// A single vkAllocateMemory call that is carved into many resources.
+		/// </summary>
+		class MemoryBlock
+		{
+		public:
+			MemoryBlock(const vk::Device& device, uint32_t memoryTypeIndex, const vk::MemoryPropertyFlags& memoryProperties, vk::DeviceSize size, AllocationPool pool);
+			~MemoryBlock();
+
+			std::optional<vk::DeviceSize> Allocate(vk::DeviceSize size, vk::DeviceSize alignment);
+			void Free(vk::DeviceSize offset, vk::DeviceSize size);
+
+			[[nodiscard]] const vk::DeviceMemory& GetDeviceMemory() const noexcept
+			{
+				return m_deviceMemory;
+			}
+
+			[[nodiscard]] void* GetMappedData() const noexcept
+			{
+				return m_mappedData;
+			}
+
+			[[nodiscard]] vk::DeviceSize GetSize() const noexcept
+			{
+				return m_size;
+			}
+
+			[[nodiscard]] vk::DeviceSize GetUsedBytes() const noexcept
+			{
+				return m_usedBytes;
+			}
+
+			[[nodiscard]] vk::DeviceSize GetFreeBytes() const noexcept;
+			[[nodiscard]] vk::DeviceSize GetLargestFreeRange() const noexcept;
+
+			[[nodiscard]] size_t GetAllocationCount() const noexcept
+			{
+				return m_allocationCount;
+			}
+
+		private:
+			vk::Device m_logicalDevice = nullptr;
+			vk::DeviceMemory m_deviceMemory = nullptr;
+			void* m_mappedData = nullptr;
+			vk::DeviceSize m_size = 0;
+			vk::DeviceSize m_usedBytes = 0;
+			size_t m_allocationCount = 0;
+			AllocationPool m_pool = AllocationPool::FreeList;
+
+			// Free-list pools track every hole, linear pools only bump a head that rewinds once the block is empty.
+			std::unique_ptr<FreeList> m_freeList = nullptr;
+			vk::DeviceSize m_linearHead = 0;
+		};
+
+		/// <summary>
+		/// Sub-allocates device memory out of large blocks per memory type, so resources do not each cost a vkAllocateMemory.
+		/// </summary>
+		class Allocator
+		{
+		public:
+			inline static constexpr vk::DeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+			Allocator(const vk::Device& device, const vk::PhysicalDevice& physicalDevice, vk::DeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+			~Allocator();
+
+			Allocator(const Allocator&) = delete;
+			Allocator& operator=(const Allocator&) = delete;
+
+			Allocation Allocate(const vk::MemoryRequirements& requirements, const vk::MemoryPropertyFlags& memoryProperties, AllocationPool pool = AllocationPool::FreeList, bool isImage = false, MemoryCategory category = MemoryCategory::Other);
+			void Free(Allocation& allocation);
+
+			[[nodiscard]] AllocatorStatistics GetStatistics() const;
+			[[nodiscard]] AllocatorStatistics GetStatistics(uint32_t memoryTypeIndex) const;
+			[[nodiscard]] uint32_t GetMemoryTypeIndex(uint32_t memoryTypeBits, const vk::MemoryPropertyFlags& memoryProperties) const;
+			[[nodiscard]] MemoryCategoryUsage GetCategoryUsage() const;
+
+			/// <summary>
+			/// Bytes of device memory this allocator holds on every heap, including the unused parts of its blocks.
+			/// </summary>
+			[[nodiscard]] std::vector<vk::DeviceSize> GetHeapUsage() const;
+
+			[[nodiscard]] const vk::PhysicalDeviceMemoryProperties& GetMemoryProperties() const noexcept
+			{
+				return m_memoryProperties;
+			}
+
+		private:
+			static uint64_t GetBlockKey(uint32_t memoryTypeIndex, AllocationPool pool, bool isImage) noexcept
+			{
+				return (static_cast<uint64_t>(memoryTypeIndex) << 8) | (static_cast<uint64_t>(pool) << 1) | (isImage ? 1 : 0);
+			}
+
+			static void Accumulate(AllocatorStatistics& statistics, const MemoryBlock& block) noexcept;
+			static void FinalizeStatistics(AllocatorStatistics& statistics) noexcept;
+
+			Allocation AllocateDedicated(const vk::MemoryRequirements& requirements, uint32_t memoryTypeIndex);
+
+			mutable std::mutex m_mutex;
+			vk::Device m_logicalDevice = nullptr;
+			vk::PhysicalDeviceMemoryProperties m_memoryProperties = {};
+			vk::DeviceSize m_nonCoherentAtomSize = 1;
+			vk::DeviceSize m_blockSize = DEFAULT_BLOCK_SIZE;
+			std::unordered_map<uint64_t, std::vector<std::unique_ptr<MemoryBlock>>> m_blocks;
+			std::vector<Allocation> m_dedicatedAllocations;
+			MemoryCategoryUsage m_categoryUsage = {};
+		};
+	}
+}
@@ -0,0 +1,87 @@
+#include "AsyncUploaderVK.h"
+
+GLVK::VK::AsyncUploader::AsyncUploader(std::unique_ptr<UploadBatch> batch)
+	: m_batch(std::move(batch))
+{
+	m_thread = std::thread(&AsyncUploader::Run, this);
+}
+
+GLVK::VK::AsyncUploader::~AsyncUploader()
+{
+	{
+		auto lock = std::lock_guard<std::mutex>{ m_mutex };
+		m_stopping = true;
+	}
+	m_condition.notify_one();
+	m_thread.join();
+	m_batch.reset();
+}
+
+void GLVK::VK::AsyncUploader::Enqueue(Job job)
+{
+	{
+		auto lock = std::lock_guard<std::mutex>{ m_mutex };
+		m_tasks.emplace_back(Task{ std::move(job), nullptr });
+	}
+	m_condition.notify_one();
+}
+
+std::shared_future<GLVK::VK::UploadToken> GLVK::VK::AsyncUploader::Flush()
+{
+	auto completion = std::make_shared<std::promise<UploadToken>>();
+	auto future = completion->get_future().share();
+	{
+		auto lock = std::lock_guard<std::mutex>{ m_mutex };
+		m_tasks.emplace_back(Task{ nullptr, completion });
+	}
+	m_condition.notify_one();
+	return future;
+}
+
+void GLVK::VK::AsyncUploader::Run()
+{
+	while (true)
+	{
+		auto task = Task();
+		{
+			auto lock = std::unique_lock<std::mutex>{ m_mutex };
+			m_condition.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+
+			// Drain what is queued before stopping so no promise is left unfulfilled.
+			if (m_tasks.empty()) break;
+
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+		}
+
+		try
+		{
+			if (task.Work) task.Work(*m_batch);
+
+			if (task.Completion)
+			{
+				if (m_error)
+				{
+					task.Completion->set_exception(m_error);
+					m_error = nullptr;
+				}
+				else
+				{
+					task.Completion->set_value(m_batch->Submit());
+				}
+			}
+		}
+		catch (...)
+		{
+			// Failures surface through the next flush, which is where the caller waits.
+			if (task.Completion)
+				task.Completion->set_exception(std::current_exception());
+			else
+				m_error = std::current_exception();
+		}
+
+		m_batch->Collect();
+	}
+
+	if (!m_batch->IsEmpty()) m_batch->Submit();
+}
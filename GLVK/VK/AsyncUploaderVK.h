@@ -0,0 +1,56 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "UploadBatchVK.h"
+
+namespace GLVK
+{
+	namespace VK
+	{
+		/// <summary>
+		/// Owns an upload batch and a worker thread that stages, records and submits uploads, so the caller never blocks on staging memory or queue submission.
+		/// </summary>
+		class AsyncUploader
+		{
+		public:
+			using Job = std::function<void(UploadBatch&)>;
+
+			explicit AsyncUploader(std::unique_ptr<UploadBatch> batch);
+			~AsyncUploader();
+
+			AsyncUploader(const AsyncUploader&) = delete;
+			AsyncUploader& operator=(const AsyncUploader&) = delete;
+
+			void Enqueue(Job job);
+
+			/// <summary>
+			/// Submit every job enqueued so far as one batch. The future becomes ready once the batch has been submitted, not executed;
+			/// the token it carries can be waited on for the GPU side.
+			/// </summary>
+			std::shared_future<UploadToken> Flush();
+
+		private:
+			struct Task
+			{
+				Job Work;
+				std::shared_ptr<std::promise<UploadToken>> Completion;
+			};
+
+			void Run();
+
+			std::unique_ptr<UploadBatch> m_batch = nullptr;
+			std::mutex m_mutex;
+			std::condition_variable m_condition;
+			std::deque<Task> m_tasks;
+			std::exception_ptr m_error = nullptr;
+			bool m_stopping = false;
+			std::thread m_thread;
+		};
+	}
+}
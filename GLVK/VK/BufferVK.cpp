@@ -19,23 +19,35 @@ GLVK::VK::Buffer::~Buffer()
 	if (!m_isDisposed) Dispose();
 }
 
-void GLVK::VK::Buffer::CopyBufferToBuffer(const vk::Buffer& srcBuffer, vk::DeviceSize size, const vk::CommandPool& commandPool, const vk::Queue& graphicsQueue)
+void GLVK::VK::Buffer::CopyBufferToBuffer(const vk::Buffer& srcBuffer, vk::DeviceSize size, const vk::CommandPool& commandPool, const vk::Queue& graphicsQueue, vk::DeviceSize srcOffset, const vk::Fence& fence)
+{
+	auto cmd_buffer = CreateSingleTimeBuffer(m_logicalDevice, commandPool);
+	RecordCopyBufferToBuffer(cmd_buffer, srcBuffer, size, srcOffset);
+	ExecuteCommandBuffer(cmd_buffer, m_logicalDevice, commandPool, graphicsQueue, fence);
+}
+
+void GLVK::VK::Buffer::RecordCopyBufferToBuffer(const vk::CommandBuffer& commandBuffer, const vk::Buffer& srcBuffer, vk::DeviceSize size, vk::DeviceSize srcOffset, vk::DeviceSize dstOffset)
 {
 	auto info = vk::BufferCopy();
-	info.dstOffset = 0;
+	info.dstOffset = dstOffset;
 	info.size = size;
-	info.srcOffset = 0;
+	info.srcOffset = srcOffset;
 
+	commandBuffer.copyBuffer(srcBuffer, m_buffer, info);
+}
+
+void GLVK::VK::Buffer::CopyBufferToImage(const vk::Image& targetImage, uint32_t height, uint32_t width, vk::DeviceSize size, const vk::ImageAspectFlags& imageFlags, vk::CommandPool& commandPool, const vk::Queue& graphicsQueue, vk::DeviceSize bufferOffset, const vk::Fence& fence)
+{
 	auto cmd_buffer = CreateSingleTimeBuffer(m_logicalDevice, commandPool);
-	cmd_buffer.copyBuffer(srcBuffer, m_buffer, info);
-	ExecuteCommandBuffer(cmd_buffer, m_logicalDevice, commandPool, graphicsQueue);
+	RecordCopyBufferToImage(cmd_buffer, targetImage, height, width, imageFlags, bufferOffset);
+	ExecuteCommandBuffer(cmd_buffer, m_logicalDevice, commandPool, graphicsQueue, fence);
 }
 
-void GLVK::VK::Buffer::CopyBufferToImage(const vk::Image& targetImage, uint32_t height, uint32_t width, vk::DeviceSize size, const vk::ImageAspectFlags& imageFlags, vk::CommandPool& commandPool, const vk::Queue& graphicsQueue)
+void GLVK::VK::Buffer::RecordCopyBufferToImage(const vk::CommandBuffer& commandBuffer, const vk::Image& targetImage, uint32_t height, uint32_t width, const vk::ImageAspectFlags& imageFlags, vk::DeviceSize bufferOffset)
 {
 	auto info = vk::BufferImageCopy();
 	info.bufferImageHeight = 0;
-	info.bufferOffset = 0;
+	info.bufferOffset = bufferOffset;
 	info.bufferRowLength = 0;
 	info.imageExtent.depth = 1;
 	info.imageExtent.height = height;
@@ -46,15 +58,13 @@ void GLVK::VK::Buffer::CopyBufferToImage(const vk::Image& targetImage, uint32_t
 	info.imageSubresource.layerCount = 1;
 	info.imageSubresource.mipLevel = 0;
 	
-	auto cmd_buffer = CreateSingleTimeBuffer(m_logicalDevice, commandPool);
-	cmd_buffer.copyBufferToImage(m_buffer, targetImage, vk::ImageLayout::eTransferDstOptimal, info);
-	ExecuteCommandBuffer(cmd_buffer, m_logicalDevice, commandPool, graphicsQueue);
+	commandBuffer.copyBufferToImage(m_buffer, targetImage, vk::ImageLayout::eTransferDstOptimal, info);
 }
 
-const vk::DeviceMemory &GLVK::VK::Buffer::AllocateMemory(const vk::PhysicalDevice& physicalDevice, const vk::MemoryPropertyFlags& memoryProperties) {
+const vk::DeviceMemory &GLVK::VK::Buffer::AllocateMemory(Allocator& allocator, const vk::MemoryPropertyFlags& memoryProperties, AllocationPool pool, MemoryCategory category) {
     auto requirements = m_logicalDevice.getBufferMemoryRequirements(m_buffer);
-	MapDeviceMemory(requirements, physicalDevice, memoryProperties);
-	m_logicalDevice.bindBufferMemory(m_buffer, m_deviceMemory, 0);
+	MapDeviceMemory(requirements, allocator, memoryProperties, pool, false, category);
+	m_logicalDevice.bindBufferMemory(m_buffer, m_deviceMemory, m_allocation.Offset);
 	return m_deviceMemory;
 }
 
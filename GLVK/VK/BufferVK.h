@@ -14,9 +14,11 @@ namespace GLVK
 			virtual ~Buffer();
 
 			virtual void Dispose() override;
-			void CopyBufferToBuffer(const vk::Buffer& srcBuffer, vk::DeviceSize size, const vk::CommandPool& commandPool, const vk::Queue& graphicsQueue);
-			void CopyBufferToImage(const vk::Image& targetImage, uint32_t height, uint32_t width, vk::DeviceSize size, const vk::ImageAspectFlags& imageFlags, vk::CommandPool& commandPool, const vk::Queue& graphicsQueue);
-			virtual const vk::DeviceMemory& AllocateMemory(const vk::PhysicalDevice& physicalDevice, const vk::MemoryPropertyFlags& memoryProperties) override;
+			void CopyBufferToBuffer(const vk::Buffer& srcBuffer, vk::DeviceSize size, const vk::CommandPool& commandPool, const vk::Queue& graphicsQueue, vk::DeviceSize srcOffset = 0, const vk::Fence& fence = nullptr);
+			void CopyBufferToImage(const vk::Image& targetImage, uint32_t height, uint32_t width, vk::DeviceSize size, const vk::ImageAspectFlags& imageFlags, vk::CommandPool& commandPool, const vk::Queue& graphicsQueue, vk::DeviceSize bufferOffset = 0, const vk::Fence& fence = nullptr);
+			void RecordCopyBufferToBuffer(const vk::CommandBuffer& commandBuffer, const vk::Buffer& srcBuffer, vk::DeviceSize size, vk::DeviceSize srcOffset = 0, vk::DeviceSize dstOffset = 0);
+			void RecordCopyBufferToImage(const vk::CommandBuffer& commandBuffer, const vk::Image& targetImage, uint32_t height, uint32_t width, const vk::ImageAspectFlags& imageFlags, vk::DeviceSize bufferOffset = 0);
+			virtual const vk::DeviceMemory& AllocateMemory(Allocator& allocator, const vk::MemoryPropertyFlags& memoryProperties, AllocationPool pool = AllocationPool::FreeList, MemoryCategory category = MemoryCategory::Other) override;
 			
 			[[nodiscard]] const vk::Buffer& GetBuffer() const noexcept
             {
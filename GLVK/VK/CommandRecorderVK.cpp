@@ -0,0 +1,145 @@
+#include "CommandRecorderVK.h"
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+GLVK::VK::CommandRecorder::CommandRecorder(const vk::Device& device, uint32_t queueFamily, size_t frameCount, size_t workerCount, size_t minItemsPerSlice)
+	: m_logicalDevice(device), m_minItemsPerSlice(std::max<size_t>(minItemsPerSlice, 1))
+{
+	m_workers.resize(std::max<size_t>(workerCount, 1));
+
+	auto pool_info = vk::CommandPoolCreateInfo();
+	pool_info.flags = vk::CommandPoolCreateFlagBits::eTransient;
+	pool_info.queueFamilyIndex = queueFamily;
+
+	for (auto& worker : m_workers)
+	{
+		for (size_t i = 0; i < std::max<size_t>(frameCount, 1); ++i)
+		{
+			auto pool = worker.Pools.emplace_back(m_logicalDevice.createCommandPool(pool_info));
+
+			auto alloc_info = vk::CommandBufferAllocateInfo();
+			alloc_info.commandBufferCount = 1;
+			alloc_info.commandPool = pool;
+			alloc_info.level = vk::CommandBufferLevel::eSecondary;
+			worker.Buffers.emplace_back(m_logicalDevice.allocateCommandBuffers(alloc_info)[0]);
+		}
+	}
+
+	for (size_t i = 0; i < m_workers.size(); ++i)
+		m_workers[i].Thread = std::thread(&CommandRecorder::Run, this, i);
+
+	m_statistics.WorkerCount = m_workers.size();
+}
+
+GLVK::VK::CommandRecorder::~CommandRecorder()
+{
+	{
+		auto lock = std::lock_guard<std::mutex>{ m_mutex };
+		m_stopping = true;
+	}
+	m_start.notify_all();
+
+	for (auto& worker : m_workers)
+	{
+		if (worker.Thread.joinable())
+			worker.Thread.join();
+
+		for (auto& pool : worker.Pools)
+			m_logicalDevice.destroyCommandPool(pool);
+	}
+}
+
+const std::vector<vk::CommandBuffer>& GLVK::VK::CommandRecorder::Record(size_t frame, const vk::CommandBufferInheritanceInfo& inheritance, size_t itemCount, const RecordFunction& record)
+{
+	using namespace std::chrono;
+
+	m_recorded.clear();
+	m_statistics.ItemCount = itemCount;
+	m_statistics.SliceCount = 0;
+	m_statistics.RecordMilliseconds = 0.0;
+	if (itemCount == 0) return m_recorded;
+
+	auto start_time = steady_clock::now();
+
+	// Small lists are not worth waking every worker for; each slice has to carry enough draws to pay for its thread.
+	auto slice_count = std::min(m_workers.size(), (itemCount + m_minItemsPerSlice - 1) / m_minItemsPerSlice);
+
+	{
+		auto lock = std::lock_guard<std::mutex>{ m_mutex };
+		m_frame = frame;
+		m_itemCount = itemCount;
+		m_sliceCount = slice_count;
+		m_inheritance = &inheritance;
+		m_record = &record;
+		m_remaining = slice_count;
+		++m_generation;
+	}
+	m_start.notify_all();
+
+	{
+		auto lock = std::unique_lock<std::mutex>{ m_mutex };
+		m_finished.wait(lock, [this]() { return m_remaining == 0; });
+		m_inheritance = nullptr;
+		m_record = nullptr;
+	}
+
+	for (size_t i = 0; i < slice_count; ++i)
+	{
+		if (auto error = std::exchange(m_workers[i].Error, nullptr))
+			std::rethrow_exception(error);
+
+		m_recorded.emplace_back(m_workers[i].Buffers[frame]);
+	}
+
+	m_statistics.SliceCount = slice_count;
+	m_statistics.RecordMilliseconds = duration<double, std::milli>(steady_clock::now() - start_time).count();
+	return m_recorded;
+}
+
+void GLVK::VK::CommandRecorder::Run(size_t workerIndex)
+{
+	uint64_t generation = 0;
+
+	while (true)
+	{
+		auto lock = std::unique_lock<std::mutex>{ m_mutex };
+		m_start.wait(lock, [&]() { return m_stopping || m_generation != generation; });
+		if (m_stopping) return;
+
+		generation = m_generation;
+		if (workerIndex >= m_sliceCount) continue;
+		lock.unlock();
+
+		try
+		{
+			RecordSlice(workerIndex, workerIndex);
+		}
+		catch (...)
+		{
+			m_workers[workerIndex].Error = std::current_exception();
+		}
+
+		lock.lock();
+		if (--m_remaining == 0)
+			m_finished.notify_one();
+	}
+}
+
+void GLVK::VK::CommandRecorder::RecordSlice(size_t workerIndex, size_t sliceIndex)
+{
+	auto& worker = m_workers[workerIndex];
+	auto& buffer = worker.Buffers[m_frame];
+	auto first = m_itemCount * sliceIndex / m_sliceCount;
+	auto last = m_itemCount * (sliceIndex + 1) / m_sliceCount;
+
+	m_logicalDevice.resetCommandPool(worker.Pools[m_frame]);
+
+	auto begin_info = vk::CommandBufferBeginInfo();
+	begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue;
+	begin_info.pInheritanceInfo = m_inheritance;
+
+	buffer.begin(begin_info);
+	(*m_record)(buffer, first, last);
+	buffer.end();
+}
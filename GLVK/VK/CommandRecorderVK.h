@@ -0,0 +1,102 @@
+#pragma once
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace GLVK
+{
+	namespace VK
+	{
+		struct CommandRecorderStatistics
+		{
+			size_t WorkerCount = 0;
+			size_t SliceCount = 0;
+			size_t ItemCount = 0;
+
+			/// <summary>
+			/// Wall time of the last Record() call, from handing out the slices until every worker finished.
+			/// </summary>
+			double RecordMilliseconds = 0.0;
+		};
+
+		struct RecordingBenchmarkResult
+		{
+			size_t WorkerCount = 0;
+			size_t SliceCount = 0;
+			size_t DrawCount = 0;
+			double AverageMilliseconds = 0.0;
+			double BestMilliseconds = 0.0;
+		};
+
+		/// <summary>
+		/// Records secondary command buffers for a draw list on a fixed set of worker threads. Every worker owns one command pool
+		/// per frame in flight, so workers never share a pool and a frame's pools are only reset once the GPU is done with them.
+		/// </summary>
+		class CommandRecorder
+		{
+		public:
+			/// <summary>
+			/// Records the items in [first, last) into a secondary command buffer that has already begun.
+			/// Called concurrently from several workers, each with its own command buffer and range.
+			/// </summary>
+			using RecordFunction = std::function<void(const vk::CommandBuffer& commandBuffer, size_t first, size_t last)>;
+
+			CommandRecorder(const vk::Device& device, uint32_t queueFamily, size_t frameCount, size_t workerCount, size_t minItemsPerSlice);
+			~CommandRecorder();
+
+			CommandRecorder(const CommandRecorder&) = delete;
+			CommandRecorder& operator=(const CommandRecorder&) = delete;
+
+			/// <summary>
+			/// Split itemCount items into contiguous slices and record them in parallel. Blocks until every slice has been recorded.
+			/// The caller must have waited for the frame's previous submission; the returned buffers are in draw order.
+			/// </summary>
+			const std::vector<vk::CommandBuffer>& Record(size_t frame, const vk::CommandBufferInheritanceInfo& inheritance, size_t itemCount, const RecordFunction& record);
+
+			[[nodiscard]] size_t GetWorkerCount() const noexcept
+			{
+				return m_workers.size();
+			}
+
+			[[nodiscard]] CommandRecorderStatistics GetStatistics() const noexcept
+			{
+				return m_statistics;
+			}
+
+		private:
+			struct Worker
+			{
+				std::vector<vk::CommandPool> Pools;
+				std::vector<vk::CommandBuffer> Buffers;
+				std::exception_ptr Error = nullptr;
+				std::thread Thread;
+			};
+
+			void Run(size_t workerIndex);
+			void RecordSlice(size_t workerIndex, size_t sliceIndex);
+
+			vk::Device m_logicalDevice = nullptr;
+			size_t m_minItemsPerSlice = 1;
+			std::vector<Worker> m_workers;
+			std::vector<vk::CommandBuffer> m_recorded;
+			CommandRecorderStatistics m_statistics = {};
+
+			std::mutex m_mutex;
+			std::condition_variable m_start;
+			std::condition_variable m_finished;
+			uint64_t m_generation = 0;
+			size_t m_remaining = 0;
+			bool m_stopping = false;
+
+			size_t m_frame = 0;
+			size_t m_itemCount = 0;
+			size_t m_sliceCount = 0;
+			const vk::CommandBufferInheritanceInfo* m_inheritance = nullptr;
+			const RecordFunction* m_record = nullptr;
+		};
+	}
+}
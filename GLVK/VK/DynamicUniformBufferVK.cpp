@@ -0,0 +1,138 @@
+#include "DynamicUniformBufferVK.h"
+#include <algorithm>
+#include <cstring>
+#include "UtilsVK.h"
+
+GLVK::VK::DynamicUniformBuffer::DynamicUniformBuffer(const vk::Device& device, Allocator& allocator, size_t slotCount, vk::DeviceSize slotStride, size_t frameCount, vk::DeviceSize nonCoherentAtomSize)
+	: m_logicalDevice(device), m_slotCount(slotCount), m_slotStride(slotStride), m_nonCoherentAtomSize(std::max<vk::DeviceSize>(nonCoherentAtomSize, 1))
+{
+	// Zero sized buffers are invalid. The allocator rounds non-coherent allocations out to whole atoms, so an aligned flush
+	// range never runs past the end of the buffer's memory.
+	auto buffer_size = std::max<vk::DeviceSize>(slotStride * slotCount, slotStride);
+
+	m_frames.resize(std::max<size_t>(frameCount, 1));
+	for (auto& frame : m_frames)
+	{
+		frame.UniformBuffer = std::make_unique<Buffer>(m_logicalDevice, vk::BufferUsageFlagBits::eUniformBuffer, buffer_size);
+		frame.UniformBuffer->AllocateMemory(allocator, vk::MemoryPropertyFlagBits::eHostVisible, AllocationPool::FreeList, MemoryCategory::Uniforms);
+		frame.MappedData = reinterpret_cast<uint8_t*>(frame.UniformBuffer->Map(buffer_size));
+		frame.SlotVersions.assign(slotCount, 0);
+		memset(frame.MappedData, 0, buffer_size);
+
+		m_isCoherent = m_isCoherent && static_cast<bool>(frame.UniformBuffer->GetAllocation().MemoryProperties & vk::MemoryPropertyFlagBits::eHostCoherent);
+	}
+
+	m_latestVersions.assign(slotCount, 0);
+	m_latestFrames.assign(slotCount, 0);
+	m_isStale.assign(slotCount, false);
+	m_isDirty.assign(slotCount, false);
+}
+
+void GLVK::VK::DynamicUniformBuffer::BeginFrame(size_t frameIndex)
+{
+	m_currentFrame = frameIndex % m_frames.size();
+	auto& frame = m_frames[m_currentFrame];
+
+	// Bring this copy up to date with slots that were written while other copies were current.
+	auto remaining = std::vector<size_t>();
+	for (auto slot : m_staleSlots)
+	{
+		if (frame.SlotVersions[slot] != m_latestVersions[slot])
+		{
+			const auto& source = m_frames[m_latestFrames[slot]];
+			memcpy(frame.MappedData + slot * m_slotStride, source.MappedData + slot * m_slotStride, m_slotStride);
+			frame.SlotVersions[slot] = m_latestVersions[slot];
+			MarkDirty(slot);
+		}
+
+		auto is_everywhere = std::all_of(m_frames.cbegin(), m_frames.cend(), [&](const FrameCopy& copy) {
+			return copy.SlotVersions[slot] == m_latestVersions[slot];
+			});
+
+		if (is_everywhere)
+			m_isStale[slot] = false;
+		else
+			remaining.emplace_back(slot);
+	}
+
+	m_staleSlots = std::move(remaining);
+}
+
+void GLVK::VK::DynamicUniformBuffer::Write(size_t slot, const void* data, vk::DeviceSize size)
+{
+	auto& frame = m_frames[m_currentFrame];
+	memcpy(frame.MappedData + slot * m_slotStride, data, std::min(size, m_slotStride));
+
+	frame.SlotVersions[slot] = ++m_writeCounter;
+	m_latestVersions[slot] = m_writeCounter;
+	m_latestFrames[slot] = static_cast<uint32_t>(m_currentFrame);
+
+	if (m_frames.size() > 1 && !m_isStale[slot])
+	{
+		m_isStale[slot] = true;
+		m_staleSlots.emplace_back(slot);
+	}
+
+	MarkDirty(slot);
+}
+
+GLVK::VK::DynamicUniformFlushStatistics GLVK::VK::DynamicUniformBuffer::Flush()
+{
+	auto statistics = DynamicUniformFlushStatistics();
+	statistics.DirtySlots = m_dirtySlots.size();
+	if (m_dirtySlots.empty()) return statistics;
+
+	std::sort(m_dirtySlots.begin(), m_dirtySlots.end());
+
+	const auto& frame = m_frames[m_currentFrame];
+	const auto& allocation = frame.UniformBuffer->GetAllocation();
+	auto ranges = std::vector<vk::MappedMemoryRange>();
+
+	// Neighbouring slots are merged, so a run of moved objects costs one range.
+	for (size_t i = 0; i < m_dirtySlots.size();)
+	{
+		auto first = m_dirtySlots[i];
+		auto last = first;
+		while (++i < m_dirtySlots.size() && m_dirtySlots[i] == last + 1)
+			last = m_dirtySlots[i];
+
+		auto begin = allocation.Offset + first * m_slotStride;
+		auto end = allocation.Offset + (last + 1) * m_slotStride;
+		auto aligned_begin = AlignDown(begin, m_nonCoherentAtomSize);
+		auto aligned_end = AlignUp(end, m_nonCoherentAtomSize);
+
+		// Alignment can make consecutive ranges touch even when their slots were not adjacent.
+		if (!ranges.empty() && ranges.back().offset + ranges.back().size >= aligned_begin)
+		{
+			ranges.back().size = aligned_end - ranges.back().offset;
+		}
+		else
+		{
+			auto range = vk::MappedMemoryRange();
+			range.memory = allocation.Memory;
+			range.offset = aligned_begin;
+			range.size = aligned_end - aligned_begin;
+			ranges.emplace_back(range);
+		}
+	}
+
+	for (auto slot : m_dirtySlots)
+		m_isDirty[slot] = false;
+	m_dirtySlots.clear();
+
+	for (const auto& range : ranges)
+		statistics.FlushedBytes += range.size;
+	statistics.FlushedRanges = ranges.size();
+
+	if (!m_isCoherent)
+		m_logicalDevice.flushMappedMemoryRanges(ranges);
+
+	return statistics;
+}
+
+void GLVK::VK::DynamicUniformBuffer::MarkDirty(size_t slot)
+{
+	if (m_isDirty[slot]) return;
+	m_isDirty[slot] = true;
+	m_dirtySlots.emplace_back(slot);
+}
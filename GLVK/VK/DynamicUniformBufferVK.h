@@ -0,0 +1,87 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include "AllocatorVK.h"
+#include "BufferVK.h"
+
+namespace GLVK
+{
+	namespace VK
+	{
+		struct DynamicUniformFlushStatistics
+		{
+			size_t DirtySlots = 0;
+			size_t FlushedRanges = 0;
+			vk::DeviceSize FlushedBytes = 0;
+		};
+
+		/// <summary>
+		/// Per-object uniform data for dynamic uniform buffer bindings, with one persistently mapped copy per frame in flight.
+		/// Objects write straight into their slot of the current frame's copy; only written slots are flushed, and slots that
+		/// changed in an earlier frame are carried over when their copy comes round again.
+		/// </summary>
+		class DynamicUniformBuffer
+		{
+		public:
+			DynamicUniformBuffer(const vk::Device& device, Allocator& allocator, size_t slotCount, vk::DeviceSize slotStride, size_t frameCount, vk::DeviceSize nonCoherentAtomSize);
+
+			DynamicUniformBuffer(const DynamicUniformBuffer&) = delete;
+			DynamicUniformBuffer& operator=(const DynamicUniformBuffer&) = delete;
+
+			void BeginFrame(size_t frameIndex);
+			void Write(size_t slot, const void* data, vk::DeviceSize size);
+			DynamicUniformFlushStatistics Flush();
+
+			[[nodiscard]] const Buffer& GetBuffer(size_t frameIndex) const noexcept
+			{
+				return *m_frames[frameIndex].UniformBuffer;
+			}
+
+			[[nodiscard]] vk::DeviceSize GetSlotStride() const noexcept
+			{
+				return m_slotStride;
+			}
+
+			[[nodiscard]] size_t GetSlotCount() const noexcept
+			{
+				return m_slotCount;
+			}
+
+			[[nodiscard]] bool IsCoherent() const noexcept
+			{
+				return m_isCoherent;
+			}
+
+		private:
+			struct FrameCopy
+			{
+				std::unique_ptr<Buffer> UniformBuffer = nullptr;
+				uint8_t* MappedData = nullptr;
+				std::vector<uint64_t> SlotVersions;
+			};
+
+			void MarkDirty(size_t slot);
+
+			vk::Device m_logicalDevice = nullptr;
+			size_t m_slotCount = 0;
+			vk::DeviceSize m_slotStride = 0;
+			vk::DeviceSize m_nonCoherentAtomSize = 1;
+			bool m_isCoherent = true;
+			size_t m_currentFrame = 0;
+			uint64_t m_writeCounter = 0;
+			std::vector<FrameCopy> m_frames;
+
+			// Latest version of every slot and the frame copy that holds it.
+			std::vector<uint64_t> m_latestVersions;
+			std::vector<uint32_t> m_latestFrames;
+
+			// Slots whose latest version has not reached every frame copy yet.
+			std::vector<size_t> m_staleSlots;
+			std::vector<bool> m_isStale;
+
+			std::vector<size_t> m_dirtySlots;
+			std::vector<bool> m_isDirty;
+		};
+	}
+}
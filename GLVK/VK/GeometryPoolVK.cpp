@@ -0,0 +1,84 @@
+#include "GeometryPoolVK.h"
+#include "../../Structures/Vertex.h"
+#include "../../UtilsCommon.h"
+
+GLVK::VK::GeometryRange::~GeometryRange()
+{
+	if (Pool) Pool->Free(*this);
+}
+
+GLVK::VK::GeometryPool::GeometryPool(const vk::Device& device, Allocator& allocator, uint32_t vertexCapacity, uint32_t indexCapacity, bool hasPositionStream)
+	: m_vertexRanges(vertexCapacity), m_indexRanges(indexCapacity)
+{
+	m_vertexBuffer = std::make_unique<Buffer>(device, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer, static_cast<vk::DeviceSize>(vertexCapacity) * sizeof(Vertex));
+	m_vertexBuffer->AllocateMemory(allocator, vk::MemoryPropertyFlagBits::eDeviceLocal, AllocationPool::FreeList, MemoryCategory::Geometry);
+
+	m_indexBuffer = std::make_unique<Buffer>(device, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer, static_cast<vk::DeviceSize>(indexCapacity) * sizeof(uint32_t));
+	m_indexBuffer->AllocateMemory(allocator, vk::MemoryPropertyFlagBits::eDeviceLocal, AllocationPool::FreeList, MemoryCategory::Geometry);
+
+	if (hasPositionStream)
+	{
+		m_positionBuffer = std::make_unique<Buffer>(device, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer, static_cast<vk::DeviceSize>(vertexCapacity) * sizeof(Vector3));
+		m_positionBuffer->AllocateMemory(allocator, vk::MemoryPropertyFlagBits::eDeviceLocal, AllocationPool::FreeList, MemoryCategory::Geometry);
+	}
+}
+
+std::shared_ptr<GLVK::VK::GeometryRange> GLVK::VK::GeometryPool::Allocate(uint32_t vertexCount, uint32_t indexCount)
+{
+	auto lock = std::lock_guard<std::mutex>{ m_mutex };
+
+	// Ranges are counted in elements rather than bytes, so they map straight onto vertexOffset and firstIndex.
+	auto first_vertex = m_vertexRanges.Allocate(vertexCount, 1);
+	if (!first_vertex.has_value())
+		ThrowIfFailed("Geometry pool is out of vertex space, raise GraphicsSettings::GeometryPoolVertexCount.");
+
+	auto first_index = m_indexRanges.Allocate(indexCount, 1);
+	if (!first_index.has_value())
+	{
+		m_vertexRanges.Free(first_vertex.value(), vertexCount);
+		ThrowIfFailed("Geometry pool is out of index space, raise GraphicsSettings::GeometryPoolIndexCount.");
+	}
+
+	auto range = std::make_shared<GeometryRange>();
+	range->Pool = this;
+	range->FirstVertex = static_cast<uint32_t>(first_vertex.value());
+	range->VertexCount = vertexCount;
+	range->FirstIndex = static_cast<uint32_t>(first_index.value());
+	range->IndexCount = indexCount;
+	++m_rangeCount;
+
+	return range;
+}
+
+void GLVK::VK::GeometryPool::Free(const GeometryRange& range)
+{
+	auto lock = std::lock_guard<std::mutex>{ m_mutex };
+
+	if (range.VertexCount > 0) m_vertexRanges.Free(range.FirstVertex, range.VertexCount);
+	if (range.IndexCount > 0) m_indexRanges.Free(range.FirstIndex, range.IndexCount);
+	--m_rangeCount;
+}
+
+void GLVK::VK::GeometryPool::Bind(const vk::CommandBuffer& commandBuffer, bool isPositionOnly) const
+{
+	BindVertices(commandBuffer, isPositionOnly);
+	commandBuffer.bindIndexBuffer(m_indexBuffer->GetBuffer(), 0, vk::IndexType::eUint32);
+}
+
+void GLVK::VK::GeometryPool::BindVertices(const vk::CommandBuffer& commandBuffer, bool isPositionOnly) const
+{
+	commandBuffer.bindVertexBuffers(0, (isPositionOnly ? m_positionBuffer : m_vertexBuffer)->GetBuffer(), { 0 });
+}
+
+GLVK::VK::GeometryPoolStatistics GLVK::VK::GeometryPool::GetStatistics() const
+{
+	auto lock = std::lock_guard<std::mutex>{ m_mutex };
+
+	auto statistics = GeometryPoolStatistics();
+	statistics.VertexCapacity = static_cast<uint32_t>(m_vertexRanges.GetCapacity());
+	statistics.FreeVertices = static_cast<uint32_t>(m_vertexRanges.GetFreeBytes());
+	statistics.IndexCapacity = static_cast<uint32_t>(m_indexRanges.GetCapacity());
+	statistics.FreeIndices = static_cast<uint32_t>(m_indexRanges.GetFreeBytes());
+	statistics.RangeCount = m_rangeCount;
+	return statistics;
+}
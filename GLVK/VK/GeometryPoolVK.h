@@ -0,0 +1,89 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <vulkan/vulkan.hpp>
+#include "AllocatorVK.h"
+#include "BufferVK.h"
+
+namespace GLVK
+{
+	namespace VK
+	{
+		class GeometryPool;
+
+		/// <summary>
+		/// A mesh's slice of the geometry pool. The range goes back to the pool when the last owner releases it.
+		/// </summary>
+		struct GeometryRange
+		{
+			GeometryPool* Pool = nullptr;
+			uint32_t FirstVertex = 0;
+			uint32_t VertexCount = 0;
+			uint32_t FirstIndex = 0;
+			uint32_t IndexCount = 0;
+
+			GeometryRange() = default;
+			GeometryRange(const GeometryRange&) = delete;
+			GeometryRange& operator=(const GeometryRange&) = delete;
+			~GeometryRange();
+		};
+
+		struct GeometryPoolStatistics
+		{
+			uint32_t VertexCapacity = 0;
+			uint32_t FreeVertices = 0;
+			uint32_t IndexCapacity = 0;
+			uint32_t FreeIndices = 0;
+			size_t RangeCount = 0;
+		};
+
+		/// <summary>
+		/// One device-local vertex buffer and one index buffer that every mesh is sub-allocated from,
+		/// so a command buffer binds geometry once and draws select their mesh with firstIndex and vertexOffset.
+		/// With a position stream, a second vertex buffer holds only the positions at the same offsets, so both streams share the index buffer.
+		/// </summary>
+		class GeometryPool
+		{
+		public:
+			GeometryPool(const vk::Device& device, Allocator& allocator, uint32_t vertexCapacity, uint32_t indexCapacity, bool hasPositionStream = false);
+
+			GeometryPool(const GeometryPool&) = delete;
+			GeometryPool& operator=(const GeometryPool&) = delete;
+
+			std::shared_ptr<GeometryRange> Allocate(uint32_t vertexCount, uint32_t indexCount);
+			void Free(const GeometryRange& range);
+			void Bind(const vk::CommandBuffer& commandBuffer, bool isPositionOnly = false) const;
+			void BindVertices(const vk::CommandBuffer& commandBuffer, bool isPositionOnly) const;
+			GeometryPoolStatistics GetStatistics() const;
+
+			[[nodiscard]] Buffer& GetVertexBuffer() noexcept
+			{
+				return *m_vertexBuffer;
+			}
+
+			[[nodiscard]] Buffer& GetIndexBuffer() noexcept
+			{
+				return *m_indexBuffer;
+			}
+
+			[[nodiscard]] bool HasPositionStream() const noexcept
+			{
+				return m_positionBuffer != nullptr;
+			}
+
+			[[nodiscard]] Buffer& GetPositionBuffer() noexcept
+			{
+				return *m_positionBuffer;
+			}
+
+		private:
+			mutable std::mutex m_mutex;
+			std::unique_ptr<Buffer> m_vertexBuffer = nullptr;
+			std::unique_ptr<Buffer> m_indexBuffer = nullptr;
+			std::unique_ptr<Buffer> m_positionBuffer = nullptr;
+			FreeList m_vertexRanges;
+			FreeList m_indexRanges;
+			size_t m_rangeCount = 0;
+		};
+	}
+}
@@ -1,6 +1,7 @@
 #include "GraphicsEngineVK.h"
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <chrono>
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
@@ -9,7 +10,11 @@
 #include <unordered_set>
 #include <cassert>
 #include <cmath>
+#include <cstddef>
 #include <cstring>
+#include <filesystem>
+#include <thread>
+#include <type_traits>
 
 #if defined(max)
 #undef max
@@ -18,8 +23,15 @@
 #undef min
 #endif
 
-GLVK::VK::GraphicsEngine::GraphicsEngine(GLFWwindow* window, int width, int height, IResourceManager* resourceManager)
-	: IGraphics(window, width, height, resourceManager, true)
+// CMake builds compile the SPIR-V into the build tree; otherwise compile_shader.py writes it next to the sources.
+#if defined(GLVK_SHADER_BINARY_DIR)
+static constexpr auto SHADER_BINARY_DIR = std::string_view(GLVK_SHADER_BINARY_DIR);
+#else
+static constexpr auto SHADER_BINARY_DIR = std::string_view("GLVK/VK/Shaders");
+#endif
+
+GLVK::VK::GraphicsEngine::GraphicsEngine(GLFWwindow* window, int width, int height, IResourceManager* resourceManager, const GraphicsSettings& settings)
+	: IGraphics(window, width, height, resourceManager, true), m_settings(settings)
 {
 	try
 	{
@@ -34,11 +46,29 @@ GLVK::VK::GraphicsEngine::GraphicsEngine(GLFWwindow* window, int width, int heig
 		m_format = m_surfaceFormat.format;
 
 		CreateLogicalDevice();
+		m_allocator = std::make_unique<Allocator>(m_logicalDevice, m_physicalDevice);
+		m_memoryBudget = std::make_unique<MemoryBudget>(m_physicalDevice, *m_allocator, m_hasMemoryBudget);
+		m_stagingRing = std::make_unique<StagingRing>(m_logicalDevice, *m_allocator, m_settings.StagingBufferSize);
+		m_geometryPool = std::make_unique<GeometryPool>(m_logicalDevice, *m_allocator, m_settings.GeometryPoolVertexCount, m_settings.GeometryPoolIndexCount, m_settings.DepthPrePass);
+		m_renderTargets = std::make_unique<RenderTargetPool>(m_logicalDevice, *m_allocator);
+		CreateTextureTable();
 		LoadShader();
 
 		auto pool_info = vk::CommandPoolCreateInfo();
+		pool_info.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
 		pool_info.queueFamilyIndex = m_queueIndices.GraphicsQueue.value();
 		m_commandPool = m_logicalDevice.createCommandPool(pool_info);
+
+		auto recording_threads = m_settings.RecordingThreadCount > 0 ? m_settings.RecordingThreadCount : std::max(std::thread::hardware_concurrency(), 2u) - 1;
+		m_recorder = std::make_unique<CommandRecorder>(m_logicalDevice, m_queueIndices.GraphicsQueue.value(), std::max<size_t>(m_settings.FramesInFlight, 1), recording_threads, m_settings.MinDrawsPerRecordingThread);
+
+		auto upload_queues = UploadQueues();
+		upload_queues.TransferQueue = m_transferQueue;
+		upload_queues.TransferFamily = m_queueIndices.TransferQueue.value();
+		upload_queues.GraphicsQueue = m_graphicsQueue;
+		upload_queues.GraphicsFamily = m_queueIndices.GraphicsQueue.value();
+		upload_queues.GraphicsQueueMutex = &m_graphicsQueueMutex;
+		m_uploader = std::make_unique<AsyncUploader>(std::make_unique<UploadBatch>(m_logicalDevice, *m_allocator, *m_stagingRing, upload_queues));
 	}
 	catch (const std::exception&)
 	{
@@ -49,14 +79,26 @@ GLVK::VK::GraphicsEngine::GraphicsEngine(GLFWwindow* window, int width, int heig
 GLVK::VK::GraphicsEngine::~GraphicsEngine()
 {
 	Dispose();
-	ReleaseAlignedMemory(m_dynamicBufferObject.Meshes.Buffer);
-	ReleaseAlignedMemory(m_dynamicBufferObject.Models.Buffer);
 	m_logicalDevice.destroyDescriptorSetLayout(m_descriptorSetLayout);
+	m_logicalDevice.destroyDescriptorSetLayout(m_cullSetLayout);
+	m_textureTable.reset();
+	m_pendingUploads.clear();
+	m_uploader.reset();
+	m_primitives.clear();
+	m_geometryPool.reset();
+	m_recorder.reset();
 	m_logicalDevice.destroyCommandPool(m_commandPool);
-	if (m_intermediateBuffer) m_intermediateBuffer.reset();
-	m_vertexShaderMesh.reset();
+	m_stagingRing.reset();
+	m_shaderSources.clear();
+	m_shaderCompiler.reset();
+	m_cullShader.reset();
+	m_hizShader.reset();
+	m_depthPrePassShader.reset();
 	m_vertexShader.reset();
 	m_fragmentShader.reset();
+	m_renderTargets.reset();
+	m_memoryBudget.reset();
+	m_allocator.reset();
 	m_logicalDevice.destroy();
 	m_instance.destroySurfaceKHR(m_surface);
 	auto dispatcher = vk::DispatchLoaderDynamic();
@@ -67,6 +109,11 @@ GLVK::VK::GraphicsEngine::~GraphicsEngine()
 
 void GLVK::VK::GraphicsEngine::Update(float deltaTime)
 {
+	// The slot's buffers are only overwritten once the GPU has finished the frame that last used them.
+	auto& frame = m_frames[m_currentFrame];
+	m_logicalDevice.waitForFences(frame.Fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+	m_memoryBudget->Update();
+
     using namespace std::chrono;
     static auto start_time = high_resolution_clock::now();
     auto current_time = high_resolution_clock::now();
@@ -79,9 +126,11 @@ void GLVK::VK::GraphicsEngine::Update(float deltaTime)
     auto rotate_y = glm::rotate(glm::mat4(1.0f), duration_between * glm::radians(-45.0f), glm::vec3(0.0f, -1.0f, 0.0f));
     auto rotate_z = glm::rotate(glm::mat4(1.0f), duration_between * glm::radians(45.0f), glm::vec3(0.0f, 0.0f, 1.0f));
     m_mvp.Model = rotate_z * rotate_y * rotate_x * glm::mat4(1.0f);
-	auto mapped = m_mvpBuffer->Map(sizeof(MVP));
+	auto mapped = frame.MvpBuffer->Map(sizeof(MVP));
     memcpy(mapped, &m_mvp, sizeof(MVP));
 
+	// World matrices are written straight into this frame's mapped slots; objects that did not move cost nothing.
+	m_meshUniforms->BeginFrame(m_currentFrame);
 	for (auto i = 0; i < m_dynamicBufferObject.Meshes.Models.size(); ++i)
 	{
 		auto& mesh = m_meshes[i];
@@ -90,37 +139,120 @@ void GLVK::VK::GraphicsEngine::Update(float deltaTime)
 		mesh->RotationZ += glm::radians(duration_between / 750.0f);
 
 		auto& world = m_dynamicBufferObject.Meshes.Models[m_dynamicBufferObject.Meshes.ModelIndices[i]];
-		world = mesh->GetWorldMatrix();
-
-		auto ptr = reinterpret_cast<glm::mat4*>(reinterpret_cast<uint64_t>(m_dynamicBufferObject.Meshes.Buffer) + (m_dynamicBufferObject.DynamicAlignment * i));
+		auto new_world = mesh->GetWorldMatrix();
+		if (new_world == world) continue;
 
-		*ptr = world;
+		// Meshes created after Initialize() have no slot; they are only drawn through the instance buffer, which does not read it.
+		world = new_world;
+		if (i < m_meshUniforms->GetSlotCount()) m_meshUniforms->Write(i, &world, sizeof(glm::mat4));
 	}
+	m_meshUniforms->Flush();
 
+	m_modelUniforms->BeginFrame(m_currentFrame);
 	for (auto i = 0; i < m_dynamicBufferObject.Models.Models.size(); ++i)
 	{
 		auto& model = m_models[i];
 		model->RotationX += glm::radians(duration_between / 500.0f);
 		model->RotationY += glm::radians(duration_between / 500.0f);
 		model->RotationZ += glm::radians(duration_between / 500.0f);
-		auto& world = m_dynamicBufferObject.Models.Models[m_dynamicBufferObject.Models.ModelIndices[i]];
-		world = model->GetWorldMatrix();
 
-		auto ptr = reinterpret_cast<glm::mat4*>(reinterpret_cast<uint64_t>(m_dynamicBufferObject.Models.Buffer) + (m_dynamicBufferObject.DynamicAlignment * i));
+		auto& world = m_dynamicBufferObject.Models.Models[m_dynamicBufferObject.Models.ModelIndices[i]];
+		auto new_world = model->GetWorldMatrix();
+		if (new_world == world) continue;
 
-		*ptr = world;
+		world = new_world;
+		if (i < m_modelUniforms->GetSlotCount()) m_modelUniforms->Write(i, &world, sizeof(glm::mat4));
 	}
-
-	mapped = m_dynamicMeshUniformBuffer->Map(VK_WHOLE_SIZE);
-	memcpy(mapped, m_dynamicBufferObject.Meshes.Buffer, m_dynamicMeshUniformBuffer->GetBufferSize());
-
-	mapped = m_dynamicModelUniformBuffer->Map(VK_WHOLE_SIZE);
-	memcpy(mapped, m_dynamicBufferObject.Models.Buffer, m_dynamicModelUniformBuffer->GetBufferSize());
+	m_modelUniforms->Flush();
 }
 
 void GLVK::VK::GraphicsEngine::Render()
 {
-    auto result = m_logicalDevice.acquireNextImageKHR(m_swapchain, std::numeric_limits<uint32_t>::max(), m_imageAcquiredSemaphores[m_currentImageIndex], nullptr);
+	// Nothing waits for uploads here: EndDraw() left out whatever the upload thread has not submitted yet, so the render
+	// loop keeps presenting while large models stream in.
+	if (m_hasUnflushedUploads) FlushUploads();
+
+	auto& frame = m_frames[m_currentFrame];
+	m_logicalDevice.waitForFences(frame.Fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+	// EndDraw() records nothing while the swapchain waits to be rebuilt, which only happens once the window has an area again.
+	if (m_isSwapchainStale)
+	{
+		m_secondaryCommandBuffers.clear();
+		return;
+	}
+
+	uint32_t image_index = 0;
+	try
+	{
+		auto result = m_logicalDevice.acquireNextImageKHR(m_swapchain, std::numeric_limits<uint32_t>::max(), frame.ImageAcquiredSemaphore, nullptr);
+		// A suboptimal image can still be presented, so the frame goes ahead and the next EndDraw() rebuilds the swapchain.
+		if (result.result == vk::Result::eSuboptimalKHR) m_isSwapchainStale = true;
+		image_index = result.value;
+	}
+	catch (const vk::OutOfDateKHRError&)
+	{
+		// The draws were recorded for the old extent, so the frame is dropped. Nothing was acquired and the semaphore stays unsignalled.
+		m_isSwapchainStale = true;
+		m_secondaryCommandBuffers.clear();
+		return;
+	}
+
+	static const auto clear_color = vk::ClearColorValue(std::array<float, 4>{ 1.0f, 1.0f, 1.0f, 1.0f });
+	static const auto clear_depth = vk::ClearDepthStencilValue(1.0f, 0);
+	static const vk::ClearValue clear_values[] = { vk::ClearValue(clear_color), vk::ClearValue(clear_depth) };
+	auto renderpass_info = vk::RenderPassBeginInfo();
+	renderpass_info.renderPass = m_pipeline->GetRenderPass();
+	renderpass_info.framebuffer = m_framebuffers[image_index];
+	renderpass_info.renderArea.extent = m_extent;
+	renderpass_info.renderArea.offset = vk::Offset2D();
+	renderpass_info.clearValueCount = _countof(clear_values);
+	renderpass_info.pClearValues = clear_values;
+	auto begin_info = vk::CommandBufferBeginInfo();
+	begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+
+	// The primary buffer only culls, opens the render pass and replays what was recorded in EndDraw().
+	auto& command_buffer = m_commandBuffers[m_currentFrame];
+	command_buffer.reset();
+	command_buffer.begin(begin_info);
+	if (m_useOcclusionCulling && m_isVisibilityReset)
+	{
+		// The previous frame's culling may still read and write the flags; the fill has to land before this frame's culling reads them.
+		auto barrier = vk::BufferMemoryBarrier();
+		barrier.buffer = m_visibilityBuffer->GetBuffer();
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.srcAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+		barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+		command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, {}, {}, barrier, {});
+		command_buffer.fillBuffer(m_visibilityBuffer->GetBuffer(), 0, VK_WHOLE_SIZE, 1);
+
+		barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+		command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {}, {}, barrier, {});
+		m_isVisibilityReset = false;
+	}
+	if (m_useGpuCulling) RecordCulling(command_buffer, frame);
+	command_buffer.beginRenderPass(renderpass_info, vk::SubpassContents::eSecondaryCommandBuffers);
+	if (!m_secondaryCommandBuffers.empty())
+		command_buffer.executeCommands(m_secondaryCommandBuffers);
+	command_buffer.endRenderPass();
+
+	// The first pass left its depth readable: reduce it into the pyramid, cull everything against it and draw what the first pass missed on top.
+	if (m_useOcclusionCulling)
+	{
+		m_hizPyramid->Record(command_buffer, m_pipeline->GetComputePipeline(ShaderType::HiZBuild), m_pipeline->GetPipelineLayout(ShaderType::HiZBuild));
+		RecordCulling(command_buffer, frame, 1);
+
+		renderpass_info.renderPass = m_pipeline->GetResumeRenderPass();
+		command_buffer.beginRenderPass(renderpass_info, vk::SubpassContents::eSecondaryCommandBuffers);
+		command_buffer.executeCommands(frame.ResumeCommandBuffer);
+		command_buffer.endRenderPass();
+	}
+	command_buffer.end();
+	m_secondaryCommandBuffers.clear();
 
     vk::PipelineStageFlags wait_stages[] = {
             vk::PipelineStageFlagBits::eColorAttachmentOutput
@@ -128,96 +260,664 @@ void GLVK::VK::GraphicsEngine::Render()
 
     auto submit_info = vk::SubmitInfo();
 	submit_info.commandBufferCount = 1;
-	submit_info.pCommandBuffers = &m_commandBuffers[m_currentImageIndex];
+	submit_info.pCommandBuffers = &command_buffer;
     submit_info.signalSemaphoreCount = 1;
-    submit_info.pSignalSemaphores = &m_renderCompletedSemaphores[m_currentImageIndex];
-    submit_info.pWaitSemaphores = &m_imageAcquiredSemaphores[m_currentImageIndex];
+    submit_info.pSignalSemaphores = &frame.RenderCompletedSemaphore;
+    submit_info.pWaitSemaphores = &frame.ImageAcquiredSemaphore;
     submit_info.pWaitDstStageMask = wait_stages;
     submit_info.waitSemaphoreCount = 1;
 
-    m_logicalDevice.resetFences(m_fences[m_currentImageIndex]);
-    m_graphicsQueue.submit(submit_info, m_fences[m_currentImageIndex]);
+    m_logicalDevice.resetFences(frame.Fence);
+	auto lock = std::unique_lock<std::mutex>{ m_graphicsQueueMutex };
+    m_graphicsQueue.submit(submit_info, frame.Fence);
 
     auto present_info = vk::PresentInfoKHR();
     present_info.waitSemaphoreCount = 1;
-    present_info.pWaitSemaphores = &m_renderCompletedSemaphores[m_currentImageIndex];
-    present_info.pImageIndices = &result.value;
+    present_info.pWaitSemaphores = &frame.RenderCompletedSemaphore;
+    present_info.pImageIndices = &image_index;
     present_info.pResults = nullptr;
     present_info.pSwapchains = &m_swapchain;
     present_info.swapchainCount = 1;
 
-    m_presentQueue.presentKHR(present_info);
-    m_logicalDevice.waitForFences(m_fences[m_currentImageIndex], VK_TRUE, std::numeric_limits<uint64_t>::max());
-    m_currentImageIndex = (m_currentImageIndex + 1) % m_images.size();
+	try
+	{
+		if (m_presentQueue.presentKHR(present_info) == vk::Result::eSuboptimalKHR) m_isSwapchainStale = true;
+	}
+	catch (const vk::OutOfDateKHRError&)
+	{
+		m_isSwapchainStale = true;
+	}
+	lock.unlock();
+    m_currentFrame = (m_currentFrame + 1) % m_frames.size();
 }
 
 void GLVK::VK::GraphicsEngine::BeginDraw()
 {
-	static const auto clear_color = vk::ClearColorValue(std::array<float, 4>{ 1.0f, 1.0f, 1.0f, 1.0f });
-	static const auto clear_depth = vk::ClearDepthStencilValue(1.0f, 0);
-	static const vk::ClearValue clear_values[] = { vk::ClearValue(clear_color), vk::ClearValue(clear_depth) };
-	auto renderpass_info = vk::RenderPassBeginInfo();
-	renderpass_info.renderPass = m_pipeline->GetRenderPass();
-	renderpass_info.renderArea.extent = m_extent;
-	renderpass_info.renderArea.offset = vk::Offset2D();
-	renderpass_info.clearValueCount = _countof(clear_values);
-	renderpass_info.pClearValues = clear_values;
+	m_drawList.clear();
+}
+
+void GLVK::VK::GraphicsEngine::EndDraw()
+{
+	// This frame's command pools are reset and its instance buffer rewritten, so the GPU has to be done with the frame's last submission.
+	auto& frame = m_frames[m_currentFrame];
+	m_logicalDevice.waitForFences(frame.Fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+	// Resizes are picked up here, before anything is recorded against the old extent. Not every platform reports them as
+	// an out of date swapchain, so the framebuffer size is compared as well.
+	auto width = 0;
+	auto height = 0;
+	glfwGetFramebufferSize(reinterpret_cast<GLFWwindow*>(m_handle), &width, &height);
+	if (m_isSwapchainStale || width != m_width || height != m_height) RecreateSwapchain();
+	ReleaseRetiredSwapchains(m_currentFrame);
+	m_textureTable->EndFrame();
+	CollectSubmittedUploads();
+	if (m_shaderCompiler && m_settings.ShaderHotReload) ReloadChangedShaders();
+	if (m_isSwapchainStale)
+	{
+		m_secondaryCommandBuffers.clear();
+		return;
+	}
+
+	auto is_replaced = BuildInstanceBatches(frame);
+	auto batch_count = static_cast<uint32_t>(m_instanceBatches.size());
+	auto instance_count = m_renderQueue.GetCount();
+	if (m_useIndirectDraws)
+		is_replaced = frame.DrawCommands->Reserve(m_useOcclusionCulling ? batch_count * 2 : batch_count) || is_replaced;
+	if (m_useOcclusionCulling && m_drawInstances.size() > m_visibilityCapacity)
+		CreateVisibilityBuffer(std::max(m_drawInstances.size(), m_visibilityCapacity * 2));
+
+	// The fence wait above also means neither the old buffers nor the descriptor sets pointing at them are still in use.
+	if (is_replaced || frame.IsCullSetStale)
+	{
+		WriteStorageDescriptors(frame);
+		frame.IsIndirectRecorded = false;
+		frame.IsCullSetStale = false;
+	}
+
+	m_bindStatistics = {};
+	m_bindStatistics.UnsortedBindCount = static_cast<uint32_t>(m_drawList.size() * 2);
+
+	// Batches are sorted by state first, so they all share one exactly when the first and the last do. Only then can a
+	// replayed command buffer, which binds one state up front, draw all of them.
+	auto recorded_state = SortKey::GetState(GetRecordedKey());
+	auto is_single_state = m_instanceBatches.empty() || SortKey::GetState(m_instanceBatches.back().Key) == recorded_state;
+	auto is_recorded = frame.IsIndirectRecorded && is_single_state && frame.RecordedState == recorded_state &&
+		frame.RecordedPipelineGeneration == m_pipeline->GetGeneration();
+
+	if (m_useIndirectDraws)
+	{
+		// With culling every batch starts out empty and the culling pass counts its visible instances.
+		frame.DrawCommands->Clear();
+		for (const auto& batch : m_instanceBatches)
+			frame.DrawCommands->Add(batch.IndexCount, m_useGpuCulling ? 0 : batch.InstanceCount, batch.FirstIndex, static_cast<int32_t>(batch.Geometry->FirstVertex), batch.FirstInstance);
+
+		// The second phase gets its own copy of every command, writing its instances behind all of the first phase's.
+		if (m_useOcclusionCulling)
+		{
+			for (const auto& batch : m_instanceBatches)
+				frame.DrawCommands->Add(batch.IndexCount, 0, batch.FirstIndex, static_cast<int32_t>(batch.Geometry->FirstVertex), batch.FirstInstance + static_cast<uint32_t>(instance_count));
+
+			auto extent = m_hizPyramid->GetExtent();
+			frame.Occlusion->ViewProjection = m_mvp.Projection * m_mvp.View;
+			frame.Occlusion->PyramidSize = glm::vec2(static_cast<float>(extent.width), static_cast<float>(extent.height));
+			frame.Occlusion->LevelCount = m_hizPyramid->GetLevelCount();
+
+			// The flags belong to draw list positions, so they only carry over while the same meshes are drawn in the same order.
+			if (m_drawInstances.size() != m_lastDrawInstanceCount || m_drawList != m_lastDrawList) m_isVisibilityReset = true;
+			m_lastDrawInstanceCount = m_drawInstances.size();
+			m_lastDrawList = m_drawList;
+
+			if (!is_recorded || frame.RecordedBatchCount != batch_count) RecordOcclusionCommands(frame);
+			m_secondaryCommandBuffers.assign(1, frame.IndirectCommandBuffer);
+			return;
+		}
+
+		// The draw count is read from the buffer, so the recorded commands do not depend on the draw list at all.
+		if (m_hasDrawIndirectCount && is_single_state)
+		{
+			if (!is_recorded) RecordIndirectCommands(frame);
+			m_secondaryCommandBuffers.assign(1, frame.IndirectCommandBuffer);
+			return;
+		}
+	}
+
+	// The swapchain image is not acquired yet, so the secondaries only name the render pass and leave the framebuffer open.
+	auto inheritance = vk::CommandBufferInheritanceInfo();
+	inheritance.renderPass = m_pipeline->GetRenderPass();
+	inheritance.subpass = 0;
+	inheritance.framebuffer = nullptr;
+
+	// With the depth pre-pass every batch is recorded twice, all depth-only draws ahead of all shaded ones. Secondaries execute
+	// in order, so the whole depth buffer is laid down before anything is shaded.
+	auto pre_pass_end = m_settings.DepthPrePass ? m_instanceBatches.size() : 0;
+	auto bind_count = std::atomic<uint32_t>(0);
+	auto skipped_bind_count = std::atomic<uint32_t>(0);
+	m_secondaryCommandBuffers = m_recorder->Record(m_currentFrame, inheritance, pre_pass_end + m_instanceBatches.size(), [&](const vk::CommandBuffer& commandBuffer, size_t first, size_t last) {
+		auto state = BoundState();
+		if (first < pre_pass_end)
+			RecordBatches(commandBuffer, frame, first, std::min(last, pre_pass_end), static_cast<uint32_t>(first), state, true);
+		if (last > pre_pass_end)
+		{
+			auto main_first = std::max(first, pre_pass_end) - pre_pass_end;
+			RecordBatches(commandBuffer, frame, main_first, last - pre_pass_end, static_cast<uint32_t>(main_first), state);
+		}
+		bind_count += state.BindCount;
+		skipped_bind_count += state.SkippedBindCount;
+		});
+
+	m_bindStatistics.RecordedBindCount = bind_count;
+	m_bindStatistics.SkippedBindCount = skipped_bind_count;
+}
+
+void GLVK::VK::GraphicsEngine::BindDrawState(const vk::CommandBuffer& commandBuffer, const FrameResources& frame, uint64_t key, BoundState& state) const
+{
+	// Viewport, scissor and the geometry pool are the same for every batch, so only the first call sets them. The depth
+	// pre-pass reads the position stream instead, which only swaps the vertex buffer since both streams share the indices.
+	auto shader_type = SortKey::GetPipeline(key);
+	auto is_position_only = shader_type == ShaderType::DepthPrePass;
+	if (!state.IsGeometryBound)
+	{
+		auto scissor = vk::Rect2D();
+		scissor.extent = m_extent;
+
+		commandBuffer.setViewport(0, { vk::Viewport(0.0f, 0.0f, static_cast<float>(m_extent.width), static_cast<float>(m_extent.height), 0.0f, 1.0f) });
+		commandBuffer.setScissor(0, { scissor });
+		m_geometryPool->Bind(commandBuffer, is_position_only);
+		state.IsGeometryBound = true;
+		state.IsPositionOnly = is_position_only;
+		state.BindCount += 2;
+	}
+	else if (state.IsPositionOnly != is_position_only)
+	{
+		m_geometryPool->BindVertices(commandBuffer, is_position_only);
+		state.IsPositionOnly = is_position_only;
+		++state.BindCount;
+		++state.SkippedBindCount;
+	}
+	else
+	{
+		state.SkippedBindCount += 2;
+	}
+
+	// A non-zero material is the slot of the draw's texture in the texture table plus one; those draws take the textured permutation.
+	auto material = is_position_only ? 0u : SortKey::GetMaterial(key);
+	auto blend_mode = SortKey::GetBlendMode(key);
+	const auto& pipeline = material == 0 ? m_pipeline->GetPipeline(blend_mode, shader_type) :
+		m_pipeline->GetPipeline(blend_mode, shader_type, m_pipeline->GetDefaultFeatures(shader_type) | ToFeatureBit(ShaderFeature::Textured));
+	if (pipeline != state.Pipeline)
+	{
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+		state.Pipeline = pipeline;
+		++state.BindCount;
+	}
+	else
+	{
+		++state.SkippedBindCount;
+	}
+
+	// Every graphics pipeline layout is made from the same set layouts, so the sets stay valid across pipeline changes.
+	// The instanced shaders read transforms from the instance buffer, but the set layout still has the two dynamic uniform bindings.
+	const auto& layout = m_pipeline->GetPipelineLayout(shader_type);
+	if (frame.DescriptorSet != state.DescriptorSet)
+	{
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 0, { frame.DescriptorSet, m_textureTable->GetDescriptorSet() }, { 0, 0 });
+		state.DescriptorSet = frame.DescriptorSet;
+		++state.BindCount;
+	}
+	else
+	{
+		++state.SkippedBindCount;
+	}
+
+	// Switching textures is only a push constant; the table itself stays bound.
+	if (material != 0 && material != state.Material)
+	{
+		auto texture_index = material - 1;
+		commandBuffer.pushConstants(layout, vk::ShaderStageFlagBits::eFragment, static_cast<uint32_t>(offsetof(PushConstant, TextureIndex)), sizeof(texture_index), &texture_index);
+		state.Material = material;
+	}
+}
+
+void GLVK::VK::GraphicsEngine::RecordBatches(const vk::CommandBuffer& commandBuffer, const FrameResources& frame, size_t first, size_t last, uint32_t firstCommand, BoundState& state, bool isDepthPrePass) const
+{
+	// A run of batches with the same state is bound once and, on the indirect path, issued as one draw call.
+	for (auto run = first; run < last;)
+	{
+		auto key = m_instanceBatches[run].Key;
+		auto run_state = SortKey::GetState(key);
+		auto run_end = run + 1;
+		while (run_end < last && SortKey::GetState(m_instanceBatches[run_end].Key) == run_state)
+			++run_end;
+
+		// The pre-pass draws the same commands without shading. Blended batches are left out, as their main pipelines keep the less-than test.
+		if (isDepthPrePass && SortKey::GetBlendMode(key) != BlendMode::None)
+		{
+			run = run_end;
+			continue;
+		}
+
+		BindDrawState(commandBuffer, frame, isDepthPrePass ? SortKey::SetPipeline(key, ShaderType::DepthPrePass) : key, state);
+
+		if (m_useIndirectDraws)
+		{
+			frame.DrawCommands->Draw(commandBuffer, firstCommand + static_cast<uint32_t>(run - first), static_cast<uint32_t>(run_end - run), m_hasMultiDrawIndirect);
+		}
+		else
+		{
+			for (auto i = run; i < run_end; ++i)
+			{
+				const auto& batch = m_instanceBatches[i];
+				commandBuffer.drawIndexed(batch.IndexCount, batch.InstanceCount, batch.FirstIndex, static_cast<int32_t>(batch.Geometry->FirstVertex), batch.FirstInstance);
+			}
+		}
+
+		run = run_end;
+	}
+}
+
+std::vector<GLVK::VK::RecordingBenchmarkResult> GLVK::VK::GraphicsEngine::BenchmarkRecording(size_t drawCount, const std::vector<size_t>& workerCounts, size_t repetitionCount)
+{
+	auto primitive = std::find_if(m_primitives.cbegin(), m_primitives.cend(), [](const auto& entry) {
+		return static_cast<bool>(entry.second.Geometry);
+		});
+	if (primitive == m_primitives.cend()) ::ThrowIfFailed("Create a mesh before benchmarking recording.\n");
+	const auto& mesh = primitive->second;
+
+	// Nothing recorded here is submitted, but the frame's descriptor set has to outlive the recording.
+	m_logicalDevice.waitIdle();
+	const auto& frame = m_frames[m_currentFrame];
+
+	auto inheritance = vk::CommandBufferInheritanceInfo();
+	inheritance.renderPass = m_pipeline->GetRenderPass();
+	inheritance.subpass = 0;
+	inheritance.framebuffer = nullptr;
+
+	// Every draw goes through the same bind check and issues its own call, like an unbatched draw list would.
+	auto key = SortKey::Encode(DrawPass::Opaque, ShaderType::Instanced, BlendMode::None, 0, 0, 0.0f);
+	auto record = [&](const vk::CommandBuffer& commandBuffer, size_t first, size_t last) {
+		auto state = BoundState();
+		for (auto i = first; i < last; ++i)
+		{
+			BindDrawState(commandBuffer, frame, key, state);
+			commandBuffer.drawIndexed(mesh.IndexCount, 1, mesh.Geometry->FirstIndex, static_cast<int32_t>(mesh.Geometry->FirstVertex), static_cast<uint32_t>(i));
+		}
+	};
+
+	auto results = std::vector<RecordingBenchmarkResult>();
+	for (auto worker_count : workerCounts)
+	{
+		auto recorder = CommandRecorder(m_logicalDevice, m_queueIndices.GraphicsQueue.value(), 1, std::max<size_t>(worker_count, 1), m_settings.MinDrawsPerRecordingThread);
+		auto result = RecordingBenchmarkResult();
+		result.WorkerCount = recorder.GetWorkerCount();
+		result.DrawCount = drawCount;
+		result.BestMilliseconds = std::numeric_limits<double>::max();
+
+		// The first pass grows the command pools and is not counted.
+		recorder.Record(0, inheritance, drawCount, record);
+		for (size_t i = 0; i < repetitionCount; ++i)
+		{
+			recorder.Record(0, inheritance, drawCount, record);
+			auto statistics = recorder.GetStatistics();
+			result.SliceCount = statistics.SliceCount;
+			result.AverageMilliseconds += statistics.RecordMilliseconds / static_cast<double>(repetitionCount);
+			result.BestMilliseconds = std::min(result.BestMilliseconds, statistics.RecordMilliseconds);
+		}
+		results.emplace_back(result);
+	}
+
+	return results;
+}
+
+uint64_t GLVK::VK::GraphicsEngine::GetRecordedKey() const noexcept
+{
+	// An empty frame still has to leave replayed buffers with a pipeline bound, since later frames may draw through them unchanged.
+	if (!m_instanceBatches.empty()) return m_instanceBatches.front().Key;
+	return SortKey::Encode(DrawPass::Opaque, ShaderType::Instanced, BlendMode::None, 0, 0, 0.0f);
+}
+
+void GLVK::VK::GraphicsEngine::RecordIndirectCommands(FrameResources& frame)
+{
+	auto inheritance = vk::CommandBufferInheritanceInfo();
+	inheritance.renderPass = m_pipeline->GetRenderPass();
+	inheritance.subpass = 0;
+	inheritance.framebuffer = nullptr;
+
 	auto begin_info = vk::CommandBufferBeginInfo();
-	begin_info.pInheritanceInfo = nullptr;
+	begin_info.flags = vk::CommandBufferUsageFlagBits::eRenderPassContinue;
+	begin_info.pInheritanceInfo = &inheritance;
+
+	auto key = GetRecordedKey();
+	auto state = BoundState();
+	frame.RecordedPipelineGeneration = m_pipeline->GetGeneration();
+	frame.IndirectCommandBuffer.reset();
+	frame.IndirectCommandBuffer.begin(begin_info);
+	if (m_settings.DepthPrePass && SortKey::GetBlendMode(key) == BlendMode::None)
+	{
+		BindDrawState(frame.IndirectCommandBuffer, frame, SortKey::SetPipeline(key, ShaderType::DepthPrePass), state);
+		frame.DrawCommands->DrawWithCount(frame.IndirectCommandBuffer);
+	}
+	BindDrawState(frame.IndirectCommandBuffer, frame, key, state);
+	frame.DrawCommands->DrawWithCount(frame.IndirectCommandBuffer);
+	frame.IndirectCommandBuffer.end();
+	frame.RecordedState = SortKey::GetState(key);
+	frame.IsIndirectRecorded = true;
+
+	m_bindStatistics.RecordedBindCount += state.BindCount;
+}
+
+void GLVK::VK::GraphicsEngine::RecordOcclusionCommands(FrameResources& frame)
+{
+	// The first half of the commands belongs to the first render pass and the second half to the resumed one. Draws with
+	// an instance count of zero cost next to nothing, so the buffers only depend on the number of batches.
+	auto batch_count = static_cast<uint32_t>(m_instanceBatches.size());
+	const vk::RenderPass render_passes[] = { m_pipeline->GetRenderPass(), m_pipeline->GetResumeRenderPass() };
+	vk::CommandBuffer* command_buffers[] = { &frame.IndirectCommandBuffer, &frame.ResumeCommandBuffer };
+
+	auto inheritance = vk::CommandBufferInheritanceInfo();
+	inheritance.subpass = 0;
+	inheritance.framebuffer = nullptr;
 
-	auto scissor = vk::Rect2D();
-	scissor.extent = m_extent;
+	auto begin_info = vk::CommandBufferBeginInfo();
+	begin_info.flags = vk::CommandBufferUsageFlagBits::eRenderPassContinue;
+	begin_info.pInheritanceInfo = &inheritance;
 
-	for (auto i = 0; i < m_commandBuffers.size(); ++i)
+	frame.RecordedPipelineGeneration = m_pipeline->GetGeneration();
+	for (uint32_t i = 0; i < _countof(command_buffers); ++i)
 	{
-		renderpass_info.framebuffer = m_framebuffers[i];
-		m_commandBuffers[i].begin(begin_info);
-		m_commandBuffers[i].beginRenderPass(renderpass_info, vk::SubpassContents::eInline);
+		auto& command_buffer = *command_buffers[i];
+		inheritance.renderPass = render_passes[i];
+
+		auto state = BoundState();
+		command_buffer.reset();
+		command_buffer.begin(begin_info);
+		if (m_settings.DepthPrePass)
+			RecordBatches(command_buffer, frame, 0, batch_count, i * batch_count, state, true);
+		RecordBatches(command_buffer, frame, 0, batch_count, i * batch_count, state);
+		command_buffer.end();
+
+		m_bindStatistics.RecordedBindCount += state.BindCount;
+		m_bindStatistics.SkippedBindCount += state.SkippedBindCount;
+	}
+
+	frame.RecordedBatchCount = batch_count;
+	frame.RecordedState = SortKey::GetState(GetRecordedKey());
+	frame.IsIndirectRecorded = true;
+}
 
-		m_commandBuffers[i].setViewport(0, { vk::Viewport(0.0f, 0.0f, static_cast<float>(m_extent.width), static_cast<float>(m_extent.height), 0.0f, 1.0f) });
-		m_commandBuffers[i].setScissor(0, { scissor });
-		/*m_commandBuffers[i].bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipeline->GetPipelineLayout(), 0, { m_descriptorSet }, { 0 });*/
-		m_commandBuffers[i].bindPipeline(vk::PipelineBindPoint::eGraphics, m_pipeline->GetPipeline(BlendMode::None, ShaderType::BasicShader));
+void GLVK::VK::GraphicsEngine::CreateVisibilityBuffer(size_t capacity)
+{
+	// Every frame's culling set refers to the buffer, so replacing it has to wait until none of them is in flight.
+	if (m_visibilityBuffer)
+	{
+		for (const auto& frame : m_frames)
+			m_logicalDevice.waitForFences(frame.Fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+	}
+
+	auto size = static_cast<vk::DeviceSize>(sizeof(uint32_t) * capacity);
+	m_visibilityBuffer = std::make_unique<Buffer>(m_logicalDevice, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, size);
+	m_visibilityBuffer->AllocateMemory(*m_allocator, vk::MemoryPropertyFlagBits::eDeviceLocal, AllocationPool::FreeList, MemoryCategory::Other);
+	m_visibilityCapacity = capacity;
+	m_isVisibilityReset = true;
+
+	// At start-up the sets do not exist yet and CreateDescriptorSets() writes them.
+	for (const auto& frame : m_frames)
+	{
+		if (frame.CullDescriptorSet) WriteStorageDescriptors(frame);
 	}
 }
 
-void GLVK::VK::GraphicsEngine::EndDraw()
+bool GLVK::VK::GraphicsEngine::BuildInstanceBatches(FrameResources& frame)
+{
+	// Every mesh in the draw list becomes one instance with a sort key. Sorting puts all instances of a mesh at the same level
+	// next to each other, so copies of a model or primitive collapse into a single instanced draw, and batches that share a
+	// pipeline and material end up adjacent so the recorder binds them once.
+	m_drawInstances.clear();
+	m_renderQueue.Clear();
+	m_geometryIds.clear();
+	m_queuedMeshes.clear();
+	m_instanceBatches.clear();
+	m_cullBounds.Clear();
+
+	for (const auto& item : m_drawList)
+	{
+		std::visit([&](auto* drawable) {
+			auto instance = CullInstanceData();
+			instance.Instance.World = drawable->GetWorldMatrix();
+			instance.Instance.Color = drawable->Color;
+
+			auto add_mesh = [&](MESH& mesh) {
+				if (!mesh.Geometry || m_pendingGeometry.contains(mesh.Geometry.get())) return;
+				auto sphere = TransformBoundingSphere(mesh.Sphere, instance.Instance.World);
+				if (m_useGpuCulling) instance.BoundingSphere = sphere;
+				if (m_useCpuCulling) m_cullBounds.Add(sphere);
+
+				auto center = mesh.Sphere.IsValid() ? glm::vec3(sphere) : glm::vec3(instance.Instance.World[3]);
+				auto distance = glm::length(glm::vec3(m_mvp.View * glm::vec4(center, 1.0f)));
+				auto level = SelectLod(mesh, sphere, distance);
+
+				auto [entry, is_new] = m_geometryIds.try_emplace(mesh.Geometry.get(), static_cast<uint32_t>(m_queuedMeshes.size()));
+				if (is_new) m_queuedMeshes.emplace_back(&mesh);
+				auto geometry = entry->second * MeshLod::MAX_LEVEL_COUNT + level;
+				if (geometry >= SortKey::GEOMETRY_LIMIT) ::ThrowIfFailed("Too many distinct geometries in one frame for the sort key.\n");
+
+				// Until its texture is submitted the mesh is drawn untextured.
+				auto material = 0u;
+				if (!mesh.TextureIndices.empty() && !m_pendingTextures.contains(mesh.TextureIndices.front()))
+					material = mesh.TextureIndices.front() + 1;
+				auto key = SortKey::Encode(DrawPass::Opaque, ShaderType::Instanced, BlendMode::None, material, geometry, distance);
+				m_renderQueue.Push(key, static_cast<uint32_t>(m_drawInstances.size()));
+				m_drawInstances.emplace_back(instance);
+			};
+
+			if constexpr (std::is_same_v<std::decay_t<decltype(*drawable)>, MODEL>)
+			{
+				for (auto& mesh : drawable->Meshes)
+					add_mesh(mesh);
+			}
+			else
+			{
+				add_mesh(*drawable);
+			}
+			}, item);
+	}
+
+	// Visible indices come back in ascending order, so the surviving entries can be compacted in place.
+	if (m_useCpuCulling)
+	{
+		CullSpheres(Frustum::FromViewProjection(m_mvp.Projection * m_mvp.View), m_cullBounds, m_visibleInstances);
+		m_renderQueue.Compact(m_visibleInstances);
+	}
+
+	m_renderQueue.Sort();
+
+	auto instance_count = m_renderQueue.GetCount();
+	auto is_replaced = instance_count > frame.InstanceCapacity;
+	if (is_replaced)
+		CreateInstanceBuffer(frame, std::max(instance_count, frame.InstanceCapacity * 2));
+
+	// Within a batch the instances stay in depth order, nearest first, which helps early depth testing.
+	for (uint32_t i = 0; i < instance_count; ++i)
+	{
+		const auto& item = m_renderQueue[i];
+		if (m_instanceBatches.empty() || (m_instanceBatches.back().Key >> SortKey::DEPTH_BITS) != (item.Key >> SortKey::DEPTH_BITS))
+		{
+			auto geometry = SortKey::GetGeometry(item.Key);
+			const auto* mesh = m_queuedMeshes[geometry / MeshLod::MAX_LEVEL_COUNT];
+			auto level = geometry % MeshLod::MAX_LEVEL_COUNT;
+			auto lod = mesh->GetLod(level);
+
+			auto& batch = m_instanceBatches.emplace_back();
+			batch.Key = item.Key;
+			batch.Geometry = mesh->Geometry.get();
+			batch.Lod = level;
+			batch.FirstIndex = batch.Geometry->FirstIndex + lod.FirstIndex;
+			batch.IndexCount = lod.IndexCount;
+			batch.FirstInstance = i;
+		}
+		++m_instanceBatches.back().InstanceCount;
+
+		if (m_useGpuCulling)
+		{
+			frame.CullInstances[i] = m_drawInstances[item.Instance];
+			frame.CullInstances[i].BatchIndex = static_cast<uint32_t>(m_instanceBatches.size() - 1);
+			frame.CullInstances[i].VisibilityIndex = item.Instance;
+		}
+		else
+		{
+			frame.Instances[i] = m_drawInstances[item.Instance].Instance;
+		}
+	}
+
+	m_lodStatistics = {};
+	for (const auto& batch : m_instanceBatches)
+	{
+		m_lodStatistics.InstanceCounts[batch.Lod] += batch.InstanceCount;
+		m_lodStatistics.TriangleCounts[batch.Lod] += static_cast<uint64_t>(batch.IndexCount / 3) * batch.InstanceCount;
+	}
+
+	return is_replaced;
+}
+
+uint32_t GLVK::VK::GraphicsEngine::SelectLod(MESH& mesh, const glm::vec4& sphere, float distance) const
 {
-	for (auto i = 0; i < m_commandBuffers.size(); ++i)
+	auto level_count = mesh.GetLodCount();
+	if (level_count == 1 || !mesh.Sphere.IsValid() || mesh.Sphere.Radius <= 0.0f) return 0;
+
+	// A level's error in pixels is its object space error, scaled like the mesh, over the distance to the nearest point of the bounding sphere.
+	distance -= sphere.w;
+	if (distance <= 0.0f)
 	{
-		m_commandBuffers[i].endRenderPass();
-		m_commandBuffers[i].end();
+		mesh.SelectedLod = 0;
+		return 0;
 	}
+
+	auto pixels_per_unit = std::abs(m_mvp.Projection[1][1]) * static_cast<float>(m_extent.height) * 0.5f / distance;
+	auto scale = sphere.w / mesh.Sphere.Radius;
+	auto get_error = [&](uint32_t level) {
+		return mesh.GetLod(level).Error * scale * pixels_per_unit;
+	};
+
+	// Refine right away when the last level got too coarse, but only coarsen with some margin left.
+	auto threshold = m_settings.LodPixelError * std::exp2(m_settings.LodBias);
+	auto level = std::min(mesh.SelectedLod, level_count - 1);
+	while (level > 0 && get_error(level) > threshold)
+		--level;
+	while (level + 1 < level_count && get_error(level + 1) <= threshold * (1.0f - m_settings.LodHysteresis))
+		++level;
+
+	mesh.SelectedLod = level;
+	return level;
+}
+
+void GLVK::VK::GraphicsEngine::WriteStorageDescriptors(const FrameResources& frame)
+{
+	auto instance_buffer_info = vk::DescriptorBufferInfo();
+	instance_buffer_info.buffer = frame.InstanceBuffer->GetBuffer();
+	instance_buffer_info.offset = 0;
+	instance_buffer_info.range = VK_WHOLE_SIZE;
+
+	auto write_descriptors = std::vector<vk::WriteDescriptorSet>(1);
+	write_descriptors[0].descriptorCount = 1;
+	write_descriptors[0].descriptorType = vk::DescriptorType::eStorageBuffer;
+	write_descriptors[0].dstArrayElement = 0;
+	write_descriptors[0].dstBinding = 4;
+	write_descriptors[0].dstSet = frame.DescriptorSet;
+	write_descriptors[0].pBufferInfo = &instance_buffer_info;
+
+	// The culling pass reads the CPU written instances, writes the visible ones and bumps the indirect instance counts.
+	// Occlusion culling also reads the visibility flags (binding 4) and the OcclusionData uniform (binding 5).
+	vk::DescriptorBufferInfo cull_buffer_infos[6] = {};
+	if (m_useGpuCulling)
+	{
+		cull_buffer_infos[0].buffer = frame.CullInputBuffer->GetBuffer();
+		cull_buffer_infos[1].buffer = frame.InstanceBuffer->GetBuffer();
+		cull_buffer_infos[2].buffer = frame.DrawCommands->GetBuffer().GetBuffer();
+		if (m_useOcclusionCulling)
+		{
+			cull_buffer_infos[4].buffer = m_visibilityBuffer->GetBuffer();
+			cull_buffer_infos[5].buffer = frame.OcclusionBuffer->GetBuffer();
+		}
+
+		for (uint32_t i = 0; i < _countof(cull_buffer_infos); ++i)
+		{
+			if (!cull_buffer_infos[i].buffer) continue;
+			cull_buffer_infos[i].offset = 0;
+			cull_buffer_infos[i].range = VK_WHOLE_SIZE;
+
+			auto& write_descriptor = write_descriptors.emplace_back();
+			write_descriptor.descriptorCount = 1;
+			write_descriptor.descriptorType = i == 5 ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer;
+			write_descriptor.dstArrayElement = 0;
+			write_descriptor.dstBinding = i;
+			write_descriptor.dstSet = frame.CullDescriptorSet;
+			write_descriptor.pBufferInfo = &cull_buffer_infos[i];
+		}
+	}
+
+	auto pyramid_info = vk::DescriptorImageInfo();
+	if (m_useOcclusionCulling)
+	{
+		pyramid_info.imageLayout = vk::ImageLayout::eGeneral;
+		pyramid_info.imageView = m_hizPyramid->GetImageView();
+		pyramid_info.sampler = m_hizPyramid->GetSampler();
+
+		auto& write_descriptor = write_descriptors.emplace_back();
+		write_descriptor.descriptorCount = 1;
+		write_descriptor.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+		write_descriptor.dstArrayElement = 0;
+		write_descriptor.dstBinding = 3;
+		write_descriptor.dstSet = frame.CullDescriptorSet;
+		write_descriptor.pImageInfo = &pyramid_info;
+	}
+
+	m_logicalDevice.updateDescriptorSets(write_descriptors, {});
+}
+
+void GLVK::VK::GraphicsEngine::RecordCulling(const vk::CommandBuffer& commandBuffer, const FrameResources& frame, uint32_t phase) const
+{
+	auto instance_count = static_cast<uint32_t>(m_renderQueue.GetCount());
+	if (instance_count == 0) return;
+
+	// The visibility flags were last written by the previous culling pass, and the instances this pass overwrites may still be
+	// read by earlier draws. A reset fill is fenced off in Render().
+	if (m_useOcclusionCulling)
+	{
+		auto barrier = vk::MemoryBarrier();
+		barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+		barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexShader,
+			vk::PipelineStageFlagBits::eComputeShader, {}, barrier, {}, {});
+	}
+
+	auto constants = CullPushConstant();
+	auto frustum = Frustum::FromViewProjection(m_mvp.Projection * m_mvp.View);
+	std::copy(frustum.Planes.cbegin(), frustum.Planes.cend(), constants.Planes);
+	constants.InstanceCount = instance_count;
+	constants.BatchCount = static_cast<uint32_t>(m_instanceBatches.size());
+	constants.Phase = phase;
+
+	const auto& layout = m_pipeline->GetPipelineLayout(ShaderType::FrustumCull);
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline->GetComputePipeline(ShaderType::FrustumCull));
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, layout, 0, { frame.CullDescriptorSet }, {});
+	commandBuffer.pushConstants<CullPushConstant>(layout, vk::ShaderStageFlagBits::eCompute, 0, { constants });
+	commandBuffer.dispatch((instance_count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+	auto barrier = vk::MemoryBarrier();
+	barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+	barrier.dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead;
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexShader, {}, barrier, {}, {});
 }
 
 std::shared_ptr<IDisposable> GLVK::VK::GraphicsEngine::CreateVertexBuffer(const std::vector<Vertex>& vertices)
 {
 	vk::DeviceSize buffer_size = sizeof(Vertex) * vertices.size();
-	m_intermediateBuffer.reset(new Buffer(m_logicalDevice, vk::BufferUsageFlagBits::eTransferSrc, buffer_size));
-	auto memory = m_intermediateBuffer->AllocateMemory(m_physicalDevice, vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostVisible);
-	void* mapped = m_logicalDevice.mapMemory(memory, 0, buffer_size);
-	memcpy(mapped, vertices.data(), buffer_size);
-	m_logicalDevice.unmapMemory(memory);
-
-	auto buffer = std::make_shared<Buffer>(m_logicalDevice, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer, buffer_size);
-	buffer->AllocateMemory(m_physicalDevice, vk::MemoryPropertyFlagBits::eDeviceLocal);
-	buffer->CopyBufferToBuffer(m_intermediateBuffer->GetBuffer(), buffer_size, m_commandPool, m_graphicsQueue);
-	return buffer;
+	return UploadBuffer(vertices.data(), buffer_size, vk::BufferUsageFlagBits::eVertexBuffer);
 }
 
 std::shared_ptr<IDisposable> GLVK::VK::GraphicsEngine::CreateIndexBuffer(const std::vector<uint32_t>& indices)
 {
 	vk::DeviceSize buffer_size = sizeof(uint32_t) * indices.size();
-	m_intermediateBuffer.reset(new Buffer(m_logicalDevice, vk::BufferUsageFlagBits::eTransferSrc, buffer_size));
-	auto memory = m_intermediateBuffer->AllocateMemory(m_physicalDevice, vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostVisible);
-	void* mapped = m_logicalDevice.mapMemory(memory, 0, buffer_size);
-	memcpy(mapped, indices.data(), buffer_size);
-	m_logicalDevice.unmapMemory(memory);
-
-	auto buffer = std::make_shared<Buffer>(m_logicalDevice, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer, buffer_size);
-	buffer->AllocateMemory(m_physicalDevice, vk::MemoryPropertyFlagBits::eDeviceLocal);
-	buffer->CopyBufferToBuffer(m_intermediateBuffer->GetBuffer(), buffer_size, m_commandPool, m_graphicsQueue);
-	return buffer;
+	return UploadBuffer(indices.data(), buffer_size, vk::BufferUsageFlagBits::eIndexBuffer);
 }
 
 std::tuple<IDisposable*, unsigned int> GLVK::VK::GraphicsEngine::LoadTexture(std::string_view fileName)
@@ -228,25 +928,170 @@ std::tuple<IDisposable*, unsigned int> GLVK::VK::GraphicsEngine::LoadTexture(std
 	auto image = stbi_load(fileName.data(), &width, &height, &channels, STBI_rgb_alpha);
 	auto size = static_cast<vk::DeviceSize>(width) * height * 4;
 
-	m_intermediateBuffer.reset(new Buffer(m_logicalDevice, vk::BufferUsageFlagBits::eTransferSrc, size));
-	m_intermediateBuffer->AllocateMemory(m_physicalDevice, vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostVisible);
-	auto mapped_data = m_logicalDevice.mapMemory(m_intermediateBuffer->GetDeviceMemory(), 0, size);
-	memcpy(mapped_data, image, size);
-	m_logicalDevice.unmapMemory(m_intermediateBuffer->GetDeviceMemory());
-	stbi_image_free(image);
-
 	auto mip_level_count = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
 
 	auto texture = std::make_unique<Image>(m_logicalDevice, m_format, vk::SampleCountFlagBits::e1, vk::Extent2D(static_cast<uint32_t>(width), static_cast<uint32_t>(height)), vk::ImageType::e2D, mip_level_count, vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled);
-	texture->AllocateMemory(m_physicalDevice, vk::MemoryPropertyFlagBits::eDeviceLocal);
-	texture->TransitionLayout(vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, m_commandPool, m_graphicsQueue, vk::ImageAspectFlagBits::eColor, mip_level_count);
-	m_intermediateBuffer->CopyBufferToImage(texture->GetImage(), static_cast<uint32_t>(height), static_cast<uint32_t>(width), size, vk::ImageAspectFlagBits::eColor, m_commandPool, m_graphicsQueue);
-	texture->GenerateMipmaps(m_commandPool, m_graphicsQueue, mip_level_count);
+	texture->AllocateMemory(*m_allocator, vk::MemoryPropertyFlagBits::eDeviceLocal, AllocationPool::FreeList, MemoryCategory::Textures);
+	m_uploader->Enqueue([image, size, target = texture.get(), width, height, mip_level_count](UploadBatch& batch) {
+		batch.CopyToImage(image, size, *target, static_cast<uint32_t>(width), static_cast<uint32_t>(height), mip_level_count);
+		stbi_image_free(image);
+		});
+	m_hasUnflushedUploads = true;
 	texture->CreateImageView(m_format, vk::ImageAspectFlagBits::eColor, mip_level_count, vk::ImageViewType::e2D);
 	texture->CreateSampler(mip_level_count);
-	auto ptr = m_textures.emplace_back(m_resourceManager->AddResource(texture));
-	auto index = m_textures.empty() ? 0 : m_textures.size() - 1;
-	return std::make_tuple(ptr, static_cast<uint32_t>(index));
+	auto slot = m_textureTable->Add(texture->GetImageView(), texture->GetSampler());
+	m_pendingTextures[slot] = m_flushCount;
+	if (slot >= m_textures.size()) m_textures.resize(slot + 1, nullptr);
+	auto ptr = m_resourceManager->AddResource(texture);
+	m_textures[slot] = ptr;
+	return std::make_tuple(ptr, slot);
+}
+
+void GLVK::VK::GraphicsEngine::ReleaseTexture(uint32_t index)
+{
+	if (index >= m_textures.size() || !m_textures[index]) return;
+	auto* texture = m_textures[index];
+	m_textures[index] = nullptr;
+
+	for (auto* mesh : m_meshes)
+	{
+		std::erase(mesh->Textures, texture);
+		std::erase(mesh->TextureIndices, index);
+	}
+	for (auto* model : m_models)
+	{
+		for (auto& mesh : model->Meshes)
+		{
+			std::erase(mesh.Textures, texture);
+			std::erase(mesh.TextureIndices, index);
+		}
+	}
+
+	auto pending = m_pendingTextures.find(index);
+	if (pending == m_pendingTextures.end())
+	{
+		RetireTexture(index, texture->Name);
+		return;
+	}
+
+	auto& released = m_releasedTextures.emplace_back();
+	released.Slot = index;
+	released.FlushCount = pending->second;
+	released.Name = texture->Name;
+	m_pendingTextures.erase(pending);
+}
+
+void GLVK::VK::GraphicsEngine::RetireTexture(uint32_t slot, std::string name)
+{
+	// The slot retires after FramesInFlight frames, the same delay after which the image is no longer sampled either.
+	m_textureTable->Remove(slot, [this, name = std::move(name)]() {
+		m_resourceManager->RemoveResource(name);
+		});
+}
+
+std::shared_ptr<GLVK::VK::Buffer> GLVK::VK::GraphicsEngine::UploadBuffer(const void* data, vk::DeviceSize size, const vk::BufferUsageFlags& bufferUsage)
+{
+	auto buffer = std::make_shared<Buffer>(m_logicalDevice, vk::BufferUsageFlagBits::eTransferDst | bufferUsage, size);
+	buffer->AllocateMemory(*m_allocator, vk::MemoryPropertyFlagBits::eDeviceLocal, AllocationPool::FreeList, MemoryCategory::Geometry);
+
+	// The job runs on the upload thread after this returns, so it gets its own copy instead of the caller's pointer.
+	auto bytes = std::make_shared<std::vector<uint8_t>>(reinterpret_cast<const uint8_t*>(data), reinterpret_cast<const uint8_t*>(data) + size);
+	m_uploader->Enqueue([bytes, buffer](UploadBatch& batch) {
+		batch.CopyToBuffer(bytes->data(), bytes->size(), *buffer);
+		});
+	m_hasUnflushedUploads = true;
+	return buffer;
+}
+
+void GLVK::VK::GraphicsEngine::UploadGeometry(MESH& mesh, MeshDataRetention retention)
+{
+	// A mesh whose CPU arrays were already released can only be uploaded again from its compressed copy.
+	if (mesh.Vertices.empty() && mesh.CompressedData)
+		mesh.CompressedData->Decompress(mesh.Vertices, mesh.Indices);
+
+	if (!mesh.Vertices.empty())
+	{
+		mesh.Bounds = BoundingBox::FromVertices(mesh.Vertices);
+		mesh.Sphere = BoundingSphere::FromVertices(mesh.Vertices, mesh.Bounds);
+	}
+
+	mesh.VertexCount = static_cast<uint32_t>(mesh.Vertices.size());
+	mesh.IndexCount = static_cast<uint32_t>(mesh.Indices.size());
+	mesh.Geometry = m_geometryPool->Allocate(mesh.VertexCount, mesh.IndexCount);
+	m_pendingGeometry[mesh.Geometry.get()] = m_flushCount;
+
+	// Unless the data is kept, the upload job takes the arrays over and frees them once they are in the staging ring.
+	auto data = std::shared_ptr<ShapeData>();
+	if (retention != MeshDataRetention::Keep)
+	{
+		if (retention == MeshDataRetention::Compress && !mesh.CompressedData)
+			mesh.CompressedData = std::make_shared<const CompressedMeshData>(CompressedMeshData::Compress(mesh.Vertices, mesh.Indices));
+
+		data = std::make_shared<ShapeData>();
+		data->Vertices = std::exchange(mesh.Vertices, {});
+		data->Indices = std::exchange(mesh.Indices, {});
+	}
+
+	const auto* vertices = data ? &data->Vertices : &mesh.Vertices;
+	const auto* indices = data ? &data->Indices : &mesh.Indices;
+	m_uploader->Enqueue([vertices, indices, data, range = mesh.Geometry, pool = m_geometryPool.get()](UploadBatch& batch) {
+		if (!vertices->empty())
+			batch.CopyToBuffer(vertices->data(), sizeof(Vertex) * vertices->size(), pool->GetVertexBuffer(), sizeof(Vertex) * range->FirstVertex);
+
+		// The depth pre-pass reads a tightly packed copy of the positions, which fetches a third of the bytes per vertex.
+		if (!vertices->empty() && pool->HasPositionStream())
+		{
+			auto positions = std::vector<Vector3>(vertices->size());
+			std::transform(vertices->cbegin(), vertices->cend(), positions.begin(), [](const Vertex& vertex) { return vertex.Position; });
+			batch.CopyToBuffer(positions.data(), sizeof(Vector3) * positions.size(), pool->GetPositionBuffer(), sizeof(Vector3) * range->FirstVertex);
+		}
+		if (!indices->empty())
+			batch.CopyToBuffer(indices->data(), sizeof(uint32_t) * indices->size(), pool->GetIndexBuffer(), sizeof(uint32_t) * range->FirstIndex);
+		});
+	m_hasUnflushedUploads = true;
+}
+
+MeshDataRetention GLVK::VK::GraphicsEngine::GetMeshDataRetention(std::string_view modelName) const
+{
+	auto iter = m_meshDataRetentions.find(std::string(modelName));
+	return iter != m_meshDataRetentions.cend() ? iter->second : m_settings.MeshRetention;
+}
+
+std::shared_future<GLVK::VK::UploadToken> GLVK::VK::GraphicsEngine::FlushUploads()
+{
+	auto upload = m_uploader->Flush();
+	m_pendingUploads.emplace_back(upload);
+	m_hasUnflushedUploads = false;
+	++m_flushCount;
+	return upload;
+}
+
+void GLVK::VK::GraphicsEngine::CollectSubmittedUploads()
+{
+	// Flushes are submitted in order, so the oldest pending one is the only one worth looking at.
+	auto submitted_count = m_submittedFlushCount;
+	while (!m_pendingUploads.empty() && m_pendingUploads.front().wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+	{
+		// A failed upload is rethrown here, on the render thread.
+		m_pendingUploads.front().get();
+		m_pendingUploads.pop_front();
+		++m_submittedFlushCount;
+	}
+	if (submitted_count == m_submittedFlushCount) return;
+
+	// The frame is submitted to the graphics queue after the uploads' ownership acquires, so it may draw with their resources now.
+	auto is_submitted = [this](const auto& entry) {
+		return entry.second < m_submittedFlushCount;
+	};
+	std::erase_if(m_pendingGeometry, is_submitted);
+	std::erase_if(m_pendingTextures, is_submitted);
+
+	// The frame that acquires a released texture's upload is the last one that touches its image.
+	std::erase_if(m_releasedTextures, [this](ReleasedTexture& texture) {
+		if (texture.FlushCount >= m_submittedFlushCount) return false;
+		RetireTexture(texture.Slot, std::move(texture.Name));
+		return true;
+		});
 }
 
 std::tuple<IDisposable*, unsigned int> GLVK::VK::GraphicsEngine::LoadModel(std::string_view modelName, const Vector3& position, const Vector3& scale, const Vector3& rotation, const Vector4& color)
@@ -267,14 +1112,17 @@ std::tuple<IDisposable*, unsigned int> GLVK::VK::GraphicsEngine::LoadModel(std::
 	}
 	else
 	{
-		model->Load(modelName, this, position, scale, rotation, color);	
+		model->Load(modelName, this, position, scale, rotation, color, m_settings.LodGeneration);	
 	}
 	auto ptr = m_models.emplace_back(m_resourceManager->AddResource(model, modelName));
+	// Copies of an already loaded model share the meshes' pool ranges instead of uploading the geometry again,
+	// so they work without the CPU arrays.
+	auto retention = GetMeshDataRetention(modelName);
 	for (auto& mesh : ptr->Meshes)
 	{
-		mesh.VertexBuffer = std::dynamic_pointer_cast<Buffer>(CreateVertexBuffer(mesh.Vertices));
-		mesh.IndexBuffer = std::dynamic_pointer_cast<Buffer>(CreateIndexBuffer(mesh.Indices));
+		if (!mesh.Geometry) UploadGeometry(mesh, retention);
 	}
+	FlushUploads();
 	size_t index = m_dynamicBufferObject.Models.ModelIndices.emplace_back(static_cast<uint32_t>(m_dynamicBufferObject.Models.ModelIndices.size()));
 	m_dynamicBufferObject.Models.Models.emplace_back(ptr->GetWorldMatrix());
 	return std::make_tuple(ptr, static_cast<uint32_t>(index));
@@ -284,22 +1132,50 @@ std::tuple<IDisposable*, unsigned int> GLVK::VK::GraphicsEngine::CreateMesh(cons
 {
 	auto mesh = std::make_unique<MESH>();
 	auto& ptr = m_meshes.emplace_back(m_resourceManager->AddResource(mesh));
-	ptr->Vertices = m_shapeData.at(primitiveType).Vertices;
-	ptr->Indices = m_shapeData.at(primitiveType).Indices;
-	ptr->VertexBuffer = std::dynamic_pointer_cast<Buffer>(CreateVertexBuffer(ptr->Vertices));
-	ptr->IndexBuffer = std::dynamic_pointer_cast<Buffer>(CreateIndexBuffer(ptr->Indices));
-	ptr->Position = position;
-	ptr->ScaleX = scale.x;
-	ptr->ScaleY = scale.y;
-	ptr->ScaleZ = scale.z;
-	ptr->RotationX = rotation.x;
-	ptr->RotationY = rotation.y;
-	ptr->RotationZ = rotation.z;
-	ptr->Color = color;
+
+	// Meshes of the same primitive share one pool range, which is what lets them be drawn as instances of each other.
+	auto primitive = m_primitives.find(primitiveType);
+	if (primitive == m_primitives.end())
+	{
+		ptr->Vertices = m_shapeData.at(primitiveType).Vertices;
+		ptr->Indices = m_shapeData.at(primitiveType).Indices;
+		UploadGeometry(*ptr, m_settings.MeshRetention);
+		FlushUploads();
+		m_primitives.emplace(primitiveType, *ptr);
+	}
+	else
+	{
+		*ptr = primitive->second;
+	}
+
+	return PlaceMesh(*ptr, position, scale, rotation, color);
+}
+
+std::tuple<IDisposable*, unsigned int> GLVK::VK::GraphicsEngine::CreateMesh(ShapeData shapeData, const Vector3& position, const Vector3& scale, const Vector3& rotation, const Vector4& color)
+{
+	auto mesh = std::make_unique<MESH>();
+	auto& ptr = m_meshes.emplace_back(m_resourceManager->AddResource(mesh));
+	ptr->Vertices = std::move(shapeData.Vertices);
+	ptr->Indices = std::move(shapeData.Indices);
+	UploadGeometry(*ptr, m_settings.MeshRetention);
+	FlushUploads();
+	return PlaceMesh(*ptr, position, scale, rotation, color);
+}
+
+std::tuple<IDisposable*, unsigned int> GLVK::VK::GraphicsEngine::PlaceMesh(MESH& mesh, const Vector3& position, const Vector3& scale, const Vector3& rotation, const Vector4& color)
+{
+	mesh.Position = position;
+	mesh.ScaleX = scale.x;
+	mesh.ScaleY = scale.y;
+	mesh.ScaleZ = scale.z;
+	mesh.RotationX = rotation.x;
+	mesh.RotationY = rotation.y;
+	mesh.RotationZ = rotation.z;
+	mesh.Color = color;
 
 	size_t model_index = m_dynamicBufferObject.Meshes.ModelIndices.emplace_back(m_dynamicBufferObject.Meshes.ModelIndices.size());
-	m_dynamicBufferObject.Meshes.Models.emplace_back(ptr->GetWorldMatrix());
-	return std::make_tuple(ptr, static_cast<uint32_t>(model_index));
+	m_dynamicBufferObject.Meshes.Models.emplace_back(mesh.GetWorldMatrix());
+	return std::make_tuple(&mesh, static_cast<uint32_t>(model_index));
 }
 
 std::vector<const char*> GLVK::VK::GraphicsEngine::GetRequiredExtensions(bool debug) noexcept
@@ -361,6 +1237,7 @@ bool GLVK::VK::GraphicsEngine::IsDeviceSuitable(const vk::PhysicalDevice& device
 		CheckExtensionSupport(device) &&
 		is_swapchain_adequate &&
 		indexing_feature.descriptorBindingPartiallyBound &&
+		indexing_feature.descriptorBindingSampledImageUpdateAfterBind &&
 		indexing_feature.runtimeDescriptorArray;
 }
 
@@ -371,22 +1248,36 @@ GLVK::VK::QueueIndices GLVK::VK::GraphicsEngine::GetQueueIndices(const vk::Physi
 	
 	for (uint32_t i = 0; i < properties.size(); ++i)
 	{
+		if (properties[i].queueCount == 0) continue;
+
 		auto surface_support = device.getSurfaceSupportKHR(i, surface);
+		auto flags = properties[i].queueFlags;
 
-		if (properties[i].queueCount > 0 && (properties[i].queueFlags & vk::QueueFlagBits::eGraphics))
+		if (!queue_indices.GraphicsQueue.has_value() && (flags & vk::QueueFlagBits::eGraphics))
 		{
 			queue_indices.GraphicsQueue = i;
 		}
 
-		if (properties[i].queueCount > 0 && surface_support)
+		if (!queue_indices.PresentQueue.has_value() && surface_support)
 		{
 			queue_indices.PresentQueue = i;
 		}
 
-		if (queue_indices.IsCompleted())
-			return queue_indices;
+		// Prefer a pure DMA family; one that also does compute is the next best thing.
+		if ((flags & vk::QueueFlagBits::eTransfer) && !(flags & vk::QueueFlagBits::eGraphics))
+		{
+			if (!queue_indices.TransferQueue.has_value() || !(flags & vk::QueueFlagBits::eCompute))
+				queue_indices.TransferQueue = i;
+		}
 	}
-	return QueueIndices();
+
+	if (!queue_indices.IsCompleted())
+		return QueueIndices();
+
+	if (!queue_indices.TransferQueue.has_value())
+		queue_indices.TransferQueue = queue_indices.GraphicsQueue;
+
+	return queue_indices;
 }
 
 bool GLVK::VK::GraphicsEngine::CheckExtensionSupport(const vk::PhysicalDevice& device) noexcept
@@ -407,21 +1298,39 @@ void GLVK::VK::GraphicsEngine::Initialize()
 	try
 	{
 		CreateSwapchain();
+		if (m_useOcclusionCulling)
+			m_hizPyramid = std::make_unique<HiZPyramid>(m_logicalDevice, *m_allocator, m_extent);
 		CreateUniformBuffers();
 		CreateDescriptorLayout();
 		CreateDescriptorSets();
 		CreateDepthImage();
 		CreateMultisamplingImage();
-		m_pipeline = std::make_unique<Pipeline>(m_logicalDevice);
-		m_pipeline->CreateRenderPass(m_format, GetDepthFormat(m_physicalDevice, vk::ImageTiling::eOptimal), m_msaaSampleCount);
-		m_pipeline->CreateGraphicPipelines(m_descriptorSetLayout, m_msaaSampleCount, {
-			m_vertexShader->GetShaderStageInfo(),
-			m_fragmentShader->GetShaderStageInfo()
-			});
-		m_pipeline->CreateGraphicPipelines(m_descriptorSetLayout, m_msaaSampleCount, {
-			m_vertexShaderMesh->GetShaderStageInfo(),
-			m_fragmentShader->GetShaderStageInfo()
-			}, nullptr, ShaderType::BasicShaderForMesh);
+		m_renderTargets->Build();
+		if (m_hizPyramid)
+			m_hizPyramid->SetDepthSource(m_renderTargets->Get(m_depthTarget).GetImageView());
+		m_pipeline = std::make_unique<Pipeline>(m_logicalDevice, m_settings.BackgroundPipelineCompilation);
+		m_pipeline->SetTextureSetLayout(m_textureTable->GetSetLayout());
+		m_pipeline->CreateRenderPass(m_format, GetDepthFormat(m_physicalDevice, vk::ImageTiling::eOptimal), m_msaaSampleCount, m_useOcclusionCulling);
+
+		m_pipelineCache = std::make_unique<PipelineCache>(m_logicalDevice, m_physicalDeviceProperties, m_settings.PipelineCachePath);
+		const auto& pipeline_cache = m_pipelineCache->GetCache();
+		auto pipeline_start = std::chrono::high_resolution_clock::now();
+		// The basic shader types are permutations of the same two shaders, told apart by their default features.
+		const auto basic_shader_stage_infos = GetShaderStageInfos(ShaderType::BasicShader);
+		m_pipeline->CreateGraphicPipelines(m_descriptorSetLayout, m_msaaSampleCount, basic_shader_stage_infos, pipeline_cache);
+		m_pipeline->CreateGraphicPipelines(m_descriptorSetLayout, m_msaaSampleCount, basic_shader_stage_infos, pipeline_cache, ShaderType::BasicShaderForMesh, false, ToFeatureBit(ShaderFeature::MeshTransform));
+		m_pipeline->CreateGraphicPipelines(m_descriptorSetLayout, m_msaaSampleCount, basic_shader_stage_infos, pipeline_cache, ShaderType::Instanced, m_settings.DepthPrePass, ToFeatureBit(ShaderFeature::Instanced));
+		if (m_settings.DepthPrePass)
+			m_pipeline->CreateDepthPrePassPipeline(m_descriptorSetLayout, m_msaaSampleCount, GetShaderStageInfos(ShaderType::DepthPrePass), pipeline_cache);
+		if (m_useGpuCulling)
+			m_pipeline->CreateComputePipeline(m_cullSetLayout, m_cullShader->GetShaderStageInfo(), static_cast<uint32_t>(sizeof(CullPushConstant)), pipeline_cache);
+		if (m_useOcclusionCulling)
+			m_pipeline->CreateComputePipeline(m_hizPyramid->GetSetLayout(), m_hizShader->GetShaderStageInfo(), static_cast<uint32_t>(sizeof(HiZPushConstant)), pipeline_cache, ShaderType::HiZBuild);
+
+		auto pipeline_time = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - pipeline_start).count();
+		std::cout << "Pipelines: " << pipeline_time << " ms (" << (m_pipelineCache->IsWarm() ? "warm" : "cold") << " cache)\n";
+		if (!m_settings.PipelineKeysPath.empty())
+			m_pipeline->Prewarm(m_settings.PipelineKeysPath);
 		CreateFramebuffers();
 		CreateCommandBuffers();
 		CreateSynchronizationObjects();
@@ -436,25 +1345,38 @@ void GLVK::VK::GraphicsEngine::Dispose()
 {
     m_logicalDevice.waitIdle();
     m_logicalDevice.freeCommandBuffers(m_commandPool, m_commandBuffers);
+	if (m_pipeline && !m_settings.PipelineKeysPath.empty())
+		m_pipeline->SaveUsedKeys(m_settings.PipelineKeysPath);
 	m_pipeline.reset();
+
+	// Saved on the way out so the next launch creates its pipelines from the cache instead of compiling them.
+	if (m_pipelineCache) m_pipelineCache->Save();
+	m_pipelineCache.reset();
 	
-	m_dynamicMeshUniformBuffer.reset();
-	m_dynamicModelUniformBuffer.reset();
-	m_mvpBuffer.reset();
-	m_directionalLightBuffer.reset();
+	for (auto& frame : m_frames)
+	{
+		if (frame.IndirectCommandBuffer)
+			m_logicalDevice.freeCommandBuffers(m_commandPool, frame.IndirectCommandBuffer);
+		if (frame.ResumeCommandBuffer)
+			m_logicalDevice.freeCommandBuffers(m_commandPool, frame.ResumeCommandBuffer);
+		m_logicalDevice.destroyFence(frame.Fence);
+		m_logicalDevice.destroySemaphore(frame.ImageAcquiredSemaphore);
+		m_logicalDevice.destroySemaphore(frame.RenderCompletedSemaphore);
+	}
+	for (size_t i = 0; i < m_frames.size(); ++i)
+		ReleaseRetiredSwapchains(i);
+	m_frames.clear();
+	m_visibilityBuffer.reset();
+	m_hizPyramid.reset();
+	m_modelUniforms.reset();
+	m_meshUniforms.reset();
 
 	for (auto i = 0; i < m_images.size(); ++i)
 	{
-	    m_logicalDevice.destroyFence(m_fences[i]);
-	    m_logicalDevice.destroySemaphore(m_imageAcquiredSemaphores[i]);
-	    m_logicalDevice.destroySemaphore(m_renderCompletedSemaphores[i]);
 	    m_logicalDevice.destroyFramebuffer(m_framebuffers[i]);
-		//m_mvpBuffers[i].reset();
-		//m_directionalLightBuffers[i].reset();
 	}
 
-	m_msaaImage.reset();
-	m_depthImage.reset();
+	m_renderTargets->Clear();
 	m_logicalDevice.destroyDescriptorPool(m_descriptorPool);
 
 	for (auto& image : m_images)
@@ -538,7 +1460,8 @@ void GLVK::VK::GraphicsEngine::CreateLogicalDevice()
 	auto queue_create_infos = std::vector<vk::DeviceQueueCreateInfo>();
 	auto unique_indices = std::unordered_set<uint32_t>{
 		m_queueIndices.GraphicsQueue.value(),
-		m_queueIndices.PresentQueue.value()
+		m_queueIndices.PresentQueue.value(),
+		m_queueIndices.TransferQueue.value()
 	};
 	auto priority = 1.0f;
 	for (const auto& index : unique_indices)
@@ -557,15 +1480,54 @@ void GLVK::VK::GraphicsEngine::CreateLogicalDevice()
 
 	auto indexing_features = vk::PhysicalDeviceDescriptorIndexingFeatures();
 	indexing_features.descriptorBindingPartiallyBound = VK_TRUE;
+	indexing_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
 	indexing_features.runtimeDescriptorArray = VK_TRUE;
 
+	// Instanced batches start at their own firstInstance, which indirect draws can only express with drawIndirectFirstInstance.
+	m_useIndirectDraws = m_settings.IndirectDraws && m_physicalDeviceFeatures.drawIndirectFirstInstance;
+	m_hasMultiDrawIndirect = m_useIndirectDraws && m_physicalDeviceFeatures.multiDrawIndirect;
+	features.drawIndirectFirstInstance = m_useIndirectDraws;
+	features.multiDrawIndirect = m_hasMultiDrawIndirect;
+
+	// The culling pass runs on the graphics queue right before the render pass that consumes its output.
+	auto queue_families = m_physicalDevice.getQueueFamilyProperties();
+	auto has_compute = static_cast<bool>(queue_families[m_queueIndices.GraphicsQueue.value()].queueFlags & vk::QueueFlagBits::eCompute);
+	m_useGpuCulling = m_settings.GpuCulling && m_useIndirectDraws && has_compute;
+	m_useCpuCulling = m_settings.CpuCulling && !m_useGpuCulling;
+
+	// The pyramid is reduced from the multisampled depth attachment, so that has to be sampleable in a compute shader.
+	auto depth_features = m_physicalDevice.getFormatProperties(GetDepthFormat(m_physicalDevice, vk::ImageTiling::eOptimal)).optimalTilingFeatures;
+	m_useOcclusionCulling = m_settings.OcclusionCulling && m_useGpuCulling && m_msaaSampleCount != vk::SampleCountFlagBits::e1 &&
+		static_cast<bool>(depth_features & vk::FormatFeatureFlagBits::eSampledImage);
+
+	// drawIndexedIndirectCount is core in Vulkan 1.2, where its feature bit sits next to the descriptor indexing ones;
+	// the two feature structs must not be chained together, so the 1.2 struct replaces the indexing one when it is used.
+	auto vulkan12_features = vk::PhysicalDeviceVulkan12Features();
+	vulkan12_features.descriptorBindingPartiallyBound = VK_TRUE;
+	vulkan12_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	vulkan12_features.runtimeDescriptorArray = VK_TRUE;
+	if (m_hasMultiDrawIndirect && m_physicalDeviceProperties.apiVersion >= VK_API_VERSION_1_2)
+	{
+		auto supported = m_physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+		m_hasDrawIndirectCount = supported.get<vk::PhysicalDeviceVulkan12Features>().drawIndirectCount;
+		vulkan12_features.drawIndirectCount = m_hasDrawIndirectCount;
+	}
+
+	// VK_EXT_memory_budget is optional; without it the memory budget falls back to the allocator's own accounting.
+	auto device_extensions = m_enabledExtensions;
+	auto available_extensions = m_physicalDevice.enumerateDeviceExtensionProperties();
+	m_hasMemoryBudget = std::any_of(available_extensions.cbegin(), available_extensions.cend(), [](const vk::ExtensionProperties& property) {
+		return std::string_view(property.extensionName.data()) == VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+		});
+	if (m_hasMemoryBudget) device_extensions.emplace_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
 	auto info = vk::DeviceCreateInfo();
-	info.enabledExtensionCount = static_cast<uint32_t>(m_enabledExtensions.size());
+	info.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
 	info.pEnabledFeatures = &features;
-	info.ppEnabledExtensionNames = m_enabledExtensions.data();
+	info.ppEnabledExtensionNames = device_extensions.data();
 	info.pQueueCreateInfos = queue_create_infos.data();
 	info.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size());
-	info.pNext = &indexing_features;
+	info.pNext = m_hasDrawIndirectCount ? static_cast<void*>(&vulkan12_features) : static_cast<void*>(&indexing_features);
 
 	if (m_debug)
 	{
@@ -574,8 +1536,9 @@ void GLVK::VK::GraphicsEngine::CreateLogicalDevice()
 	}
 
 	m_logicalDevice = m_physicalDevice.createDevice(info);
-	m_graphicsQueue = m_logicalDevice.getQueue(0, m_queueIndices.GraphicsQueue.value());
-	m_presentQueue = m_logicalDevice.getQueue(0, m_queueIndices.PresentQueue.value());
+	m_graphicsQueue = m_logicalDevice.getQueue(m_queueIndices.GraphicsQueue.value(), 0);
+	m_presentQueue = m_logicalDevice.getQueue(m_queueIndices.PresentQueue.value(), 0);
+	m_transferQueue = m_logicalDevice.getQueue(m_queueIndices.TransferQueue.value(), 0);
 }
 
 void GLVK::VK::GraphicsEngine::CreateSwapchain()
@@ -593,7 +1556,8 @@ void GLVK::VK::GraphicsEngine::CreateSwapchain()
 	}
 
 	auto info = vk::SwapchainCreateInfoKHR();
-	info.oldSwapchain = nullptr;
+	// Passing the swapchain being replaced lets the presentation engine hand its resources over; it is retired separately.
+	info.oldSwapchain = m_swapchain;
 	info.clipped = VK_FALSE;
 	info.compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque;
 	info.imageArrayLayers = 1;
@@ -635,11 +1599,200 @@ void GLVK::VK::GraphicsEngine::CreateSwapchain()
 	}
 }
 
+void GLVK::VK::GraphicsEngine::RecreateSwapchain()
+{
+	auto* window = reinterpret_cast<GLFWwindow*>(m_handle);
+	glfwGetFramebufferSize(window, &m_width, &m_height);
+	m_swapchainDetails = GetSwapchainDetails(m_physicalDevice, m_surface);
+	auto extent = GetExtent(m_swapchainDetails.SurfaceCapabilities, window);
+
+	// A minimised window has nothing to present to; frames are skipped until it has an area again.
+	m_isSwapchainStale = true;
+	if (m_width == 0 || m_height == 0 || extent.width == 0 || extent.height == 0) return;
+
+	// Only frames that are still in flight can be using the old swapchain and attachments, so they are retired
+	// behind the frame fences instead of waiting for the device to go idle.
+	auto& retired = m_retiredSwapchains.emplace_back();
+	retired.Swapchain = m_swapchain;
+	retired.Framebuffers = std::exchange(m_framebuffers, {});
+	retired.Images = std::exchange(m_images, {});
+	retired.RenderTargets = std::exchange(m_renderTargets, std::make_unique<RenderTargetPool>(m_logicalDevice, *m_allocator));
+	retired.Pyramid = std::move(m_hizPyramid);
+	retired.PendingFrames.assign(m_frames.size(), true);
+
+	// The render pass only depends on the formats, so it and every pipeline built against it survive.
+	m_extent = extent;
+	CreateSwapchain();
+	CreateDepthImage();
+	CreateMultisamplingImage();
+	m_renderTargets->Build();
+	if (m_useOcclusionCulling)
+	{
+		m_hizPyramid = std::make_unique<HiZPyramid>(m_logicalDevice, *m_allocator, m_extent);
+		m_hizPyramid->SetDepthSource(m_renderTargets->Get(m_depthTarget).GetImageView());
+	}
+	CreateFramebuffers();
+	m_mvp.Projection = glm::perspective(glm::radians(45.0f), static_cast<float>(m_width) / static_cast<float>(m_height), 0.1f, 100.0f);
+
+	// Replayed command buffers have the old viewport and scissor baked in, and the culling sets still sample the old pyramid.
+	for (auto& frame : m_frames)
+	{
+		frame.IsIndirectRecorded = false;
+		frame.RecordedBatchCount = 0;
+		frame.RecordedState = 0;
+		frame.IsCullSetStale = m_useOcclusionCulling;
+	}
+	m_isSwapchainStale = false;
+}
+
+void GLVK::VK::GraphicsEngine::ReleaseRetiredSwapchains(size_t frameIndex)
+{
+	// Called right after the slot's fence wait, so its last submission is done with everything retired before it.
+	for (auto& retired : m_retiredSwapchains)
+		retired.PendingFrames[frameIndex] = false;
+
+	auto is_released = [](const RetiredSwapchain& retired) {
+		return std::none_of(retired.PendingFrames.cbegin(), retired.PendingFrames.cend(), [](bool isPending) { return isPending; });
+	};
+
+	for (auto& retired : m_retiredSwapchains)
+	{
+		if (!is_released(retired)) continue;
+
+		for (auto& framebuffer : retired.Framebuffers)
+			m_logicalDevice.destroyFramebuffer(framebuffer);
+		m_logicalDevice.destroySwapchainKHR(retired.Swapchain);
+	}
+	std::erase_if(m_retiredSwapchains, is_released);
+}
+
+void GLVK::VK::GraphicsEngine::CreateTextureTable()
+{
+	auto properties = m_physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDescriptorIndexingProperties>();
+	const auto& limits = properties.get<vk::PhysicalDeviceDescriptorIndexingProperties>();
+
+	// Instanced draws carry their texture as the sort key's material, which reserves zero for untextured draws.
+	auto capacity = std::min({ m_settings.TextureTableCapacity, SortKey::MATERIAL_LIMIT - 1,
+		limits.maxDescriptorSetUpdateAfterBindSampledImages, limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		limits.maxDescriptorSetUpdateAfterBindSamplers, limits.maxPerStageDescriptorUpdateAfterBindSamplers });
+	m_textureTable = std::make_unique<TextureTable>(m_logicalDevice, std::max(capacity, 1u), std::max<uint32_t>(m_settings.FramesInFlight, 1));
+}
+
 void GLVK::VK::GraphicsEngine::LoadShader()
 {
-	m_vertexShader = std::make_unique<Shader>(vk::ShaderStageFlagBits::eVertex, "GLVK/VK/Shaders/vert.spv", m_logicalDevice);
-	m_vertexShaderMesh = std::make_unique<Shader>(vk::ShaderStageFlagBits::eVertex, "GLVK/VK/Shaders/basicShader_mesh.spv", m_logicalDevice);
-	m_fragmentShader = std::make_unique<Shader>(vk::ShaderStageFlagBits::eFragment, "GLVK/VK/Shaders/frag.spv", m_logicalDevice);
+	if (m_settings.RuntimeShaderCompilation)
+	{
+		if (ShaderCompiler::IsSupported())
+			m_shaderCompiler = std::make_unique<ShaderCompiler>(m_settings.ShaderCachePath);
+		else
+			std::cerr << "Shaders: built without shaderc, loading precompiled SPIR-V\n";
+	}
+
+	auto add_source = [this](std::string_view sourcePath, std::string_view spirvName, vk::ShaderStageFlagBits stage, std::unique_ptr<Shader>* target, std::vector<ShaderType> dependents) -> ShaderSource& {
+		auto& source = m_shaderSources.emplace_back();
+		source.SourcePath = sourcePath;
+		source.SpirvPath = std::string(SHADER_BINARY_DIR) + "/" + std::string(spirvName);
+		source.Stage = stage;
+		source.Target = target;
+		source.Dependents = std::move(dependents);
+		return source;
+	};
+
+	m_shaderSources.clear();
+	add_source("GLVK/VK/Shaders/basicShader.vert", "vert.spv", vk::ShaderStageFlagBits::eVertex, &m_vertexShader, { ShaderType::BasicShader, ShaderType::BasicShaderForMesh, ShaderType::Instanced });
+	add_source("GLVK/VK/Shaders/basicShader.frag", "frag.spv", vk::ShaderStageFlagBits::eFragment, &m_fragmentShader, { ShaderType::BasicShader, ShaderType::BasicShaderForMesh, ShaderType::Instanced });
+	if (m_useGpuCulling)
+	{
+		auto& source = add_source("GLVK/VK/Shaders/frustumCull.comp", m_useOcclusionCulling ? "occlusion_cull.spv" : "frustum_cull.spv", vk::ShaderStageFlagBits::eCompute, &m_cullShader, { ShaderType::FrustumCull });
+		if (m_useOcclusionCulling) source.Defines.emplace_back("OCCLUSION");
+	}
+	if (m_useOcclusionCulling)
+		add_source("GLVK/VK/Shaders/hizBuild.comp", "hiz_build.spv", vk::ShaderStageFlagBits::eCompute, &m_hizShader, { ShaderType::HiZBuild });
+	if (m_settings.DepthPrePass)
+		add_source("GLVK/VK/Shaders/depthPrePass.vert", "depth_prepass.spv", vk::ShaderStageFlagBits::eVertex, &m_depthPrePassShader, { ShaderType::DepthPrePass });
+
+	for (const auto& source : m_shaderSources)
+	{
+		if (m_shaderCompiler && m_settings.ShaderHotReload)
+			m_shaderCompiler->Watch(source.SourcePath);
+		*source.Target = CreateShader(source);
+	}
+}
+
+std::unique_ptr<GLVK::VK::Shader> GLVK::VK::GraphicsEngine::CreateShader(const ShaderSource& source) const
+{
+	if (!m_shaderCompiler)
+	{
+		// A prebuilt module older than its source most likely misses an edit. Checkouts do not keep timestamps, so this only warns.
+		auto source_error = std::error_code();
+		auto spirv_error = std::error_code();
+		auto source_time = std::filesystem::last_write_time(source.SourcePath, source_error);
+		auto spirv_time = std::filesystem::last_write_time(source.SpirvPath, spirv_error);
+		if (!source_error && !spirv_error && spirv_time < source_time)
+			std::cerr << "Shaders: " << source.SpirvPath << " is older than " << source.SourcePath << ", run compile_shader.py to rebuild it\n";
+		return std::make_unique<Shader>(source.Stage, source.SpirvPath, m_logicalDevice);
+	}
+	return std::make_unique<Shader>(source.Stage, m_shaderCompiler->Compile(source.SourcePath, source.Stage, source.Defines), m_logicalDevice);
+}
+
+std::vector<vk::PipelineShaderStageCreateInfo> GLVK::VK::GraphicsEngine::GetShaderStageInfos(const ShaderType& shaderType) const
+{
+	switch (shaderType)
+	{
+	case ShaderType::FrustumCull:
+		return { m_cullShader->GetShaderStageInfo() };
+	case ShaderType::HiZBuild:
+		return { m_hizShader->GetShaderStageInfo() };
+	case ShaderType::DepthPrePass:
+		return { m_depthPrePassShader->GetShaderStageInfo() };
+	default:
+		return { m_vertexShader->GetShaderStageInfo(), m_fragmentShader->GetShaderStageInfo() };
+	}
+}
+
+void GLVK::VK::GraphicsEngine::ReloadChangedShaders()
+{
+	auto changed = m_shaderCompiler->PollChanges();
+	if (changed.empty()) return;
+
+	// The pipelines built from the old shaders are destroyed below, and the GPU may still be drawing with them.
+	// The old modules are kept until then, since background compiles of those pipelines may still read them.
+	m_logicalDevice.waitIdle();
+	auto retired_shaders = std::vector<std::unique_ptr<Shader>>();
+	auto stale_types = std::vector<ShaderType>();
+	for (const auto& source : m_shaderSources)
+	{
+		if (std::find(changed.cbegin(), changed.cend(), source.SourcePath) == changed.cend()) continue;
+
+		try
+		{
+			auto shader = CreateShader(source);
+			retired_shaders.emplace_back(std::move(*source.Target));
+			*source.Target = std::move(shader);
+		}
+		catch (const std::exception& ex)
+		{
+			// A mistake while editing should not take the engine down; the old shader stays until the source compiles again.
+			std::cerr << ex.what() << '\n';
+			continue;
+		}
+
+		std::cout << "Shader: reloaded " << source.SourcePath << '\n';
+		for (auto shader_type : source.Dependents)
+		{
+			if (std::find(stale_types.cbegin(), stale_types.cend(), shader_type) == stale_types.cend())
+				stale_types.emplace_back(shader_type);
+		}
+	}
+
+	const auto& pipeline_cache = m_pipelineCache->GetCache();
+	for (auto shader_type : stale_types)
+	{
+		if (shader_type == ShaderType::FrustumCull || shader_type == ShaderType::HiZBuild)
+			m_pipeline->ReloadComputePipeline(shader_type, GetShaderStageInfos(shader_type).front(), pipeline_cache);
+		else
+			m_pipeline->ReloadGraphicPipelines(shader_type, GetShaderStageInfos(shader_type));
+	}
 }
 
 void GLVK::VK::GraphicsEngine::CreateDescriptorLayout()
@@ -669,194 +1822,177 @@ void GLVK::VK::GraphicsEngine::CreateDescriptorLayout()
 	bindings[3].pImmutableSamplers = nullptr;
 	bindings[3].stageFlags = vk::ShaderStageFlagBits::eVertex;
 
-	/*bindings[2].binding = 3;
-	bindings[2].descriptorCount = static_cast<uint32_t>(m_textures.size());
-	bindings[2].descriptorType = vk::DescriptorType::eCombinedImageSampler;
-	bindings[2].pImmutableSamplers = nullptr;
-	bindings[2].stageFlags = vk::ShaderStageFlagBits::eFragment;*/
+	bindings[4].binding = 4;
+	bindings[4].descriptorCount = 1;
+	bindings[4].descriptorType = vk::DescriptorType::eStorageBuffer;
+	bindings[4].pImmutableSamplers = nullptr;
+	bindings[4].stageFlags = vk::ShaderStageFlagBits::eVertex;
 
 	auto info = vk::DescriptorSetLayoutCreateInfo();
 	info.bindingCount = static_cast<uint32_t>(_countof(bindings));
 	info.pBindings = bindings;
 	m_descriptorSetLayout = m_logicalDevice.createDescriptorSetLayout(info);
+
+	if (!m_useGpuCulling) return;
+
+	// Culling input, visible instances and indirect commands, all storage buffers of the compute stage.
+	// Occlusion culling adds the depth pyramid, the per-instance visibility flags and the OcclusionData uniform.
+	auto cull_bindings = std::vector<vk::DescriptorSetLayoutBinding>(m_useOcclusionCulling ? 6 : 3);
+	for (uint32_t i = 0; i < cull_bindings.size(); ++i)
+	{
+		cull_bindings[i].binding = i;
+		cull_bindings[i].descriptorCount = 1;
+		cull_bindings[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+		cull_bindings[i].pImmutableSamplers = nullptr;
+		cull_bindings[i].stageFlags = vk::ShaderStageFlagBits::eCompute;
+	}
+
+	if (m_useOcclusionCulling)
+	{
+		cull_bindings[3].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+		cull_bindings[5].descriptorType = vk::DescriptorType::eUniformBuffer;
+	}
+
+	auto cull_info = vk::DescriptorSetLayoutCreateInfo();
+	cull_info.bindingCount = static_cast<uint32_t>(cull_bindings.size());
+	cull_info.pBindings = cull_bindings.data();
+	m_cullSetLayout = m_logicalDevice.createDescriptorSetLayout(cull_info);
 }
 
 void GLVK::VK::GraphicsEngine::CreateDescriptorSets()
 {
-	vk::DescriptorPoolSize pool_sizes[DESCRIPTOR_TYPE_COUNT] = {};
-	pool_sizes[0].descriptorCount = 1;
+	auto frame_count = static_cast<uint32_t>(m_frames.size());
+	// The last entry is only used by the depth pyramid binding of the occlusion culling sets.
+	vk::DescriptorPoolSize pool_sizes[DESCRIPTOR_TYPE_COUNT + 1] = {};
+	pool_sizes[0].descriptorCount = m_useOcclusionCulling ? frame_count * 2 : frame_count;
 	pool_sizes[0].type = vk::DescriptorType::eUniformBuffer;
-	pool_sizes[1].descriptorCount = 1;
-	pool_sizes[1].type = vk::DescriptorType::eUniformBuffer;;
-	pool_sizes[2].descriptorCount = 1;
+	pool_sizes[1].descriptorCount = frame_count;
+	pool_sizes[1].type = vk::DescriptorType::eUniformBuffer;
+	pool_sizes[2].descriptorCount = frame_count;
 	pool_sizes[2].type = vk::DescriptorType::eUniformBufferDynamic;
-	pool_sizes[3].descriptorCount = 1;
+	pool_sizes[3].descriptorCount = frame_count;
 	pool_sizes[3].type = vk::DescriptorType::eUniformBufferDynamic;
-	/*pool_sizes[2].descriptorCount = m_textures.empty() ? 1 : static_cast<uint32_t>(m_textures.size());
-	pool_sizes[2].type = vk::DescriptorType::eCombinedImageSampler;*/
+	pool_sizes[4].descriptorCount = m_useOcclusionCulling ? frame_count * 5 : m_useGpuCulling ? frame_count * 4 : frame_count;
+	pool_sizes[4].type = vk::DescriptorType::eStorageBuffer;
+	pool_sizes[5].descriptorCount = frame_count;
+	pool_sizes[5].type = vk::DescriptorType::eCombinedImageSampler;
 
-	assert(!m_images.empty());
+	assert(!m_frames.empty());
 	auto pool_info = vk::DescriptorPoolCreateInfo();
-	pool_info.maxSets = static_cast<uint32_t>(m_images.size());
-	pool_info.poolSizeCount = _countof(pool_sizes);
+	pool_info.maxSets = m_useGpuCulling ? frame_count * 2 : frame_count;
+	pool_info.poolSizeCount = m_useOcclusionCulling ? _countof(pool_sizes) : DESCRIPTOR_TYPE_COUNT;
 	pool_info.pPoolSizes = pool_sizes;
 	m_descriptorPool = m_logicalDevice.createDescriptorPool(pool_info);
 
-	auto set_layouts = std::vector<vk::DescriptorSetLayout>(m_images.size(), m_descriptorSetLayout);
+	auto set_layouts = std::vector<vk::DescriptorSetLayout>(m_frames.size(), m_descriptorSetLayout);
 	auto allocate_info = vk::DescriptorSetAllocateInfo();
 	allocate_info.descriptorPool = m_descriptorPool;
-	allocate_info.descriptorSetCount = 1;
-	allocate_info.pSetLayouts = &m_descriptorSetLayout;
-	//allocate_info.descriptorSetCount = static_cast<uint32_t>(set_layouts.size());
-	//allocate_info.pSetLayouts = set_layouts.data();
-	m_descriptorSet = m_logicalDevice.allocateDescriptorSets(allocate_info)[0];
-
-	/*auto images_infos = std::vector<vk::DescriptorImageInfo>(m_textures.size());
-	for (auto i = 0; i < m_textures.size(); ++i)
-	{
-		images_infos[i].imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-		images_infos[i].imageView = m_textures[i]->GetImageView();
-		images_infos[i].sampler = m_textures[i]->GetSampler();
-	}*/
-
-	auto mvp_buffer_info = vk::DescriptorBufferInfo();
-	mvp_buffer_info.buffer = m_mvpBuffer->GetBuffer();
-	mvp_buffer_info.offset = 0;
-	mvp_buffer_info.range = sizeof(MVP);
-
-	auto directional_light_buffer_info = vk::DescriptorBufferInfo();
-	directional_light_buffer_info.buffer = m_directionalLightBuffer->GetBuffer();
-	directional_light_buffer_info.offset = 0;
-	directional_light_buffer_info.range = sizeof(DirectionalLight);
-
-	auto dynamic_model_buffer_info = vk::DescriptorBufferInfo();
-	dynamic_model_buffer_info.buffer = m_dynamicModelUniformBuffer->GetBuffer();
-	dynamic_model_buffer_info.offset = 0;
-	dynamic_model_buffer_info.range = VK_WHOLE_SIZE;
-
-	auto dynamic_mesh_buffer_info = vk::DescriptorBufferInfo();
-	dynamic_mesh_buffer_info.buffer = m_dynamicMeshUniformBuffer->GetBuffer();
-	dynamic_mesh_buffer_info.offset = 0;
-	dynamic_mesh_buffer_info.range = VK_WHOLE_SIZE;
-
-	auto write_descriptor_count = DESCRIPTOR_TYPE_COUNT;
-	auto write_descriptors = std::vector<vk::WriteDescriptorSet>(write_descriptor_count);
-	write_descriptors[0].descriptorCount = 1;
-	write_descriptors[0].descriptorType = vk::DescriptorType::eUniformBuffer;
-	write_descriptors[0].dstArrayElement = 0;
-	write_descriptors[0].dstBinding = 0;
-	write_descriptors[0].dstSet = m_descriptorSet;
-	write_descriptors[0].pBufferInfo = &mvp_buffer_info;
-	write_descriptors[0].pImageInfo = nullptr;
-	write_descriptors[0].pTexelBufferView = nullptr;
-
-	write_descriptors[1].descriptorCount = 1;
-	write_descriptors[1].descriptorType = vk::DescriptorType::eUniformBuffer;
-	write_descriptors[1].dstArrayElement = 0;
-	write_descriptors[1].dstBinding = 1;
-	write_descriptors[1].dstSet = m_descriptorSet;
-	write_descriptors[1].pBufferInfo = &directional_light_buffer_info;
-	write_descriptors[1].pImageInfo = nullptr;
-	write_descriptors[1].pTexelBufferView = nullptr;
-
-	write_descriptors[2].descriptorCount = 1;
-	write_descriptors[2].descriptorType = vk::DescriptorType::eUniformBufferDynamic;
-	write_descriptors[2].dstArrayElement = 0;
-	write_descriptors[2].dstBinding = 2;
-	write_descriptors[2].dstSet = m_descriptorSet;
-	write_descriptors[2].pBufferInfo = &dynamic_model_buffer_info;
-	write_descriptors[2].pImageInfo = nullptr;
-	write_descriptors[2].pTexelBufferView = nullptr;
-
-	write_descriptors[3].descriptorCount = 1;
-	write_descriptors[3].descriptorType = vk::DescriptorType::eUniformBufferDynamic;
-	write_descriptors[3].dstArrayElement = 0;
-	write_descriptors[3].dstBinding = 3;
-	write_descriptors[3].dstSet = m_descriptorSet;
-	write_descriptors[3].pBufferInfo = &dynamic_mesh_buffer_info;
-	write_descriptors[3].pImageInfo = nullptr;
-	write_descriptors[3].pTexelBufferView = nullptr;
+	allocate_info.descriptorSetCount = frame_count;
+	allocate_info.pSetLayouts = set_layouts.data();
+	auto descriptor_sets = m_logicalDevice.allocateDescriptorSets(allocate_info);
 
-	m_logicalDevice.updateDescriptorSets(write_descriptors, {});
+	auto cull_sets = std::vector<vk::DescriptorSet>();
+	if (m_useGpuCulling)
+	{
+		auto cull_layouts = std::vector<vk::DescriptorSetLayout>(m_frames.size(), m_cullSetLayout);
+		allocate_info.pSetLayouts = cull_layouts.data();
+		cull_sets = m_logicalDevice.allocateDescriptorSets(allocate_info);
+	}
 
-	//for (auto i = 0; i < m_descriptorSets.size(); ++i)
-	//{
-	//	auto mvp_buffer_info = vk::DescriptorBufferInfo();
-	//	mvp_buffer_info.buffer = m_mvpBuffer->GetBuffer();
-	//	mvp_buffer_info.offset = 0;
-	//	mvp_buffer_info.range = sizeof(MVP);
-	//	
-	//	auto directional_light_buffer_info = vk::DescriptorBufferInfo();
-	//	directional_light_buffer_info.buffer = m_directionalLightBuffer->GetBuffer();
-	//	directional_light_buffer_info.offset = 0;
-	//	directional_light_buffer_info.range = sizeof(DirectionalLight);
-
-	//	/*auto dynamic_buffer_info = vk::DescriptorBufferInfo();
-	//	dynamic_buffer_info.buffer = m_dynamicUniformBuffer->GetBuffer();
-	//	dynamic_buffer_info.offset = 0;
-	//	dynamic_buffer_info.range = VK_WHOLE_SIZE;*/
-
-	//	//auto write_descriptor_count = 2 + (m_textures.empty() ? 0 : 1);
-	//	auto write_descriptor_count = 2;
-	//	auto write_descriptors = std::vector<vk::WriteDescriptorSet>(write_descriptor_count);
-	//	write_descriptors[0].descriptorCount = 1;
-	//	write_descriptors[0].descriptorType = vk::DescriptorType::eUniformBuffer;
-	//	write_descriptors[0].dstArrayElement = 0;
-	//	write_descriptors[0].dstBinding = 0;
-	//	write_descriptors[0].dstSet = m_descriptorSets[i];
-	//	write_descriptors[0].pBufferInfo = &mvp_buffer_info;
-	//	write_descriptors[0].pImageInfo = nullptr;
-	//	write_descriptors[0].pTexelBufferView = nullptr;
-	//	
-	//	write_descriptors[1].descriptorCount = 1;
-	//	write_descriptors[1].descriptorType = vk::DescriptorType::eUniformBuffer;
-	//	write_descriptors[1].dstArrayElement = 0;
-	//	write_descriptors[1].dstBinding = 1;
-	//	write_descriptors[1].dstSet = m_descriptorSets[i];
-	//	write_descriptors[1].pBufferInfo = &directional_light_buffer_info;
-	//	write_descriptors[1].pImageInfo = nullptr;
-	//	write_descriptors[1].pTexelBufferView = nullptr;
-
-	//	/*write_descriptors[2].descriptorCount = 1;
-	//	write_descriptors[2].descriptorType = vk::DescriptorType::eUniformBufferDynamic;
-	//	write_descriptors[2].dstArrayElement = 0;
-	//	write_descriptors[2].dstBinding = 2;
-	//	write_descriptors[2].dstSet = m_descriptorSets[i];
-	//	write_descriptors[2].pBufferInfo = &dynamic_buffer_info;
-	//	write_descriptors[2].pImageInfo = nullptr;
-	//	write_descriptors[2].pTexelBufferView = nullptr;*/
-
-	//	/*if (!m_textures.empty())
-	//	{
-	//		write_descriptors[2].descriptorCount = static_cast<uint32_t>(m_textures.size()) <= 0 ? 1 : static_cast<uint32_t>(m_textures.size());
-	//		write_descriptors[2].descriptorType = vk::DescriptorType::eCombinedImageSampler;
-	//		write_descriptors[2].dstArrayElement = 0;
-	//		write_descriptors[2].dstBinding = 2;
-	//		write_descriptors[2].dstSet = m_descriptorSets[i];
-	//		write_descriptors[2].pBufferInfo = nullptr;
-	//		write_descriptors[2].pImageInfo = images_infos.data();
-	//		write_descriptors[2].pTexelBufferView = nullptr;
-	//	}*/
-
-	//	m_logicalDevice.updateDescriptorSets(write_descriptors, {});
-	//}
+	for (auto i = 0; i < m_frames.size(); ++i)
+	{
+		auto& frame = m_frames[i];
+		frame.DescriptorSet = descriptor_sets[i];
+		if (m_useGpuCulling) frame.CullDescriptorSet = cull_sets[i];
+
+		auto mvp_buffer_info = vk::DescriptorBufferInfo();
+		mvp_buffer_info.buffer = frame.MvpBuffer->GetBuffer();
+		mvp_buffer_info.offset = 0;
+		mvp_buffer_info.range = sizeof(MVP);
+
+		auto directional_light_buffer_info = vk::DescriptorBufferInfo();
+		directional_light_buffer_info.buffer = frame.DirectionalLightBuffer->GetBuffer();
+		directional_light_buffer_info.offset = 0;
+		directional_light_buffer_info.range = sizeof(DirectionalLight);
+
+		auto dynamic_model_buffer_info = vk::DescriptorBufferInfo();
+		dynamic_model_buffer_info.buffer = m_modelUniforms->GetBuffer(i).GetBuffer();
+		dynamic_model_buffer_info.offset = 0;
+		dynamic_model_buffer_info.range = VK_WHOLE_SIZE;
+
+		auto dynamic_mesh_buffer_info = vk::DescriptorBufferInfo();
+		dynamic_mesh_buffer_info.buffer = m_meshUniforms->GetBuffer(i).GetBuffer();
+		dynamic_mesh_buffer_info.offset = 0;
+		dynamic_mesh_buffer_info.range = VK_WHOLE_SIZE;
+
+		// The storage buffers can be replaced when they grow, so they are written by WriteStorageDescriptors().
+		auto write_descriptors = std::vector<vk::WriteDescriptorSet>(DESCRIPTOR_TYPE_COUNT - 1);
+		write_descriptors[0].descriptorCount = 1;
+		write_descriptors[0].descriptorType = vk::DescriptorType::eUniformBuffer;
+		write_descriptors[0].dstArrayElement = 0;
+		write_descriptors[0].dstBinding = 0;
+		write_descriptors[0].dstSet = frame.DescriptorSet;
+		write_descriptors[0].pBufferInfo = &mvp_buffer_info;
+		write_descriptors[0].pImageInfo = nullptr;
+		write_descriptors[0].pTexelBufferView = nullptr;
+
+		write_descriptors[1].descriptorCount = 1;
+		write_descriptors[1].descriptorType = vk::DescriptorType::eUniformBuffer;
+		write_descriptors[1].dstArrayElement = 0;
+		write_descriptors[1].dstBinding = 1;
+		write_descriptors[1].dstSet = frame.DescriptorSet;
+		write_descriptors[1].pBufferInfo = &directional_light_buffer_info;
+		write_descriptors[1].pImageInfo = nullptr;
+		write_descriptors[1].pTexelBufferView = nullptr;
+
+		write_descriptors[2].descriptorCount = 1;
+		write_descriptors[2].descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+		write_descriptors[2].dstArrayElement = 0;
+		write_descriptors[2].dstBinding = 2;
+		write_descriptors[2].dstSet = frame.DescriptorSet;
+		write_descriptors[2].pBufferInfo = &dynamic_model_buffer_info;
+		write_descriptors[2].pImageInfo = nullptr;
+		write_descriptors[2].pTexelBufferView = nullptr;
+
+		write_descriptors[3].descriptorCount = 1;
+		write_descriptors[3].descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+		write_descriptors[3].dstArrayElement = 0;
+		write_descriptors[3].dstBinding = 3;
+		write_descriptors[3].dstSet = frame.DescriptorSet;
+		write_descriptors[3].pBufferInfo = &dynamic_mesh_buffer_info;
+		write_descriptors[3].pImageInfo = nullptr;
+		write_descriptors[3].pTexelBufferView = nullptr;
+
+		m_logicalDevice.updateDescriptorSets(write_descriptors, {});
+		WriteStorageDescriptors(frame);
+	}
 }
 
 void GLVK::VK::GraphicsEngine::CreateDepthImage()
 {
-	auto format = GetDepthFormat(m_physicalDevice, vk::ImageTiling::eOptimal);
-	m_depthImage = std::make_unique<Image>(m_logicalDevice, format, m_msaaSampleCount, m_extent, vk::ImageType::e2D, 1, vk::ImageUsageFlagBits::eDepthStencilAttachment);
-	m_depthImage->AllocateMemory(m_physicalDevice, vk::MemoryPropertyFlagBits::eDeviceLocal);
-	m_depthImage->CreateImageView(format, vk::ImageAspectFlagBits::eDepth, 1, vk::ImageViewType::e2D);
-	m_depthImage->TransitionLayout(vk::ImageLayout::eUndefined, vk::ImageLayout::eDepthAttachmentOptimal, m_commandPool, m_graphicsQueue, vk::ImageAspectFlagBits::eDepth, 1);
+	// Depth is cleared on load and never read after the pass, so it can live in lazily allocated memory.
+	// The render pass starts it from an undefined layout, so no up-front transition is needed.
+	// Occlusion culling reads it between the frame's two render passes, so then it has to be real, sampleable memory.
+	auto desc = RenderTargetDesc();
+	desc.Format = GetDepthFormat(m_physicalDevice, vk::ImageTiling::eOptimal);
+	desc.Extent = m_extent;
+	desc.Samples = m_msaaSampleCount;
+	desc.Usage = m_useOcclusionCulling ? vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled : vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eTransientAttachment;
+	desc.Aspect = vk::ImageAspectFlagBits::eDepth;
+	m_depthTarget = m_renderTargets->Add(desc);
 }
 
 void GLVK::VK::GraphicsEngine::CreateMultisamplingImage()
 {
-	m_msaaImage = std::make_unique<Image>(m_logicalDevice, m_format, m_msaaSampleCount, m_extent, vk::ImageType::e2D, 1, vk::ImageUsageFlagBits::eTransientAttachment | vk::ImageUsageFlagBits::eColorAttachment);
-	m_msaaImage->AllocateMemory(m_physicalDevice, vk::MemoryPropertyFlagBits::eDeviceLocal);
-	m_msaaImage->CreateImageView(m_format, vk::ImageAspectFlagBits::eColor, 1, vk::ImageViewType::e2D);
-	m_msaaImage->TransitionLayout(vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal, m_commandPool, m_graphicsQueue, vk::ImageAspectFlagBits::eColor, 1);
+	// Only the resolved swapchain image is kept, the multisampled color is discarded at the end of the pass.
+	// With occlusion culling it has to survive from the frame's first render pass into the second.
+	auto desc = RenderTargetDesc();
+	desc.Format = m_format;
+	desc.Extent = m_extent;
+	desc.Samples = m_msaaSampleCount;
+	desc.Usage = m_useOcclusionCulling ? vk::ImageUsageFlags(vk::ImageUsageFlagBits::eColorAttachment) : vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransientAttachment;
+	desc.Aspect = vk::ImageAspectFlagBits::eColor;
+	m_msaaTarget = m_renderTargets->Add(desc);
 }
 
 void GLVK::VK::GraphicsEngine::CreateUniformBuffers()
@@ -868,21 +2004,11 @@ void GLVK::VK::GraphicsEngine::CreateUniformBuffers()
 	m_mvp.View = glm::lookAt(glm::vec3(0.0f, 0.0f, -10.0f), glm::vec3(0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
 	m_mvp.Projection = glm::perspective(glm::radians(45.0f), static_cast<float>(m_width) / static_cast<float>(m_height), 0.1f, 100.0f);
 
-	m_mvpBuffer = std::make_unique<Buffer>(m_logicalDevice, vk::BufferUsageFlagBits::eUniformBuffer, mvp_size);
-	auto mvp_memory = m_mvpBuffer->AllocateMemory(m_physicalDevice, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
-	auto mapped = m_mvpBuffer->Map(mvp_size);
-	memcpy(mapped, &m_mvp, mvp_size);
-	
 	m_directionalLight.AmbientIntensity = 0.1f;
 	m_directionalLight.SpecularIntensity = 0.5f;
 	m_directionalLight.Diffuse = glm::vec4(1.0f);
 	m_directionalLight.LightDirection = glm::vec3(0.0f, -5.0f, 0.0f);
 
-	m_directionalLightBuffer = std::make_unique<Buffer>(m_logicalDevice, vk::BufferUsageFlagBits::eUniformBuffer, directional_light_size);
-	auto directional_light_memory = m_directionalLightBuffer->AllocateMemory(m_physicalDevice, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
-	mapped = m_directionalLightBuffer->Map(directional_light_size);
-	memcpy(mapped, &m_directionalLight, directional_light_size);
-
 	m_pushConstant.ObjectColor = glm::vec4(0.0f, 1.0f, 1.0f, 1.0f);
 
 	m_dynamicBufferObject.DynamicAlignment = sizeof(glm::mat4);
@@ -892,38 +2018,65 @@ void GLVK::VK::GraphicsEngine::CreateUniformBuffers()
 		m_dynamicBufferObject.DynamicAlignment = (m_dynamicBufferObject.DynamicAlignment + m_dynamicBufferObject.MinAlignment - 1) & ~(m_dynamicBufferObject.MinAlignment - 1);
 	}
 
-	auto dbo_size = m_dynamicBufferObject.DynamicAlignment * m_dynamicBufferObject.Models.Models.size();
-	m_dynamicBufferObject.Models.Buffer = reinterpret_cast<glm::mat4*>(AllocateAlignedMemory(dbo_size, m_dynamicBufferObject.DynamicAlignment));
-	assert(m_dynamicBufferObject.Models.Buffer);
-	m_dynamicModelUniformBuffer = std::make_unique<Buffer>(m_logicalDevice, vk::BufferUsageFlagBits::eUniformBuffer, dbo_size);
-	m_dynamicModelUniformBuffer->AllocateMemory(m_physicalDevice, vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostVisible);
-
+	// Slots start out with the initial world matrices so the first frames are correct even for objects that never move.
+	auto frame_count = std::max<size_t>(m_settings.FramesInFlight, 1);
+	auto atom_size = m_physicalDeviceProperties.limits.nonCoherentAtomSize;
+	m_modelUniforms = std::make_unique<DynamicUniformBuffer>(m_logicalDevice, *m_allocator, m_dynamicBufferObject.Models.Models.size(), m_dynamicBufferObject.DynamicAlignment, frame_count, atom_size);
 	for (auto i = 0; i < m_dynamicBufferObject.Models.Models.size(); ++i)
-	{
-		auto ptr = reinterpret_cast<glm::mat4*>(reinterpret_cast<uint64_t>(m_dynamicBufferObject.Models.Buffer) + (m_dynamicBufferObject.DynamicAlignment * i));
+		m_modelUniforms->Write(i, &m_dynamicBufferObject.Models.Models[m_dynamicBufferObject.Models.ModelIndices[i]], sizeof(glm::mat4));
+	m_modelUniforms->Flush();
 
-		*ptr = m_dynamicBufferObject.Models.Models[m_dynamicBufferObject.Models.ModelIndices[i]];
-	}
+	m_meshUniforms = std::make_unique<DynamicUniformBuffer>(m_logicalDevice, *m_allocator, m_dynamicBufferObject.Meshes.Models.size(), m_dynamicBufferObject.DynamicAlignment, frame_count, atom_size);
+	for (auto i = 0; i < m_dynamicBufferObject.Meshes.Models.size(); ++i)
+		m_meshUniforms->Write(i, &m_dynamicBufferObject.Meshes.Models[m_dynamicBufferObject.Meshes.ModelIndices[i]], sizeof(glm::mat4));
+	m_meshUniforms->Flush();
 
-	mapped = m_dynamicModelUniformBuffer->Map(VK_WHOLE_SIZE);
-	memcpy(mapped, m_dynamicBufferObject.Models.Buffer, m_dynamicModelUniformBuffer->GetBufferSize());
+	// Every frame in flight gets its own copy, so the CPU can write the next frame while the GPU still reads the previous ones.
+	m_frames.resize(frame_count);
+	for (auto& frame : m_frames)
+	{
+		frame.MvpBuffer = std::make_unique<Buffer>(m_logicalDevice, vk::BufferUsageFlagBits::eUniformBuffer, mvp_size);
+		frame.MvpBuffer->AllocateMemory(*m_allocator, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, AllocationPool::FreeList, MemoryCategory::Uniforms);
+		auto mapped = frame.MvpBuffer->Map(mvp_size);
+		memcpy(mapped, &m_mvp, mvp_size);
 
-	
-	dbo_size = m_dynamicBufferObject.DynamicAlignment * m_dynamicBufferObject.Meshes.Models.size();
-	m_dynamicBufferObject.Meshes.Buffer = reinterpret_cast<glm::mat4*>(AllocateAlignedMemory(dbo_size, m_dynamicBufferObject.DynamicAlignment));
-	assert(m_dynamicBufferObject.Meshes.Buffer);
-	m_dynamicMeshUniformBuffer = std::make_unique<Buffer>(m_logicalDevice, vk::BufferUsageFlagBits::eUniformBuffer, dbo_size);
-	m_dynamicMeshUniformBuffer->AllocateMemory(m_physicalDevice, vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostVisible);
+		frame.DirectionalLightBuffer = std::make_unique<Buffer>(m_logicalDevice, vk::BufferUsageFlagBits::eUniformBuffer, directional_light_size);
+		frame.DirectionalLightBuffer->AllocateMemory(*m_allocator, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, AllocationPool::FreeList, MemoryCategory::Uniforms);
+		mapped = frame.DirectionalLightBuffer->Map(directional_light_size);
+		memcpy(mapped, &m_directionalLight, directional_light_size);
 
-	for (auto i = 0; i < m_dynamicBufferObject.Meshes.Models.size(); ++i)
-	{
-		auto ptr = reinterpret_cast<glm::mat4*>(reinterpret_cast<uint64_t>(m_dynamicBufferObject.Meshes.Buffer) + (m_dynamicBufferObject.DynamicAlignment * i));
+		CreateInstanceBuffer(frame, std::max<size_t>(m_settings.InstanceCapacity, 1));
+		if (m_useIndirectDraws)
+			frame.DrawCommands = std::make_unique<IndirectDrawBuffer>(m_logicalDevice, *m_allocator, m_settings.IndirectDrawCapacity);
 
-		*ptr = m_dynamicBufferObject.Meshes.Models[m_dynamicBufferObject.Meshes.ModelIndices[i]];
+		if (m_useOcclusionCulling)
+		{
+			frame.OcclusionBuffer = std::make_unique<Buffer>(m_logicalDevice, vk::BufferUsageFlagBits::eUniformBuffer, sizeof(OcclusionData));
+			frame.OcclusionBuffer->AllocateMemory(*m_allocator, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, AllocationPool::FreeList, MemoryCategory::Uniforms);
+			frame.Occlusion = reinterpret_cast<OcclusionData*>(frame.OcclusionBuffer->Map(sizeof(OcclusionData)));
+		}
 	}
 
-	mapped = m_dynamicMeshUniformBuffer->Map(VK_WHOLE_SIZE);
-	memcpy(mapped, m_dynamicBufferObject.Meshes.Buffer, m_dynamicMeshUniformBuffer->GetBufferSize());
+	if (m_useOcclusionCulling)
+		CreateVisibilityBuffer(std::max<size_t>(m_settings.InstanceCapacity, 1));
+}
+
+void GLVK::VK::GraphicsEngine::CreateInstanceBuffer(FrameResources& frame, size_t capacity)
+{
+	// Rewritten every frame from the draw list, so it stays mapped and coherent instead of going through the staging ring.
+	// Occlusion culling packs each phase's instances into its own half.
+	auto size = static_cast<vk::DeviceSize>(sizeof(InstanceData) * capacity * (m_useOcclusionCulling ? 2 : 1));
+	frame.InstanceBuffer = std::make_unique<Buffer>(m_logicalDevice, vk::BufferUsageFlagBits::eStorageBuffer, size);
+	frame.InstanceBuffer->AllocateMemory(*m_allocator, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, AllocationPool::FreeList, MemoryCategory::Uniforms);
+	frame.Instances = reinterpret_cast<InstanceData*>(frame.InstanceBuffer->Map(size));
+	frame.InstanceCapacity = capacity;
+
+	if (!m_useGpuCulling) return;
+
+	auto cull_size = static_cast<vk::DeviceSize>(sizeof(CullInstanceData) * capacity);
+	frame.CullInputBuffer = std::make_unique<Buffer>(m_logicalDevice, vk::BufferUsageFlagBits::eStorageBuffer, cull_size);
+	frame.CullInputBuffer->AllocateMemory(*m_allocator, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, AllocationPool::FreeList, MemoryCategory::Uniforms);
+	frame.CullInstances = reinterpret_cast<CullInstanceData*>(frame.CullInputBuffer->Map(cull_size));
 }
 
 GLVK::VK::SwapchainDetails GLVK::VK::GraphicsEngine::GetSwapchainDetails(const vk::PhysicalDevice& device, const vk::SurfaceKHR& surface) {
@@ -935,7 +2088,7 @@ GLVK::VK::SwapchainDetails GLVK::VK::GraphicsEngine::GetSwapchainDetails(const v
 }
 
 vk::Extent2D GLVK::VK::GraphicsEngine::GetExtent(const vk::SurfaceCapabilitiesKHR &capabilities, GLFWwindow* handle) noexcept {
-    if (capabilities.minImageExtent.width != std::numeric_limits<uint32_t>::max())
+    if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max())
     {
         return capabilities.currentExtent;
     }
@@ -1022,8 +2175,8 @@ void GLVK::VK::GraphicsEngine::CreateFramebuffers()
     {
         vk::ImageView image_views[] =
         {
-                m_msaaImage->GetImageView(),
-                m_depthImage->GetImageView(),
+                m_renderTargets->Get(m_msaaTarget).GetImageView(),
+                m_renderTargets->Get(m_depthTarget).GetImageView(),
                 m_images[i]->GetImageView()
         };
 
@@ -1040,27 +2193,38 @@ void GLVK::VK::GraphicsEngine::CreateFramebuffers()
 
 void GLVK::VK::GraphicsEngine::CreateCommandBuffers()
 {
+	// One primary command buffer per frame slot, re-recorded every frame once the swapchain image is known.
     auto info = vk::CommandBufferAllocateInfo();
-    info.commandBufferCount = static_cast<uint32_t>(m_images.size());
+    info.commandBufferCount = static_cast<uint32_t>(m_frames.size());
     info.commandPool = m_commandPool;
     info.level = vk::CommandBufferLevel::ePrimary;
     m_commandBuffers = m_logicalDevice.allocateCommandBuffers(info);
+
+	if (!m_useIndirectDraws || (!m_hasDrawIndirectCount && !m_useOcclusionCulling)) return;
+
+	auto secondary_info = vk::CommandBufferAllocateInfo();
+	secondary_info.commandBufferCount = static_cast<uint32_t>(m_frames.size() * (m_useOcclusionCulling ? 2 : 1));
+	secondary_info.commandPool = m_commandPool;
+	secondary_info.level = vk::CommandBufferLevel::eSecondary;
+	auto secondary_buffers = m_logicalDevice.allocateCommandBuffers(secondary_info);
+	for (auto i = 0; i < m_frames.size(); ++i)
+	{
+		m_frames[i].IndirectCommandBuffer = secondary_buffers[i];
+		if (m_useOcclusionCulling)
+			m_frames[i].ResumeCommandBuffer = secondary_buffers[m_frames.size() + i];
+	}
 }
 
 void GLVK::VK::GraphicsEngine::CreateSynchronizationObjects()
 {
-    m_imageAcquiredSemaphores.resize(m_images.size());
-    m_renderCompletedSemaphores.resize(m_images.size());
-    m_fences.resize(m_images.size());
-
     auto semaphore_info = vk::SemaphoreCreateInfo();
     auto fence_info = vk::FenceCreateInfo();
     fence_info.flags = vk::FenceCreateFlagBits::eSignaled;
 
-    for (auto i = 0; i < m_images.size(); ++i)
+    for (auto& frame : m_frames)
     {
-        m_imageAcquiredSemaphores[i] = m_logicalDevice.createSemaphore(semaphore_info);
-        m_renderCompletedSemaphores[i] = m_logicalDevice.createSemaphore(semaphore_info);
-        m_fences[i] = m_logicalDevice.createFence(fence_info);
+        frame.ImageAcquiredSemaphore = m_logicalDevice.createSemaphore(semaphore_info);
+        frame.RenderCompletedSemaphore = m_logicalDevice.createSemaphore(semaphore_info);
+        frame.Fence = m_logicalDevice.createFence(fence_info);
     }
 }
\ No newline at end of file
@@ -1,17 +1,39 @@
 #pragma once
 #include <vulkan/vulkan.hpp>
 #include <GLFW/glfw3.h>
+#include <deque>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <string_view>
+#include <unordered_map>
+#include <variant>
 #include <vector>
+#include "../../Culling.h"
 #include "../../Interfaces/IGraphics.h"
 #include "../../Structures/Model.h"
 #include "../../Structures/Vertex.h"
 #include "../../UtilsCommon.h"
+#include "AllocatorVK.h"
 #include "BufferVK.h"
 #include "ImageVK.h"
 #include "PipelineVK.h"
 #include "ShaderVK.h"
+#include "StagingRingVK.h"
+#include "UploadBatchVK.h"
+#include "AsyncUploaderVK.h"
+#include "CommandRecorderVK.h"
+#include "DynamicUniformBufferVK.h"
+#include "GeometryPoolVK.h"
+#include "HiZPyramidVK.h"
+#include "IndirectDrawBufferVK.h"
+#include "MemoryBudgetVK.h"
+#include "PipelineCacheVK.h"
+#include "RenderQueueVK.h"
+#include "RenderTargetPoolVK.h"
+#include "ShaderCompilerVK.h"
+#include "TextureTableVK.h"
 #include "UtilsVK.h"
 
 namespace GLVK
@@ -30,7 +52,7 @@ namespace GLVK
 			: public IGraphics
 		{
 		public:
-			GraphicsEngine(GLFWwindow* window, int width, int height, IResourceManager* resourceManager);
+			GraphicsEngine(GLFWwindow* window, int width, int height, IResourceManager* resourceManager, const GraphicsSettings& settings = GraphicsSettings());
 			~GraphicsEngine();
 
 			virtual void Initialize() override;
@@ -41,13 +63,43 @@ namespace GLVK
 
 			virtual std::shared_ptr<IDisposable> CreateVertexBuffer(const std::vector<Vertex>& vertices) override;
 			virtual std::shared_ptr<IDisposable> CreateIndexBuffer(const std::vector<uint32_t>& indices) override;
+			/// <summary>
+			/// The returned index is the texture's slot in the bindless texture table, which shaders sample it by.
+			/// </summary>
 			virtual std::tuple<IDisposable*, unsigned int> LoadTexture(std::string_view fileName) override;
+
+			/// <summary>
+			/// Give the texture's slot back and destroy the texture once no frame in flight can sample it, so the pointer LoadTexture()
+			/// returned must not be used afterwards. Meshes created by this engine drop the texture and draw untextured from then on.
+			/// </summary>
+			void ReleaseTexture(uint32_t index);
 			virtual std::tuple<IDisposable*, unsigned int> LoadModel(std::string_view modelName, const Vector3& position, const Vector3& scale, const Vector3& rotation, const Vector4& color) override;
 			virtual std::tuple<IDisposable*, unsigned int> CreateMesh(const PrimitiveType& primitiveType, const Vector3& position, const Vector3& scale, const Vector3& rotation, const Vector4& color) override;
+
+			/// <summary>
+			/// Upload caller-made geometry as a mesh of its own, which is not shared with any other mesh.
+			/// </summary>
+			std::tuple<IDisposable*, unsigned int> CreateMesh(ShapeData shapeData, const Vector3& position, const Vector3& scale, const Vector3& rotation, const Vector4& color);
+
+			/// <summary>
+			/// Whether the mesh's geometry still waits for the upload thread to submit it. Such meshes are left out of the frame until then.
+			/// </summary>
+			bool IsUploadPending(const MESH& mesh) const
+			{
+				return mesh.Geometry && m_pendingGeometry.contains(mesh.Geometry.get());
+			}
 			
-			const std::vector<vk::CommandBuffer>& GetCommandBufferOrLists() noexcept
+			/// <summary>
+			/// Queue a mesh or model for this frame. The draw list is emptied by BeginDraw() and recorded by EndDraw().
+			/// </summary>
+			void Draw(MESH* mesh)
 			{
-				return m_commandBuffers;
+				m_drawList.emplace_back(mesh);
+			}
+
+			void Draw(MODEL* model)
+			{
+				m_drawList.emplace_back(model);
 			}
 
 			vk::DeviceSize GetDynamicOffset() const noexcept
@@ -60,18 +112,213 @@ namespace GLVK
 				return m_pipeline.get();
 			}
 
-			const vk::DescriptorSet& GetDescriptorSet() const noexcept
+			PushConstant& GetPushConstant() noexcept
 			{
-				return m_descriptorSet;
+				return m_pushConstant;
 			}
 
-			PushConstant& GetPushConstant() noexcept
+			const vk::DescriptorSet& GetTextureSet() const noexcept
 			{
-				return m_pushConstant;
+				return m_textureTable->GetDescriptorSet();
+			}
+
+			AllocatorStatistics GetMemoryStatistics() const
+			{
+				return m_allocator->GetStatistics();
+			}
+
+			GeometryPoolStatistics GetGeometryStatistics() const
+			{
+				return m_geometryPool->GetStatistics();
+			}
+
+			/// <summary>
+			/// Worker count, slice count and wall time of the last EndDraw() recording.
+			/// </summary>
+			CommandRecorderStatistics GetRecordingStatistics() const
+			{
+				return m_recorder->GetStatistics();
+			}
+
+			/// <summary>
+			/// Record drawCount draws of an already created mesh once per worker count, repetitionCount times each, and time the
+			/// recording alone. The buffers are thrown away unsubmitted. Waits for the device to go idle first, so it is not meant for a running frame loop.
+			/// </summary>
+			std::vector<RecordingBenchmarkResult> BenchmarkRecording(size_t drawCount, const std::vector<size_t>& workerCounts, size_t repetitionCount);
+
+			/// <summary>
+			/// Instanced draws recorded by the last EndDraw(); every distinct geometry and level of detail in the draw list costs one.
+			/// </summary>
+			size_t GetDrawCallCount() const noexcept
+			{
+				return m_instanceBatches.size();
+			}
+
+			const LodStatistics& GetLodStatistics() const noexcept
+			{
+				return m_lodStatistics;
+			}
+
+			const BindStatistics& GetBindStatistics() const noexcept
+			{
+				return m_bindStatistics;
+			}
+
+			/// <summary>
+			/// Per-heap usage and budget plus per-category usage, as of the last Update().
+			/// </summary>
+			const MemoryBudgetReport& GetMemoryBudget() const noexcept
+			{
+				return m_memoryBudget->GetReport();
+			}
+
+			size_t AddMemoryWatermark(float watermark, MemoryWatermarkCallback callback)
+			{
+				return m_memoryBudget->AddWatermark(watermark, std::move(callback));
 			}
 
+			void RemoveMemoryWatermark(size_t id)
+			{
+				m_memoryBudget->RemoveWatermark(id);
+			}
+
+			/// <summary>
+			/// Overrides GraphicsSettings::MeshRetention for every later load of the given model file.
+			/// </summary>
+			void SetMeshDataRetention(std::string_view modelName, MeshDataRetention retention)
+			{
+				m_meshDataRetentions[std::string(modelName)] = retention;
+			}
+
+			/// <summary>
+			/// Submit every upload recorded since the last flush as one batch from the upload thread.
+			/// </summary>
+			std::shared_future<UploadToken> FlushUploads();
+
 		private:
-			inline static constexpr size_t DESCRIPTOR_TYPE_COUNT = 4;
+			inline static constexpr size_t DESCRIPTOR_TYPE_COUNT = 5;
+			inline static constexpr uint32_t CULL_GROUP_SIZE = 64;
+
+			using DrawItem = std::variant<MESH*, MODEL*>;
+
+			/// <summary>
+			/// A run of consecutive instances in the frame's instance buffer that all draw the same level of the same geometry.
+			/// Key is the sort key of the first instance; all of it but the depth is shared by the whole batch. FirstIndex is absolute
+			/// in the geometry pool's index buffer.
+			/// </summary>
+			struct InstanceBatch
+			{
+				uint64_t Key = 0;
+				const GeometryRange* Geometry = nullptr;
+				uint32_t Lod = 0;
+				uint32_t FirstIndex = 0;
+				uint32_t IndexCount = 0;
+				uint32_t FirstInstance = 0;
+				uint32_t InstanceCount = 0;
+			};
+
+			/// <summary>
+			/// What a command buffer has bound so far, so that batches sharing a state do not bind it again.
+			/// </summary>
+			struct BoundState
+			{
+				vk::Pipeline Pipeline = nullptr;
+				vk::DescriptorSet DescriptorSet = nullptr;
+				uint32_t Material = 0;
+				bool IsGeometryBound = false;
+				bool IsPositionOnly = false;
+				uint32_t BindCount = 0;
+				uint32_t SkippedBindCount = 0;
+			};
+
+			struct FrameResources
+			{
+				std::unique_ptr<Buffer> MvpBuffer = nullptr;
+				std::unique_ptr<Buffer> DirectionalLightBuffer = nullptr;
+				std::unique_ptr<Buffer> InstanceBuffer = nullptr;
+				InstanceData* Instances = nullptr;
+				size_t InstanceCapacity = 0;
+
+				/// <summary>
+				/// Only with GPU culling: the CPU writes every instance here and the culling pass copies the visible ones into InstanceBuffer.
+				/// </summary>
+				std::unique_ptr<Buffer> CullInputBuffer = nullptr;
+				CullInstanceData* CullInstances = nullptr;
+				vk::DescriptorSet CullDescriptorSet = nullptr;
+				std::unique_ptr<Buffer> OcclusionBuffer = nullptr;
+				OcclusionData* Occlusion = nullptr;
+				std::unique_ptr<IndirectDrawBuffer> DrawCommands = nullptr;
+
+				/// <summary>
+				/// Set when the swapchain is rebuilt and the culling set still points at the old depth pyramid. The set can only be
+				/// rewritten once the frame's fence shows it is no longer in use.
+				/// </summary>
+				bool IsCullSetStale = false;
+
+				/// <summary>
+				/// With drawIndexedIndirectCount the frame's draws are recorded once and replayed until a buffer they bind is replaced.
+				/// </summary>
+				vk::CommandBuffer IndirectCommandBuffer = nullptr;
+				bool IsIndirectRecorded = false;
+
+				/// <summary>
+				/// Only with occlusion culling: the second render pass's draws. Both are recorded again when the batch count changes.
+				/// </summary>
+				vk::CommandBuffer ResumeCommandBuffer = nullptr;
+				uint32_t RecordedBatchCount = 0;
+
+				/// <summary>
+				/// The sort key state the replayed buffers bind; they are only reused while every batch shares it.
+				/// </summary>
+				uint32_t RecordedState = 0;
+
+				/// <summary>
+				/// Pipeline::GetGeneration() when the replayed buffers were recorded; they may hold stand-ins for pipelines compiled since.
+				/// </summary>
+				uint32_t RecordedPipelineGeneration = 0;
+				vk::DescriptorSet DescriptorSet = nullptr;
+				vk::Semaphore ImageAcquiredSemaphore = nullptr;
+				vk::Semaphore RenderCompletedSemaphore = nullptr;
+				vk::Fence Fence = nullptr;
+			};
+
+			/// <summary>
+			/// Everything a rebuilt swapchain replaced. Frames submitted before the rebuild may still use it, so it is only destroyed
+			/// once every frame slot that was pending has waited on its fence.
+			/// </summary>
+			struct RetiredSwapchain
+			{
+				vk::SwapchainKHR Swapchain = nullptr;
+				std::vector<vk::Framebuffer> Framebuffers;
+				std::vector<std::unique_ptr<Image>> Images;
+				std::unique_ptr<RenderTargetPool> RenderTargets = nullptr;
+				std::unique_ptr<HiZPyramid> Pyramid = nullptr;
+				std::vector<bool> PendingFrames;
+			};
+
+			/// <summary>
+			/// A texture released before its upload was submitted. The upload still writes the image, so its slot only starts to
+			/// retire once FlushCount is submitted.
+			/// </summary>
+			struct ReleasedTexture
+			{
+				uint32_t Slot = 0;
+				uint64_t FlushCount = 0;
+				std::string Name;
+			};
+
+			/// <summary>
+			/// Where a shader is loaded from and the pipelines built with it, which are rebuilt when its source changes.
+			/// </summary>
+			struct ShaderSource
+			{
+				std::string SourcePath;
+				std::string SpirvPath;
+				vk::ShaderStageFlagBits Stage = vk::ShaderStageFlagBits::eVertex;
+				std::vector<std::string> Defines;
+				std::unique_ptr<Shader>* Target = nullptr;
+				std::vector<ShaderType> Dependents;
+			};
 
 			static std::vector<const char*> GetRequiredExtensions(bool debug) noexcept;
 			static bool CheckLayerSupport() noexcept;
@@ -94,15 +341,38 @@ namespace GLVK
 			void GetPhysicalDevice();
 			void CreateLogicalDevice();
 			void CreateSwapchain();
+			void RecreateSwapchain();
+			void ReleaseRetiredSwapchains(size_t frameIndex);
+			void CreateTextureTable();
 			void LoadShader();
+			[[nodiscard]] std::unique_ptr<Shader> CreateShader(const ShaderSource& source) const;
+			[[nodiscard]] std::vector<vk::PipelineShaderStageCreateInfo> GetShaderStageInfos(const ShaderType& shaderType) const;
+			void ReloadChangedShaders();
 			void CreateDescriptorLayout();
 			void CreateDescriptorSets();
 			void CreateDepthImage();
 			void CreateMultisamplingImage();
 			void CreateUniformBuffers();
+			void CreateInstanceBuffer(FrameResources& frame, size_t capacity);
+			bool BuildInstanceBatches(FrameResources& frame);
+			uint32_t SelectLod(MESH& mesh, const glm::vec4& sphere, float distance) const;
+			void WriteStorageDescriptors(const FrameResources& frame);
+			void RecordCulling(const vk::CommandBuffer& commandBuffer, const FrameResources& frame, uint32_t phase = 0) const;
+			void RecordOcclusionCommands(FrameResources& frame);
+			void CreateVisibilityBuffer(size_t capacity);
+			void BindDrawState(const vk::CommandBuffer& commandBuffer, const FrameResources& frame, uint64_t key, BoundState& state) const;
+			void RecordBatches(const vk::CommandBuffer& commandBuffer, const FrameResources& frame, size_t first, size_t last, uint32_t firstCommand, BoundState& state, bool isDepthPrePass = false) const;
+			[[nodiscard]] uint64_t GetRecordedKey() const noexcept;
+			void RecordIndirectCommands(FrameResources& frame);
 			void CreateFramebuffers();
 			void CreateCommandBuffers();
 			void CreateSynchronizationObjects();
+			std::shared_ptr<Buffer> UploadBuffer(const void* data, vk::DeviceSize size, const vk::BufferUsageFlags& bufferUsage);
+			void UploadGeometry(MESH& mesh, MeshDataRetention retention);
+			void CollectSubmittedUploads();
+			void RetireTexture(uint32_t slot, std::string name);
+			std::tuple<IDisposable*, unsigned int> PlaceMesh(MESH& mesh, const Vector3& position, const Vector3& scale, const Vector3& rotation, const Vector4& color);
+			MeshDataRetention GetMeshDataRetention(std::string_view modelName) const;
 
 			inline static const std::vector<const char*> m_enabledLayerNames = {
 				"VK_LAYER_KHRONOS_validation"
@@ -111,8 +381,9 @@ namespace GLVK
 				VK_KHR_SWAPCHAIN_EXTENSION_NAME
 			};
 
+			GraphicsSettings m_settings = {};
 			bool m_debug = true;
-			size_t m_currentImageIndex = 0;
+			size_t m_currentFrame = 0;
 			vk::Instance m_instance = nullptr;
 			vk::DebugUtilsMessengerEXT m_debugUtils = nullptr;
 			vk::PhysicalDevice m_physicalDevice = nullptr;
@@ -126,38 +397,101 @@ namespace GLVK
 			vk::SurfaceFormatKHR m_surfaceFormat = {};
 			vk::Format m_format = {};
 			vk::SwapchainKHR m_swapchain = nullptr;
+			std::vector<RetiredSwapchain> m_retiredSwapchains;
+
+			/// <summary>
+			/// Set when presenting reports the swapchain out of date or suboptimal, or the window was resized. The next EndDraw()
+			/// rebuilds it; while the window is minimised it stays set and frames are skipped.
+			/// </summary>
+			bool m_isSwapchainStale = false;
 			
 			vk::Extent2D m_extent = {};
 			vk::Queue m_graphicsQueue = nullptr;
 			vk::Queue m_presentQueue = nullptr;
+			vk::Queue m_transferQueue = nullptr;
+			std::mutex m_graphicsQueueMutex;
 			vk::CommandPool m_commandPool = nullptr;
 			vk::DescriptorSetLayout m_descriptorSetLayout = nullptr;
+			vk::DescriptorSetLayout m_cullSetLayout = nullptr;
 			vk::DescriptorPool m_descriptorPool = nullptr;
-			vk::DescriptorSet m_descriptorSet = nullptr;
 			std::vector<vk::Framebuffer> m_framebuffers;
 			std::vector<vk::CommandBuffer> m_commandBuffers;
-			std::vector<vk::Semaphore> m_imageAcquiredSemaphores;
-			std::vector<vk::Semaphore> m_renderCompletedSemaphores;
-			std::vector<vk::Fence> m_fences;
+			std::vector<vk::CommandBuffer> m_secondaryCommandBuffers;
+			std::unique_ptr<CommandRecorder> m_recorder = nullptr;
+			std::vector<DrawItem> m_drawList;
+			std::vector<CullInstanceData> m_drawInstances;
+			RenderQueue m_renderQueue;
+
+			/// <summary>
+			/// The geometry field of a sort key is a per-frame id times MeshLod::MAX_LEVEL_COUNT plus the level; the id indexes the
+			/// first mesh queued with that geometry, whose level table every copy shares.
+			/// </summary>
+			std::unordered_map<const GeometryRange*, uint32_t> m_geometryIds;
+			std::vector<const MESH*> m_queuedMeshes;
+			std::vector<InstanceBatch> m_instanceBatches;
+			LodStatistics m_lodStatistics = {};
+			BindStatistics m_bindStatistics = {};
+			std::vector<FrameResources> m_frames;
+
+			std::unique_ptr<Allocator> m_allocator = nullptr;
+			std::unique_ptr<MemoryBudget> m_memoryBudget = nullptr;
+			bool m_hasMemoryBudget = false;
+			bool m_useIndirectDraws = false;
+			bool m_hasMultiDrawIndirect = false;
+			bool m_hasDrawIndirectCount = false;
+			bool m_useGpuCulling = false;
+			bool m_useCpuCulling = false;
+			bool m_useOcclusionCulling = false;
+			std::unique_ptr<HiZPyramid> m_hizPyramid = nullptr;
+
+			/// <summary>
+			/// One flag per drawn mesh, shared by all frames because each frame's first phase reads what the previous frame's second phase wrote.
+			/// Indexed by the mesh's place in the draw list and refilled with ones whenever the draw list changes.
+			/// </summary>
+			std::unique_ptr<Buffer> m_visibilityBuffer = nullptr;
+			size_t m_visibilityCapacity = 0;
+			std::vector<DrawItem> m_lastDrawList;
+			size_t m_lastDrawInstanceCount = 0;
+			bool m_isVisibilityReset = true;
+			CullingBounds m_cullBounds;
+			std::vector<uint32_t> m_visibleInstances;
+			std::unique_ptr<StagingRing> m_stagingRing = nullptr;
+			std::unique_ptr<AsyncUploader> m_uploader = nullptr;
+			std::unique_ptr<GeometryPool> m_geometryPool = nullptr;
+			std::unique_ptr<DynamicUniformBuffer> m_modelUniforms = nullptr;
+			std::unique_ptr<DynamicUniformBuffer> m_meshUniforms = nullptr;
+			std::deque<std::shared_future<UploadToken>> m_pendingUploads;
+			bool m_hasUnflushedUploads = false;
 
+			/// <summary>
+			/// Geometry and texture slots whose upload has not been submitted yet, by the number of the flush that carries it. The upload
+			/// thread submits flushes in order, so an entry is dropped once m_submittedFlushCount has gone past its number.
+			/// </summary>
+			uint64_t m_flushCount = 0;
+			uint64_t m_submittedFlushCount = 0;
+			std::unordered_map<const GeometryRange*, uint64_t> m_pendingGeometry;
+			std::unordered_map<uint32_t, uint64_t> m_pendingTextures;
+			std::vector<ReleasedTexture> m_releasedTextures;
 			std::vector<std::unique_ptr<Image>> m_images;
 			std::unique_ptr<Shader> m_vertexShader = nullptr;
 			std::unique_ptr<Shader> m_fragmentShader = nullptr;
-			std::unique_ptr<Shader> m_vertexShaderMesh = nullptr;
-			std::unique_ptr<Buffer> m_intermediateBuffer = nullptr;
-			//std::vector<std::unique_ptr<Buffer>> m_mvpBuffers;
-			std::unique_ptr<Buffer> m_mvpBuffer = nullptr;
-			//std::vector<std::unique_ptr<Buffer>> m_directionalLightBuffers;
-			std::unique_ptr<Buffer> m_directionalLightBuffer = nullptr;
-			std::unique_ptr<Buffer> m_dynamicMeshUniformBuffer = nullptr;
-			std::unique_ptr<Buffer> m_dynamicModelUniformBuffer = nullptr;
-			std::unique_ptr<Image> m_depthImage = nullptr;
-			std::unique_ptr<Image> m_msaaImage = nullptr;
+			std::unique_ptr<Shader> m_cullShader = nullptr;
+			std::unique_ptr<Shader> m_hizShader = nullptr;
+			std::unique_ptr<Shader> m_depthPrePassShader = nullptr;
+			std::unique_ptr<ShaderCompiler> m_shaderCompiler = nullptr;
+			std::vector<ShaderSource> m_shaderSources;
+			std::unique_ptr<RenderTargetPool> m_renderTargets = nullptr;
+			size_t m_depthTarget = 0;
+			size_t m_msaaTarget = 0;
 			std::unique_ptr<Pipeline> m_pipeline = nullptr;
+			std::unique_ptr<PipelineCache> m_pipelineCache = nullptr;
+			std::unique_ptr<TextureTable> m_textureTable = nullptr;
 			
 			std::vector<Image*> m_textures;
 			std::vector<MODEL*> m_models;
 			std::vector<MESH*> m_meshes;
+			std::unordered_map<PrimitiveType, MESH> m_primitives;
+			std::unordered_map<std::string, MeshDataRetention> m_meshDataRetentions;
 
 			MVP m_mvp = {};
 			DirectionalLight m_directionalLight = {};
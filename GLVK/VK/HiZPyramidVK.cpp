@@ -0,0 +1,195 @@
+#include "HiZPyramidVK.h"
+#include <algorithm>
+#include <bit>
+#include "../../UtilsCommon.h"
+#include "UtilsVK.h"
+
+GLVK::VK::HiZPyramid::HiZPyramid(const vk::Device& device, Allocator& allocator, const vk::Extent2D& depthExtent)
+	: m_logicalDevice(device), m_depthExtent(depthExtent)
+{
+	// Odd sized levels would shift texel boundaries away from the UVs the occlusion test samples by; level 0 instead takes
+	// each texel's whole, slightly larger than 1x1, footprint in the depth buffer.
+	m_extent = vk::Extent2D(std::bit_floor(std::max(depthExtent.width, 1u)), std::bit_floor(std::max(depthExtent.height, 1u)));
+	for (auto size = std::max(m_extent.width, m_extent.height); size > 0; size /= 2)
+		++m_levelCount;
+
+	m_image = std::make_unique<Image>(m_logicalDevice, vk::Format::eR32Sfloat, vk::SampleCountFlagBits::e1, m_extent, vk::ImageType::e2D, m_levelCount, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled);
+	m_image->AllocateMemory(allocator, vk::MemoryPropertyFlagBits::eDeviceLocal, AllocationPool::FreeList, MemoryCategory::RenderTargets);
+	m_image->CreateImageView(vk::Format::eR32Sfloat, vk::ImageAspectFlagBits::eColor, m_levelCount, vk::ImageViewType::e2D);
+
+	for (uint32_t i = 0; i < m_levelCount; ++i)
+	{
+		auto info = vk::ImageViewCreateInfo();
+		info.format = vk::Format::eR32Sfloat;
+		info.image = m_image->GetImage();
+		info.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+		info.subresourceRange.baseArrayLayer = 0;
+		info.subresourceRange.baseMipLevel = i;
+		info.subresourceRange.layerCount = 1;
+		info.subresourceRange.levelCount = 1;
+		info.viewType = vk::ImageViewType::e2D;
+		m_levelViews.emplace_back(m_logicalDevice.createImageView(info));
+	}
+
+	// Only ever read with texelFetch and textureLod at whole levels, so no filtering is wanted.
+	auto sampler_info = vk::SamplerCreateInfo();
+	sampler_info.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+	sampler_info.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+	sampler_info.addressModeW = vk::SamplerAddressMode::eClampToEdge;
+	sampler_info.magFilter = vk::Filter::eNearest;
+	sampler_info.minFilter = vk::Filter::eNearest;
+	sampler_info.mipmapMode = vk::SamplerMipmapMode::eNearest;
+	sampler_info.minLod = 0.0f;
+	sampler_info.maxLod = static_cast<float>(m_levelCount);
+	m_sampler = m_logicalDevice.createSampler(sampler_info);
+
+	// Per level: the depth buffer, the level above and the level being written.
+	vk::DescriptorSetLayoutBinding bindings[3] = {};
+	bindings[0].binding = 0;
+	bindings[0].descriptorCount = 1;
+	bindings[0].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+	bindings[0].stageFlags = vk::ShaderStageFlagBits::eCompute;
+	bindings[1].binding = 1;
+	bindings[1].descriptorCount = 1;
+	bindings[1].descriptorType = vk::DescriptorType::eStorageImage;
+	bindings[1].stageFlags = vk::ShaderStageFlagBits::eCompute;
+	bindings[2].binding = 2;
+	bindings[2].descriptorCount = 1;
+	bindings[2].descriptorType = vk::DescriptorType::eStorageImage;
+	bindings[2].stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+	auto layout_info = vk::DescriptorSetLayoutCreateInfo();
+	layout_info.bindingCount = static_cast<uint32_t>(_countof(bindings));
+	layout_info.pBindings = bindings;
+	m_setLayout = m_logicalDevice.createDescriptorSetLayout(layout_info);
+
+	vk::DescriptorPoolSize pool_sizes[2] = {};
+	pool_sizes[0].descriptorCount = m_levelCount;
+	pool_sizes[0].type = vk::DescriptorType::eCombinedImageSampler;
+	pool_sizes[1].descriptorCount = m_levelCount * 2;
+	pool_sizes[1].type = vk::DescriptorType::eStorageImage;
+
+	auto pool_info = vk::DescriptorPoolCreateInfo();
+	pool_info.maxSets = m_levelCount;
+	pool_info.poolSizeCount = static_cast<uint32_t>(_countof(pool_sizes));
+	pool_info.pPoolSizes = pool_sizes;
+	m_descriptorPool = m_logicalDevice.createDescriptorPool(pool_info);
+
+	auto layouts = std::vector<vk::DescriptorSetLayout>(m_levelCount, m_setLayout);
+	auto allocate_info = vk::DescriptorSetAllocateInfo();
+	allocate_info.descriptorPool = m_descriptorPool;
+	allocate_info.descriptorSetCount = m_levelCount;
+	allocate_info.pSetLayouts = layouts.data();
+	m_descriptorSets = m_logicalDevice.allocateDescriptorSets(allocate_info);
+
+	auto image_infos = std::vector<vk::DescriptorImageInfo>(m_levelCount * 2);
+	auto write_descriptors = std::vector<vk::WriteDescriptorSet>();
+	for (uint32_t i = 0; i < m_levelCount; ++i)
+	{
+		// Level 0 reads the depth buffer instead; its source binding only has to hold a valid image.
+		auto& source_info = image_infos[i * 2];
+		source_info.imageLayout = vk::ImageLayout::eGeneral;
+		source_info.imageView = m_levelViews[i > 0 ? i - 1 : 0];
+
+		auto& destination_info = image_infos[i * 2 + 1];
+		destination_info.imageLayout = vk::ImageLayout::eGeneral;
+		destination_info.imageView = m_levelViews[i];
+
+		for (uint32_t j = 0; j < 2; ++j)
+		{
+			auto& write_descriptor = write_descriptors.emplace_back();
+			write_descriptor.descriptorCount = 1;
+			write_descriptor.descriptorType = vk::DescriptorType::eStorageImage;
+			write_descriptor.dstArrayElement = 0;
+			write_descriptor.dstBinding = j + 1;
+			write_descriptor.dstSet = m_descriptorSets[i];
+			write_descriptor.pImageInfo = &image_infos[i * 2 + j];
+		}
+	}
+	m_logicalDevice.updateDescriptorSets(write_descriptors, {});
+}
+
+GLVK::VK::HiZPyramid::~HiZPyramid()
+{
+	m_logicalDevice.destroyDescriptorPool(m_descriptorPool);
+	m_logicalDevice.destroyDescriptorSetLayout(m_setLayout);
+	m_logicalDevice.destroySampler(m_sampler);
+
+	for (auto& view : m_levelViews)
+		m_logicalDevice.destroyImageView(view);
+
+	m_image.reset();
+}
+
+void GLVK::VK::HiZPyramid::SetDepthSource(const vk::ImageView& depthView)
+{
+	auto depth_info = vk::DescriptorImageInfo();
+	depth_info.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+	depth_info.imageView = depthView;
+	depth_info.sampler = m_sampler;
+
+	auto write_descriptors = std::vector<vk::WriteDescriptorSet>(m_levelCount);
+	for (uint32_t i = 0; i < m_levelCount; ++i)
+	{
+		write_descriptors[i].descriptorCount = 1;
+		write_descriptors[i].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+		write_descriptors[i].dstArrayElement = 0;
+		write_descriptors[i].dstBinding = 0;
+		write_descriptors[i].dstSet = m_descriptorSets[i];
+		write_descriptors[i].pImageInfo = &depth_info;
+	}
+	m_logicalDevice.updateDescriptorSets(write_descriptors, {});
+}
+
+void GLVK::VK::HiZPyramid::Record(const vk::CommandBuffer& commandBuffer, const vk::Pipeline& pipeline, const vk::PipelineLayout& pipelineLayout)
+{
+	// The previous build's readers have to be done before any level is overwritten; the first build also leaves eUndefined.
+	auto barrier = vk::ImageMemoryBarrier();
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = m_image->GetImage();
+	barrier.oldLayout = m_isInitialized ? vk::ImageLayout::eGeneral : vk::ImageLayout::eUndefined;
+	barrier.newLayout = vk::ImageLayout::eGeneral;
+	barrier.srcAccessMask = {};
+	barrier.dstAccessMask = vk::AccessFlagBits::eShaderWrite;
+	barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.subresourceRange.levelCount = m_levelCount;
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, {}, {}, barrier);
+	m_isInitialized = true;
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+
+	barrier.oldLayout = vk::ImageLayout::eGeneral;
+	barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+	barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+	barrier.subresourceRange.levelCount = 1;
+
+	for (uint32_t i = 0; i < m_levelCount; ++i)
+	{
+		auto source = i > 0 ? GetLevelExtent(i - 1) : m_depthExtent;
+		auto destination = GetLevelExtent(i);
+
+		auto constants = HiZPushConstant();
+		constants.SourceWidth = static_cast<int32_t>(source.width);
+		constants.SourceHeight = static_cast<int32_t>(source.height);
+		constants.DestinationWidth = static_cast<int32_t>(destination.width);
+		constants.DestinationHeight = static_cast<int32_t>(destination.height);
+		constants.FromDepth = i == 0 ? 1 : 0;
+
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, { m_descriptorSets[i] }, {});
+		commandBuffer.pushConstants<HiZPushConstant>(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, { constants });
+		commandBuffer.dispatch((destination.width + GROUP_SIZE - 1) / GROUP_SIZE, (destination.height + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+
+		// The next level reads this one, and after the last level the culling pass reads them all.
+		barrier.subresourceRange.baseMipLevel = i;
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, {}, {}, barrier);
+	}
+}
+
+vk::Extent2D GLVK::VK::HiZPyramid::GetLevelExtent(uint32_t level) const noexcept
+{
+	return vk::Extent2D(std::max(m_extent.width >> level, 1u), std::max(m_extent.height >> level, 1u));
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include "AllocatorVK.h"
+#include "ImageVK.h"
+
+namespace GLVK
+{
+	namespace VK
+	{
+		/// <summary>
+		/// A mip chain of the farthest depth in every 2x2 block, built from a multisampled depth buffer by hizBuild.comp.
+		/// Level 0 is the depth buffer's resolution rounded down to powers of two, so every level halves exactly and each texel
+		/// covers the same UV range as the 2x2 block below it. An occlusion test samples the level where a screen space box
+		/// covers at most 2x2 texels and compares the box's nearest depth against the farthest depth there.
+		/// </summary>
+		class HiZPyramid
+		{
+		public:
+			inline static constexpr uint32_t GROUP_SIZE = 8;
+
+			HiZPyramid(const vk::Device& device, Allocator& allocator, const vk::Extent2D& depthExtent);
+			~HiZPyramid();
+
+			HiZPyramid(const HiZPyramid&) = delete;
+			HiZPyramid& operator=(const HiZPyramid&) = delete;
+
+			/// <summary>
+			/// Point the build at the depth attachment it reduces. Has to be called again whenever the attachment is recreated.
+			/// </summary>
+			void SetDepthSource(const vk::ImageView& depthView);
+
+			/// <summary>
+			/// Rebuild every level from the depth source, which must be in eShaderReadOnlyOptimal. The pyramid stays in eGeneral
+			/// and is ready for compute shader reads once the recorded commands have executed.
+			/// </summary>
+			void Record(const vk::CommandBuffer& commandBuffer, const vk::Pipeline& pipeline, const vk::PipelineLayout& pipelineLayout);
+
+			[[nodiscard]] const vk::DescriptorSetLayout& GetSetLayout() const noexcept
+			{
+				return m_setLayout;
+			}
+
+			[[nodiscard]] const vk::ImageView& GetImageView() const noexcept
+			{
+				return m_image->GetImageView();
+			}
+
+			[[nodiscard]] const vk::Sampler& GetSampler() const noexcept
+			{
+				return m_sampler;
+			}
+
+			[[nodiscard]] vk::Extent2D GetExtent() const noexcept
+			{
+				return m_extent;
+			}
+
+			[[nodiscard]] uint32_t GetLevelCount() const noexcept
+			{
+				return m_levelCount;
+			}
+
+		private:
+			[[nodiscard]] vk::Extent2D GetLevelExtent(uint32_t level) const noexcept;
+
+			vk::Device m_logicalDevice = nullptr;
+			std::unique_ptr<Image> m_image = nullptr;
+			std::vector<vk::ImageView> m_levelViews;
+			vk::Sampler m_sampler = nullptr;
+			vk::DescriptorSetLayout m_setLayout = nullptr;
+			vk::DescriptorPool m_descriptorPool = nullptr;
+			std::vector<vk::DescriptorSet> m_descriptorSets;
+			vk::Extent2D m_depthExtent = {};
+			vk::Extent2D m_extent = {};
+			uint32_t m_levelCount = 0;
+			bool m_isInitialized = false;
+		};
+	}
+}
@@ -65,6 +65,12 @@ void GLVK::VK::Image::CreateImageView(const vk::Format& format, const vk::ImageA
 void GLVK::VK::Image::TransitionLayout(const vk::ImageLayout& srcLayout, const vk::ImageLayout& dstLayout, const vk::CommandPool& commandPool, const vk::Queue& graphicsQueue, const vk::ImageAspectFlags& imageAspects, uint32_t levelCount)
 {
 	auto cmd_buffer = CreateSingleTimeBuffer(m_logicalDevice, commandPool);
+	RecordTransitionLayout(cmd_buffer, srcLayout, dstLayout, imageAspects, levelCount);
+	ExecuteCommandBuffer(cmd_buffer, m_logicalDevice, commandPool, graphicsQueue);
+}
+
+void GLVK::VK::Image::RecordTransitionLayout(const vk::CommandBuffer& commandBuffer, const vk::ImageLayout& srcLayout, const vk::ImageLayout& dstLayout, const vk::ImageAspectFlags& imageAspects, uint32_t levelCount)
+{
 	auto old_stage = vk::PipelineStageFlagBits();
 	auto new_stage = vk::PipelineStageFlagBits();
 
@@ -99,14 +105,18 @@ void GLVK::VK::Image::TransitionLayout(const vk::ImageLayout& srcLayout, const v
 		barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
 	}
 
-	cmd_buffer.pipelineBarrier(old_stage, new_stage, {}, {}, {}, barrier);
-	ExecuteCommandBuffer(cmd_buffer, m_logicalDevice, commandPool, graphicsQueue);
+	commandBuffer.pipelineBarrier(old_stage, new_stage, {}, {}, {}, barrier);
 }
 
 void GLVK::VK::Image::GenerateMipmaps(const vk::CommandPool& commandPool, const vk::Queue& graphicsQueue, uint32_t levelCount)
 {
 	auto cmd_buffer = CreateSingleTimeBuffer(m_logicalDevice, commandPool);
+	RecordGenerateMipmaps(cmd_buffer, levelCount);
+	ExecuteCommandBuffer(cmd_buffer, m_logicalDevice, commandPool, graphicsQueue);
+}
 
+void GLVK::VK::Image::RecordGenerateMipmaps(const vk::CommandBuffer& commandBuffer, uint32_t levelCount)
+{
 	auto barrier = vk::ImageMemoryBarrier();
 	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 	barrier.image = m_image;
@@ -130,7 +140,7 @@ void GLVK::VK::Image::GenerateMipmaps(const vk::CommandPool& commandPool, const
 		barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
 		barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
 
-		cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, barrier);
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, barrier);
 
 		auto blit = vk::ImageBlit();
 		blit.dstOffsets[0] = vk::Offset3D(0, 0, 0);
@@ -146,14 +156,14 @@ void GLVK::VK::Image::GenerateMipmaps(const vk::CommandPool& commandPool, const
 		blit.srcSubresource.layerCount = 1;
 		blit.srcSubresource.mipLevel = i - 1;
 
-		cmd_buffer.blitImage(m_image, vk::ImageLayout::eTransferSrcOptimal, m_image, vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
+		commandBuffer.blitImage(m_image, vk::ImageLayout::eTransferSrcOptimal, m_image, vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
 
 		barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
 		barrier.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
 		barrier.srcAccessMask = vk::AccessFlagBits::eTransferRead;
 		barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
 
-		cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, {}, {}, barrier);
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, {}, {}, barrier);
 
 		if (width > 1)
 			width /= 2;
@@ -167,9 +177,7 @@ void GLVK::VK::Image::GenerateMipmaps(const vk::CommandPool& commandPool, const
 	barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
 	barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
 
-	cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, {}, {}, barrier);
-
-	ExecuteCommandBuffer(cmd_buffer, m_logicalDevice, commandPool, graphicsQueue);
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, {}, {}, barrier);
 }
 
 void GLVK::VK::Image::CreateSampler(uint32_t levelCount)
@@ -210,10 +218,17 @@ void GLVK::VK::Image::Dispose()
 	m_isDisposed = true;
 }
 
-const vk::DeviceMemory& GLVK::VK::Image::AllocateMemory(const vk::PhysicalDevice& physicalDevice, const vk::MemoryPropertyFlags& memoryProperties)
+void GLVK::VK::Image::BindMemory(const Allocation& allocation)
+{
+	m_allocation = allocation;
+	m_deviceMemory = allocation.Memory;
+	m_logicalDevice.bindImageMemory(m_image, m_deviceMemory, m_allocation.Offset);
+}
+
+const vk::DeviceMemory& GLVK::VK::Image::AllocateMemory(Allocator& allocator, const vk::MemoryPropertyFlags& memoryProperties, AllocationPool pool, MemoryCategory category)
 {
 	auto requirements = m_logicalDevice.getImageMemoryRequirements(m_image);
-	MapDeviceMemory(requirements, physicalDevice, memoryProperties);
-	m_logicalDevice.bindImageMemory(m_image, m_deviceMemory, 0);
+	MapDeviceMemory(requirements, allocator, memoryProperties, pool, true, category);
+	m_logicalDevice.bindImageMemory(m_image, m_deviceMemory, m_allocation.Offset);
 	return m_deviceMemory;
 }
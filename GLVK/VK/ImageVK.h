@@ -18,11 +18,18 @@ namespace GLVK
 
 			virtual void Dispose() override;
 
-			virtual const vk::DeviceMemory& AllocateMemory(const vk::PhysicalDevice& physicalDevice, const vk::MemoryPropertyFlags& memoryProperties) override;
+			virtual const vk::DeviceMemory& AllocateMemory(Allocator& allocator, const vk::MemoryPropertyFlags& memoryProperties, AllocationPool pool = AllocationPool::FreeList, MemoryCategory category = MemoryCategory::Other) override;
+
+			/// <summary>
+			/// Binds memory that is owned elsewhere, e.g. shared between aliased render targets. The image does not free it.
+			/// </summary>
+			void BindMemory(const Allocation& allocation);
 
 			void CreateImageView(const vk::Format& format, const vk::ImageAspectFlags& aspectMask, uint32_t levelCount, const vk::ImageViewType& imageViewType);
 			void TransitionLayout(const vk::ImageLayout& srcLayout, const vk::ImageLayout& dstLayout, const vk::CommandPool& commandPool, const vk::Queue& graphicsQueue, const vk::ImageAspectFlags& imageAspects, uint32_t levelCount);
 			void GenerateMipmaps(const vk::CommandPool& commandPool, const vk::Queue& graphicsQueue, uint32_t levelCount);
+			void RecordTransitionLayout(const vk::CommandBuffer& commandBuffer, const vk::ImageLayout& srcLayout, const vk::ImageLayout& dstLayout, const vk::ImageAspectFlags& imageAspects, uint32_t levelCount);
+			void RecordGenerateMipmaps(const vk::CommandBuffer& commandBuffer, uint32_t levelCount);
 			void CreateSampler(uint32_t levelCount);
 
 			[[nodiscard]] const vk::Image& GetImage() const noexcept
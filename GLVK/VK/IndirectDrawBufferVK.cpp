@@ -0,0 +1,67 @@
+#include "IndirectDrawBufferVK.h"
+#include <algorithm>
+#include <cassert>
+
+GLVK::VK::IndirectDrawBuffer::IndirectDrawBuffer(const vk::Device& device, Allocator& allocator, uint32_t capacity)
+	: m_logicalDevice(device), m_allocator(&allocator)
+{
+	Create(std::max(capacity, 1u));
+}
+
+bool GLVK::VK::IndirectDrawBuffer::Reserve(uint32_t drawCount)
+{
+	if (drawCount <= m_capacity) return false;
+
+	Create(std::max(drawCount, m_capacity * 2));
+	return true;
+}
+
+void GLVK::VK::IndirectDrawBuffer::Clear() noexcept
+{
+	m_drawCount = 0;
+	*m_mappedCount = 0;
+}
+
+void GLVK::VK::IndirectDrawBuffer::Add(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance) noexcept
+{
+	assert(m_drawCount < m_capacity);
+
+	auto& command = m_mappedCommands[m_drawCount];
+	command.indexCount = indexCount;
+	command.instanceCount = instanceCount;
+	command.firstIndex = firstIndex;
+	command.vertexOffset = vertexOffset;
+	command.firstInstance = firstInstance;
+	*m_mappedCount = ++m_drawCount;
+}
+
+void GLVK::VK::IndirectDrawBuffer::Draw(const vk::CommandBuffer& commandBuffer, uint32_t first, uint32_t count, bool multiDraw) const
+{
+	auto offset = COMMAND_OFFSET + static_cast<vk::DeviceSize>(first) * COMMAND_STRIDE;
+	if (multiDraw)
+	{
+		if (count > 0) commandBuffer.drawIndexedIndirect(m_buffer->GetBuffer(), offset, count, COMMAND_STRIDE);
+		return;
+	}
+
+	for (uint32_t i = 0; i < count; ++i)
+		commandBuffer.drawIndexedIndirect(m_buffer->GetBuffer(), offset + static_cast<vk::DeviceSize>(i) * COMMAND_STRIDE, 1, COMMAND_STRIDE);
+}
+
+void GLVK::VK::IndirectDrawBuffer::DrawWithCount(const vk::CommandBuffer& commandBuffer) const
+{
+	commandBuffer.drawIndexedIndirectCount(m_buffer->GetBuffer(), COMMAND_OFFSET, m_buffer->GetBuffer(), 0, m_capacity, COMMAND_STRIDE);
+}
+
+void GLVK::VK::IndirectDrawBuffer::Create(uint32_t capacity)
+{
+	auto size = COMMAND_OFFSET + static_cast<vk::DeviceSize>(capacity) * COMMAND_STRIDE;
+	m_buffer = std::make_unique<Buffer>(m_logicalDevice, vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eStorageBuffer, size);
+	m_buffer->AllocateMemory(*m_allocator, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, AllocationPool::FreeList, MemoryCategory::Other);
+
+	auto mapped = reinterpret_cast<uint8_t*>(m_buffer->Map(size));
+	m_mappedCount = reinterpret_cast<uint32_t*>(mapped);
+	m_mappedCommands = reinterpret_cast<vk::DrawIndexedIndirectCommand*>(mapped + COMMAND_OFFSET);
+	m_capacity = capacity;
+	Clear();
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <memory>
+#include <vulkan/vulkan.hpp>
+#include "AllocatorVK.h"
+#include "BufferVK.h"
+
+namespace GLVK
+{
+	namespace VK
+	{
+		/// <summary>
+		/// A persistently mapped buffer of VkDrawIndexedIndirectCommand records preceded by a draw count, so a frame's draws
+		/// can be changed by writing the buffer instead of recording new commands. The count sits in the same buffer, which
+		/// is all vkCmdDrawIndexedIndirectCount needs, and the buffer is also a storage buffer so a compute pass can fill it.
+		/// </summary>
+		class IndirectDrawBuffer
+		{
+		public:
+			/// <summary>
+			/// The draw count is a uint32_t at offset 0; the commands start here.
+			/// </summary>
+			inline static constexpr vk::DeviceSize COMMAND_OFFSET = 16;
+			inline static constexpr uint32_t COMMAND_STRIDE = static_cast<uint32_t>(sizeof(vk::DrawIndexedIndirectCommand));
+
+			IndirectDrawBuffer(const vk::Device& device, Allocator& allocator, uint32_t capacity);
+
+			IndirectDrawBuffer(const IndirectDrawBuffer&) = delete;
+			IndirectDrawBuffer& operator=(const IndirectDrawBuffer&) = delete;
+
+			/// <summary>
+			/// Make room for drawCount commands. Returns true when the buffer had to be replaced, which invalidates
+			/// every command buffer and descriptor that refers to the old one. The previous contents are dropped.
+			/// </summary>
+			bool Reserve(uint32_t drawCount);
+			void Clear() noexcept;
+			void Add(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance) noexcept;
+
+			/// <summary>
+			/// Record the commands in [first, first + count). One multi-draw when multiDraw is set, otherwise one draw per command.
+			/// </summary>
+			void Draw(const vk::CommandBuffer& commandBuffer, uint32_t first, uint32_t count, bool multiDraw) const;
+
+			/// <summary>
+			/// Record a single draw whose count is read from the buffer when it executes; stays valid as long as the buffer is not replaced.
+			/// </summary>
+			void DrawWithCount(const vk::CommandBuffer& commandBuffer) const;
+
+			[[nodiscard]] const Buffer& GetBuffer() const noexcept
+			{
+				return *m_buffer;
+			}
+
+			[[nodiscard]] uint32_t GetDrawCount() const noexcept
+			{
+				return m_drawCount;
+			}
+
+			[[nodiscard]] uint32_t GetCapacity() const noexcept
+			{
+				return m_capacity;
+			}
+
+		private:
+			void Create(uint32_t capacity);
+
+			vk::Device m_logicalDevice = nullptr;
+			Allocator* m_allocator = nullptr;
+			std::unique_ptr<Buffer> m_buffer = nullptr;
+			uint32_t* m_mappedCount = nullptr;
+			vk::DrawIndexedIndirectCommand* m_mappedCommands = nullptr;
+			uint32_t m_drawCount = 0;
+			uint32_t m_capacity = 0;
+		};
+	}
+}
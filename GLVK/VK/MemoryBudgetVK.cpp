@@ -0,0 +1,86 @@
+#include "MemoryBudgetVK.h"
+#include <algorithm>
+
+GLVK::VK::MemoryBudget::MemoryBudget(const vk::PhysicalDevice& physicalDevice, const Allocator& allocator, bool hasBudgetExtension)
+	: m_physicalDevice(physicalDevice), m_allocator(&allocator), m_hasBudgetExtension(hasBudgetExtension)
+{
+	const auto& properties = m_allocator->GetMemoryProperties();
+	m_report.Heaps.resize(properties.memoryHeapCount);
+
+	for (uint32_t i = 0; i < properties.memoryHeapCount; ++i)
+	{
+		m_report.Heaps[i].Size = properties.memoryHeaps[i].size;
+		m_report.Heaps[i].IsDeviceLocal = static_cast<bool>(properties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal);
+	}
+}
+
+const GLVK::VK::MemoryBudgetReport& GLVK::VK::MemoryBudget::Update()
+{
+	m_report.CategoryUsage = m_allocator->GetCategoryUsage();
+	m_report.IsFromDriver = m_hasBudgetExtension;
+
+	if (m_hasBudgetExtension)
+	{
+		auto chain = m_physicalDevice.getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+		const auto& budget = chain.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+
+		for (size_t i = 0; i < m_report.Heaps.size(); ++i)
+		{
+			m_report.Heaps[i].Usage = budget.heapUsage[i];
+			m_report.Heaps[i].Budget = budget.heapBudget[i];
+		}
+	}
+	else
+	{
+		auto heap_usage = m_allocator->GetHeapUsage();
+		for (size_t i = 0; i < m_report.Heaps.size(); ++i)
+		{
+			m_report.Heaps[i].Usage = heap_usage[i];
+			m_report.Heaps[i].Budget = static_cast<vk::DeviceSize>(m_report.Heaps[i].Size * FALLBACK_BUDGET_RATIO);
+		}
+	}
+
+	// Callbacks may add or remove watermarks, so they run on a snapshot of the crossings.
+	auto events = std::vector<std::pair<MemoryWatermarkCallback, MemoryWatermarkEvent>>();
+	for (auto& watermark : m_watermarks)
+	{
+		for (uint32_t i = 0; i < m_report.Heaps.size(); ++i)
+		{
+			auto ratio = m_report.Heaps[i].GetUsageRatio();
+			auto is_above = ratio >= watermark.Ratio;
+			if (is_above == watermark.IsAbove[i]) continue;
+
+			watermark.IsAbove[i] = is_above;
+
+			auto event = MemoryWatermarkEvent();
+			event.HeapIndex = i;
+			event.Watermark = watermark.Ratio;
+			event.UsageRatio = ratio;
+			event.IsRising = is_above;
+			event.Report = &m_report;
+			events.emplace_back(watermark.Callback, event);
+		}
+	}
+
+	for (const auto& [callback, event] : events)
+		callback(event);
+
+	return m_report;
+}
+
+size_t GLVK::VK::MemoryBudget::AddWatermark(float watermark, MemoryWatermarkCallback callback)
+{
+	auto& entry = m_watermarks.emplace_back();
+	entry.Id = m_nextWatermarkId++;
+	entry.Ratio = watermark;
+	entry.Callback = std::move(callback);
+	entry.IsAbove.assign(m_report.Heaps.size(), false);
+	return entry.Id;
+}
+
+void GLVK::VK::MemoryBudget::RemoveWatermark(size_t id)
+{
+	m_watermarks.erase(std::remove_if(m_watermarks.begin(), m_watermarks.end(), [id](const Watermark& watermark) {
+		return watermark.Id == id;
+		}), m_watermarks.end());
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include "AllocatorVK.h"
+
+namespace GLVK
+{
+	namespace VK
+	{
+		struct HeapBudget
+		{
+			vk::DeviceSize Size = 0;
+			vk::DeviceSize Usage = 0;
+			vk::DeviceSize Budget = 0;
+			bool IsDeviceLocal = false;
+
+			[[nodiscard]] float GetUsageRatio() const noexcept
+			{
+				return Budget > 0 ? static_cast<float>(Usage) / static_cast<float>(Budget) : 0.0f;
+			}
+		};
+
+		struct MemoryBudgetReport
+		{
+			std::vector<HeapBudget> Heaps;
+			MemoryCategoryUsage CategoryUsage = {};
+
+			/// <summary>
+			/// True when usage and budget come from VK_EXT_memory_budget, false when they are the allocator's own accounting.
+			/// </summary>
+			bool IsFromDriver = false;
+		};
+
+		struct MemoryWatermarkEvent
+		{
+			uint32_t HeapIndex = 0;
+			float Watermark = 0.0f;
+			float UsageRatio = 0.0f;
+
+			/// <summary>
+			/// True when usage went above the watermark, false when it dropped back below it.
+			/// </summary>
+			bool IsRising = true;
+			const MemoryBudgetReport* Report = nullptr;
+		};
+
+		using MemoryWatermarkCallback = std::function<void(const MemoryWatermarkEvent&)>;
+
+		/// <summary>
+		/// Per-heap usage and budget, refreshed once a frame. Watermarks are fractions of a heap's budget; their callbacks
+		/// fire on the update that crosses them, so residency can be scaled down before an allocation fails.
+		/// </summary>
+		class MemoryBudget
+		{
+		public:
+			/// <summary>
+			/// Without the extension the budget is this share of the heap size, leaving room for other processes and the driver.
+			/// </summary>
+			inline static constexpr float FALLBACK_BUDGET_RATIO = 0.8f;
+
+			MemoryBudget(const vk::PhysicalDevice& physicalDevice, const Allocator& allocator, bool hasBudgetExtension);
+
+			const MemoryBudgetReport& Update();
+			size_t AddWatermark(float watermark, MemoryWatermarkCallback callback);
+			void RemoveWatermark(size_t id);
+
+			[[nodiscard]] const MemoryBudgetReport& GetReport() const noexcept
+			{
+				return m_report;
+			}
+
+			[[nodiscard]] bool HasBudgetExtension() const noexcept
+			{
+				return m_hasBudgetExtension;
+			}
+
+		private:
+			struct Watermark
+			{
+				size_t Id = 0;
+				float Ratio = 0.0f;
+				MemoryWatermarkCallback Callback;
+				std::vector<bool> IsAbove;
+			};
+
+			vk::PhysicalDevice m_physicalDevice = nullptr;
+			const Allocator* m_allocator = nullptr;
+			bool m_hasBudgetExtension = false;
+			size_t m_nextWatermarkId = 1;
+			MemoryBudgetReport m_report = {};
+			std::vector<Watermark> m_watermarks;
+		};
+	}
+}
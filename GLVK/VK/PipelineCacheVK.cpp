@@ -0,0 +1,71 @@
+#include "PipelineCacheVK.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include "../../UtilsCommon.h"
+
+GLVK::VK::PipelineCache::PipelineCache(const vk::Device& device, const vk::PhysicalDeviceProperties& properties, std::string_view filePath)
+	: m_logicalDevice(device), m_properties(properties), m_filePath(filePath)
+{
+	auto file = m_filePath.empty() ? std::vector<char>() : ReadFromFile(m_filePath);
+	m_isWarm = IsCompatible(file);
+
+	auto info = vk::PipelineCacheCreateInfo();
+	info.initialDataSize = m_isWarm ? file.size() - sizeof(FileHeader) : 0;
+	info.pInitialData = m_isWarm ? file.data() + sizeof(FileHeader) : nullptr;
+	m_cache = m_logicalDevice.createPipelineCache(info);
+}
+
+GLVK::VK::PipelineCache::~PipelineCache()
+{
+	m_logicalDevice.destroyPipelineCache(m_cache);
+}
+
+void GLVK::VK::PipelineCache::Save() const
+{
+	if (m_filePath.empty()) return;
+
+	auto data = m_logicalDevice.getPipelineCacheData(m_cache);
+	auto header = MakeHeader(static_cast<uint32_t>(data.size()));
+
+	// Written next to the old file and swapped in, so a crash halfway through never leaves a truncated cache behind.
+	auto temporary_path = m_filePath + ".tmp";
+	auto fs = std::ofstream(temporary_path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+	fs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	fs.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+	fs.close();
+	if (!fs) return;
+
+	std::remove(m_filePath.c_str());
+	std::rename(temporary_path.c_str(), m_filePath.c_str());
+}
+
+GLVK::VK::PipelineCache::FileHeader GLVK::VK::PipelineCache::MakeHeader(uint32_t dataSize) const noexcept
+{
+	auto header = FileHeader();
+	header.DataSize = dataSize;
+	header.VendorId = m_properties.vendorID;
+	header.DeviceId = m_properties.deviceID;
+	header.DriverVersion = m_properties.driverVersion;
+	std::memcpy(header.CacheUuid, m_properties.pipelineCacheUUID.data(), VK_UUID_SIZE);
+	return header;
+}
+
+bool GLVK::VK::PipelineCache::IsCompatible(const std::vector<char>& file) const noexcept
+{
+	if (file.size() < sizeof(FileHeader)) return false;
+
+	// The driver version is not part of the cache's own header, so a driver update would otherwise only be caught by the driver.
+	auto header = FileHeader();
+	std::memcpy(&header, file.data(), sizeof(header));
+	auto expected = MakeHeader(static_cast<uint32_t>(file.size() - sizeof(FileHeader)));
+	if (std::memcmp(&header, &expected, sizeof(header)) != 0) return false;
+
+	// The data itself has to start with a version one header for the same device.
+	auto cache_header = VkPipelineCacheHeaderVersionOne();
+	if (header.DataSize < sizeof(cache_header)) return false;
+	std::memcpy(&cache_header, file.data() + sizeof(FileHeader), sizeof(cache_header));
+	return cache_header.headerSize >= sizeof(cache_header) && cache_header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+		cache_header.vendorID == m_properties.vendorID && cache_header.deviceID == m_properties.deviceID &&
+		std::memcmp(cache_header.pipelineCacheUUID, m_properties.pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+}
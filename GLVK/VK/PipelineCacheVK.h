@@ -0,0 +1,63 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace GLVK
+{
+	namespace VK
+	{
+		/// <summary>
+		/// A pipeline cache seeded from a file at start-up and written back by Save(). The file records the vendor, device, driver
+		/// version and cache UUID it was made with; one from any other device or driver is ignored and the cache starts empty.
+		/// An empty path keeps the cache in memory only.
+		/// </summary>
+		class PipelineCache
+		{
+		public:
+			PipelineCache(const vk::Device& device, const vk::PhysicalDeviceProperties& properties, std::string_view filePath);
+			~PipelineCache();
+
+			PipelineCache(const PipelineCache&) = delete;
+			PipelineCache& operator=(const PipelineCache&) = delete;
+
+			void Save() const;
+
+			[[nodiscard]] const vk::PipelineCache& GetCache() const noexcept
+			{
+				return m_cache;
+			}
+
+			/// <summary>
+			/// Whether the cache was seeded from a valid file, so pipelines created from it should mostly skip compilation.
+			/// </summary>
+			[[nodiscard]] bool IsWarm() const noexcept
+			{
+				return m_isWarm;
+			}
+
+		private:
+			inline static constexpr uint32_t FILE_MAGIC = 0x43504b56; // "VKPC"
+
+			struct FileHeader
+			{
+				uint32_t Magic = FILE_MAGIC;
+				uint32_t DataSize = 0;
+				uint32_t VendorId = 0;
+				uint32_t DeviceId = 0;
+				uint32_t DriverVersion = 0;
+				uint8_t CacheUuid[VK_UUID_SIZE] = {};
+			};
+
+			FileHeader MakeHeader(uint32_t dataSize) const noexcept;
+			bool IsCompatible(const std::vector<char>& file) const noexcept;
+
+			vk::Device m_logicalDevice = nullptr;
+			vk::PhysicalDeviceProperties m_properties = {};
+			vk::PipelineCache m_cache = nullptr;
+			std::string m_filePath;
+			bool m_isWarm = false;
+		};
+	}
+}
@@ -1,22 +1,33 @@
 #include "PipelineVK.h"
-#include <future>
+#include <fstream>
 #include <utility>
 #include <vector>
+#include "ShaderVK.h"
 #include "UtilsVK.h"
 
-GLVK::VK::Pipeline::Pipeline(const vk::Device& device)
-	: m_logicalDevice(device)
+GLVK::VK::Pipeline::Pipeline(const vk::Device& device, bool isBackgroundCompilation)
+	: m_logicalDevice(device), m_isBackgroundCompilation(isBackgroundCompilation)
 {
 }
 
 GLVK::VK::Pipeline::~Pipeline()
 {
+	// Background compiles write into the entries, so every one of them has to finish first.
 	for (auto& pipeline : m_graphicsPipelines)
 	{
-		for (auto& _pipeline : pipeline.second)
-		{
-			m_logicalDevice.destroyPipeline(_pipeline);
-		}
+		if (pipeline.second.Compile.valid())
+			pipeline.second.Compile.wait();
+	}
+
+	for (auto& pipeline : m_graphicsPipelines)
+	{
+		if (pipeline.second.Pipeline)
+			m_logicalDevice.destroyPipeline(pipeline.second.Pipeline);
+	}
+
+	for (auto& pipeline : m_computePipelines)
+	{
+		m_logicalDevice.destroyPipeline(pipeline.second);
 	}
 
 	for (auto& layout : m_pipelineLayouts)
@@ -25,10 +36,14 @@ GLVK::VK::Pipeline::~Pipeline()
 	}
 
 	if (m_ownedRenderPass)
+	{
 		m_logicalDevice.destroyRenderPass(m_renderPass);
+		if (m_resumeRenderPass)
+			m_logicalDevice.destroyRenderPass(m_resumeRenderPass);
+	}
 }
 
-void GLVK::VK::Pipeline::CreateRenderPass(const vk::Format& graphicsFormat, const vk::Format& depthFormat, const vk::SampleCountFlagBits& sampleCount)
+void GLVK::VK::Pipeline::CreateRenderPass(const vk::Format& graphicsFormat, const vk::Format& depthFormat, const vk::SampleCountFlagBits& sampleCount, bool isSplit)
 {
 	vk::AttachmentDescription attachments[3] = {};
 	attachments[0].finalLayout = vk::ImageLayout::eColorAttachmentOptimal;
@@ -38,7 +53,8 @@ void GLVK::VK::Pipeline::CreateRenderPass(const vk::Format& graphicsFormat, cons
 	attachments[0].samples = sampleCount;
 	attachments[0].stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
 	attachments[0].stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-	attachments[0].storeOp = vk::AttachmentStoreOp::eStore;
+	// Resolved into attachment 2 at the end of the subpass; the multisampled contents are never read again.
+	attachments[0].storeOp = vk::AttachmentStoreOp::eDontCare;
 
 	attachments[1].finalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
 	attachments[1].format = depthFormat;
@@ -47,7 +63,7 @@ void GLVK::VK::Pipeline::CreateRenderPass(const vk::Format& graphicsFormat, cons
 	attachments[1].samples = sampleCount;
 	attachments[1].stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
 	attachments[1].stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-	attachments[1].storeOp = vk::AttachmentStoreOp::eStore;
+	attachments[1].storeOp = vk::AttachmentStoreOp::eDontCare;
 
 	attachments[2].finalLayout = vk::ImageLayout::ePresentSrcKHR;
 	attachments[2].format = graphicsFormat;
@@ -96,15 +112,65 @@ void GLVK::VK::Pipeline::CreateRenderPass(const vk::Format& graphicsFormat, cons
 	info.pSubpasses = &subpass_description;
 	info.subpassCount = 1;
 
+	if (!isSplit)
+	{
+		m_renderPass = m_logicalDevice.createRenderPass(info);
+		m_ownedRenderPass = true;
+		return;
+	}
+
+	// Split frames stop after the first part of their draws so compute work can read the depth buffer, then resume in a second pass.
+	// Both passes only differ in load and store operations and layouts, so they are compatible and share framebuffers, pipelines
+	// and secondary command buffers. The first pass keeps the multisampled color and depth; its resolve is overwritten by the second.
+	vk::SubpassDependency dependencies[2] = { subpass_dependency, vk::SubpassDependency() };
+	info.dependencyCount = _countof(dependencies);
+	info.pDependencies = dependencies;
+
+	attachments[0].storeOp = vk::AttachmentStoreOp::eStore;
+	attachments[1].storeOp = vk::AttachmentStoreOp::eStore;
+	attachments[1].finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+	attachments[2].storeOp = vk::AttachmentStoreOp::eDontCare;
+	attachments[2].finalLayout = vk::ImageLayout::eColorAttachmentOptimal;
+
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests;
+	dependencies[1].srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+	dependencies[1].dstStageMask = vk::PipelineStageFlagBits::eComputeShader;
+	dependencies[1].dstAccessMask = vk::AccessFlagBits::eShaderRead;
 	m_renderPass = m_logicalDevice.createRenderPass(info);
+
+	attachments[0].loadOp = vk::AttachmentLoadOp::eLoad;
+	attachments[0].initialLayout = vk::ImageLayout::eColorAttachmentOptimal;
+	attachments[0].storeOp = vk::AttachmentStoreOp::eDontCare;
+	attachments[1].loadOp = vk::AttachmentLoadOp::eLoad;
+	attachments[1].initialLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+	attachments[1].storeOp = vk::AttachmentStoreOp::eDontCare;
+	attachments[1].finalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+	attachments[2].storeOp = vk::AttachmentStoreOp::eStore;
+	attachments[2].finalLayout = vk::ImageLayout::ePresentSrcKHR;
+
+	dependencies[1].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].dstSubpass = 0;
+	dependencies[1].srcStageMask = vk::PipelineStageFlagBits::eComputeShader;
+	dependencies[1].srcAccessMask = {};
+	dependencies[1].dstStageMask = vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests;
+	dependencies[1].dstAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+	m_resumeRenderPass = m_logicalDevice.createRenderPass(info);
 	m_ownedRenderPass = true;
 }
 
-void GLVK::VK::Pipeline::CreateGraphicPipeline(const vk::Device& device, const vk::PipelineColorBlendAttachmentState& colorBlendAttachment, const vk::SampleCountFlagBits& sampleCounts, const std::vector<vk::PipelineShaderStageCreateInfo>& shaderStageInfos, const vk::PipelineLayout& pipelineLayout, const vk::PipelineCache& pipelineCache, size_t blendModeIndex, const vk::RenderPass& renderPass, vk::Pipeline* pPipeline)
+void GLVK::VK::Pipeline::CreateGraphicPipeline(const vk::Device& device, const vk::PipelineColorBlendAttachmentState& colorBlendAttachment, const vk::SampleCountFlagBits& sampleCounts, const std::vector<vk::PipelineShaderStageCreateInfo>& shaderStageInfos, const vk::PipelineLayout& pipelineLayout, const vk::PipelineCache& pipelineCache, size_t blendModeIndex, const vk::RenderPass& renderPass, vk::Pipeline* pPipeline, DepthMode depthMode) const
 {
 	auto vertex_input_info = vk::PipelineVertexInputStateCreateInfo();
 	auto attr_desc = GetVertexInputAttributeDescription(0);
 	auto binding_desc = GetVertexInputBindingDescription(0, vk::VertexInputRate::eVertex);
+	if (depthMode == DepthMode::PrePass)
+	{
+		// The position stream holds nothing but positions, at offset 0 like in Vertex.
+		attr_desc.resize(1);
+		binding_desc.stride = static_cast<uint32_t>(sizeof(Vector3));
+	}
 	vertex_input_info.pVertexAttributeDescriptions = attr_desc.data();
 	vertex_input_info.pVertexBindingDescriptions = &binding_desc;
 	vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attr_desc.size());
@@ -137,9 +203,9 @@ void GLVK::VK::Pipeline::CreateGraphicPipeline(const vk::Device& device, const v
 
 	auto depth_info = vk::PipelineDepthStencilStateCreateInfo();
 	depth_info.depthBoundsTestEnable = VK_FALSE;
-	depth_info.depthCompareOp = vk::CompareOp::eLess;
+	depth_info.depthCompareOp = depthMode == DepthMode::Equal ? vk::CompareOp::eEqual : vk::CompareOp::eLess;
 	depth_info.depthTestEnable = VK_TRUE;
-	depth_info.depthWriteEnable = VK_TRUE;
+	depth_info.depthWriteEnable = depthMode == DepthMode::Equal ? VK_FALSE : VK_TRUE;
 	depth_info.stencilTestEnable = VK_FALSE;
 
 	auto dynamic_states = std::vector<vk::DynamicState>{
@@ -157,7 +223,8 @@ void GLVK::VK::Pipeline::CreateGraphicPipeline(const vk::Device& device, const v
 	msaa_info.minSampleShading = .25f;
 	msaa_info.pSampleMask = nullptr;
 	msaa_info.rasterizationSamples = sampleCounts;
-	msaa_info.sampleShadingEnable = VK_TRUE;
+	// Without a fragment shader there is nothing to run per sample.
+	msaa_info.sampleShadingEnable = depthMode == DepthMode::PrePass ? VK_FALSE : VK_TRUE;
 
 	auto pipeline_info = vk::GraphicsPipelineCreateInfo();
 	pipeline_info.basePipelineHandle = nullptr;
@@ -186,22 +253,155 @@ void GLVK::VK::Pipeline::CreateGraphicPipeline(const vk::Device& device, const v
 	}
 }
 
-void GLVK::VK::Pipeline::CreateGraphicPipelines(const vk::DescriptorSetLayout& descriptorSetLayout, const vk::SampleCountFlagBits& sampleCounts, const std::vector<vk::PipelineShaderStageCreateInfo>& shaderStageInfos, const vk::PipelineCache& pipelineCache, const ShaderType& shaderType)
+const vk::PipelineLayout& GLVK::VK::Pipeline::CreateGraphicsLayout(const vk::DescriptorSetLayout& descriptorSetLayout, const ShaderType& shaderType)
 {
-	static constexpr auto BLEND_MODE_COUNT = static_cast<size_t>(BlendMode::End);
-	vk::PipelineColorBlendAttachmentState blend_modes[BLEND_MODE_COUNT] = {};
-
 	auto push_constant_range = vk::PushConstantRange();
 	push_constant_range.offset = 0;
 	push_constant_range.size = static_cast<uint32_t>(sizeof(PushConstant));
 	push_constant_range.stageFlags = vk::ShaderStageFlagBits::eFragment;
 
+	// Every graphics layout has the same sets and push constants, so sets and push constants stay bound across pipeline changes.
+	auto set_layouts = std::vector<vk::DescriptorSetLayout>{ descriptorSetLayout };
+	if (m_textureSetLayout) set_layouts.emplace_back(m_textureSetLayout);
+
 	auto layout_info = vk::PipelineLayoutCreateInfo();
 	layout_info.pPushConstantRanges = &push_constant_range;
-	layout_info.pSetLayouts = &descriptorSetLayout;
+	layout_info.pSetLayouts = set_layouts.data();
 	layout_info.pushConstantRangeCount = 1;
-	layout_info.setLayoutCount = 1;
-	m_pipelineLayouts.emplace(std::make_pair(shaderType, m_logicalDevice.createPipelineLayout(layout_info)));
+	layout_info.setLayoutCount = static_cast<uint32_t>(set_layouts.size());
+	return m_pipelineLayouts.emplace(std::make_pair(shaderType, m_logicalDevice.createPipelineLayout(layout_info))).first->second;
+}
+
+void GLVK::VK::Pipeline::CreateGraphicPipelines(const vk::DescriptorSetLayout& descriptorSetLayout, const vk::SampleCountFlagBits& sampleCounts, const std::vector<vk::PipelineShaderStageCreateInfo>& shaderStageInfos, const vk::PipelineCache& pipelineCache, const ShaderType& shaderType, bool hasDepthPrePass, ShaderFeatures defaultFeatures)
+{
+	CreateGraphicsLayout(descriptorSetLayout, shaderType);
+
+	auto recipe = GraphicsRecipe();
+	recipe.ShaderStageInfos = shaderStageInfos;
+	recipe.SampleCounts = sampleCounts;
+	recipe.PipelineCache = pipelineCache;
+	recipe.HasDepthPrePass = hasDepthPrePass;
+	recipe.DefaultFeatures = defaultFeatures;
+	AddRecipe(shaderType, recipe);
+}
+
+void GLVK::VK::Pipeline::CreateDepthPrePassPipeline(const vk::DescriptorSetLayout& descriptorSetLayout, const vk::SampleCountFlagBits& sampleCounts, const std::vector<vk::PipelineShaderStageCreateInfo>& shaderStageInfos, const vk::PipelineCache& pipelineCache)
+{
+	CreateGraphicsLayout(descriptorSetLayout, ShaderType::DepthPrePass);
+
+	auto recipe = GraphicsRecipe();
+	recipe.ShaderStageInfos = shaderStageInfos;
+	recipe.SampleCounts = sampleCounts;
+	recipe.PipelineCache = pipelineCache;
+	recipe.IsDepthPrePass = true;
+	AddRecipe(ShaderType::DepthPrePass, recipe);
+}
+
+void GLVK::VK::Pipeline::AddRecipe(const ShaderType& shaderType, const GraphicsRecipe& recipe)
+{
+	auto lock = std::unique_lock<std::mutex>{ m_mutex };
+	if (!m_recipes.emplace(std::make_pair(shaderType, recipe)).second)
+	{
+		::ThrowIfFailed("Failed to insert into pipeline map.");
+	}
+
+	// Only the unblended variant is built up front: it is what most draws use and what the others stand in with while they compile.
+	auto& entry = m_graphicsPipelines[MakeKey(BlendMode::None, shaderType, recipe.DefaultFeatures)];
+	lock.unlock();
+	CompileGraphicPipeline(BlendMode::None, shaderType, recipe.DefaultFeatures, &entry.Pipeline);
+}
+
+vk::Pipeline GLVK::VK::Pipeline::GetPipeline(const BlendMode& blendMode, const ShaderType& shaderType) const
+{
+	return GetPipeline(blendMode, shaderType, GetDefaultFeatures(shaderType));
+}
+
+ShaderFeatures GLVK::VK::Pipeline::GetDefaultFeatures(const ShaderType& shaderType) const
+{
+	auto lock = std::lock_guard<std::mutex>{ m_mutex };
+	return m_recipes.at(shaderType).DefaultFeatures;
+}
+
+vk::Pipeline GLVK::VK::Pipeline::GetPipeline(const BlendMode& blendMode, const ShaderType& shaderType, ShaderFeatures features) const
+{
+	auto key = MakeKey(blendMode, shaderType, features);
+	auto lock = std::unique_lock<std::mutex>{ m_mutex };
+	m_usedKeys.emplace(key);
+
+	auto iter = m_graphicsPipelines.find(key);
+	if (iter != m_graphicsPipelines.cend())
+	{
+		if (iter->second.Pipeline) return iter->second.Pipeline;
+		return GetFallback(shaderType);
+	}
+
+	if (m_isBackgroundCompilation)
+	{
+		StartCompile(key);
+		return GetFallback(shaderType);
+	}
+
+	// Compiled without the lock so other recording threads are not held up; if two threads miss on the same key, the second one's copy is dropped.
+	lock.unlock();
+	auto pipeline = vk::Pipeline();
+	CompileGraphicPipeline(blendMode, shaderType, features, &pipeline);
+
+	lock.lock();
+	auto& entry = m_graphicsPipelines[key];
+	if (entry.Pipeline)
+	{
+		m_logicalDevice.destroyPipeline(pipeline);
+		return entry.Pipeline;
+	}
+	entry.Pipeline = pipeline;
+	return pipeline;
+}
+
+void GLVK::VK::Pipeline::Prewarm(std::string_view filePath)
+{
+	auto fs = std::ifstream(filePath.data());
+	auto lock = std::lock_guard<std::mutex>{ m_mutex };
+	uint32_t shader_type = 0;
+	uint32_t blend_mode = 0;
+	ShaderFeatures features = 0;
+	while (fs >> shader_type >> blend_mode >> features)
+	{
+		// Keys of shader types this run did not set up, or from a build with different enums, are skipped.
+		if (blend_mode >= static_cast<uint32_t>(BlendMode::End) || features >= ToFeatureBit(ShaderFeature::End)
+			|| !m_recipes.contains(static_cast<ShaderType>(shader_type))) continue;
+
+		auto key = MakeKey(static_cast<BlendMode>(blend_mode), static_cast<ShaderType>(shader_type), features);
+		if (!m_graphicsPipelines.contains(key)) StartCompile(key);
+	}
+}
+
+void GLVK::VK::Pipeline::SaveUsedKeys(std::string_view filePath) const
+{
+	auto lock = std::lock_guard<std::mutex>{ m_mutex };
+	auto fs = std::ofstream(filePath.data(), std::ios_base::out | std::ios_base::trunc);
+	for (auto key : m_usedKeys)
+		fs << static_cast<uint32_t>(GetShaderType(key)) << ' ' << (key & 0xff) << ' ' << (key >> 16) << '\n';
+}
+
+vk::Pipeline GLVK::VK::Pipeline::GetFallback(const ShaderType& shaderType) const
+{
+	// Called with m_mutex held. The default unblended pipeline is built when the recipe is added, so it is always there.
+	return m_graphicsPipelines.at(MakeKey(BlendMode::None, shaderType, m_recipes.at(shaderType).DefaultFeatures)).Pipeline;
+}
+
+void GLVK::VK::Pipeline::StartCompile(uint32_t key) const
+{
+	// Called with m_mutex held. The entry exists from here on, so later lookups fall back instead of starting another compile.
+	auto& entry = m_graphicsPipelines[key];
+	entry.Compile = std::async(std::launch::async, [this, key, pipeline = &entry.Pipeline]() {
+		CompileGraphicPipeline(static_cast<BlendMode>(key & 0xff), GetShaderType(key), key >> 16, pipeline);
+		++m_generation;
+		});
+}
+
+void GLVK::VK::Pipeline::CompileGraphicPipeline(const BlendMode& blendMode, const ShaderType& shaderType, ShaderFeatures features, vk::Pipeline* pPipeline) const
+{
+	static constexpr auto BLEND_MODE_COUNT = static_cast<size_t>(BlendMode::End);
 
 	vk::BlendOp alpha_blend_op[BLEND_MODE_COUNT] = {
 		vk::BlendOp::eAdd, vk::BlendOp::eAdd, vk::BlendOp::eAdd,
@@ -257,34 +457,109 @@ void GLVK::VK::Pipeline::CreateGraphicPipelines(const vk::DescriptorSetLayout& d
 		vk::BlendFactor::eOne, vk::BlendFactor::eOne, vk::BlendFactor::eSrcAlpha
 	};
 
-	auto iter = m_graphicsPipelines.emplace(std::make_pair(shaderType, std::vector<vk::Pipeline>()));
+	auto i = static_cast<size_t>(blendMode);
+	auto color_attachment = vk::PipelineColorBlendAttachmentState();
+	color_attachment.alphaBlendOp = alpha_blend_op[i];
+	color_attachment.blendEnable = blend_enable[i];
+	color_attachment.colorBlendOp = color_blend_op[i];
+	color_attachment.colorWriteMask = color_write_masks[i];
+	color_attachment.dstAlphaBlendFactor = dst_alpha_blend_factor[i];
+	color_attachment.dstColorBlendFactor = dst_color_blend_factor[i];
+	color_attachment.srcAlphaBlendFactor = src_alpha_blend_factor[i];
+	color_attachment.srcColorBlendFactor = src_color_blend_factor[i];
+
+	// Recipes are never removed, so the reference outlives the lock.
+	auto lock = std::unique_lock<std::mutex>{ m_mutex };
+	const auto& recipe = m_recipes.at(shaderType);
+	lock.unlock();
+
+	// Only unblended draws go through the pre-pass; blended ones still test against its depth but were never drawn into it.
+	auto depth_mode = recipe.HasDepthPrePass && blendMode == BlendMode::None ? DepthMode::Equal : DepthMode::Write;
+	if (recipe.IsDepthPrePass)
+	{
+		// The subpass still has its color attachment, so the pipeline needs a blend state for it that writes nothing.
+		color_attachment = vk::PipelineColorBlendAttachmentState();
+		color_attachment.blendEnable = VK_FALSE;
+		color_attachment.colorWriteMask = {};
+		depth_mode = DepthMode::PrePass;
+	}
+
+	// Only read while the pipeline is created, so it can live on this stack even when compiling in the background.
+	auto specialization = FeatureSpecialization(features);
+	auto shader_stage_infos = recipe.ShaderStageInfos;
+	for (auto& info : shader_stage_infos)
+		info.pSpecializationInfo = &specialization.GetInfo();
+
+	CreateGraphicPipeline(m_logicalDevice, color_attachment, recipe.SampleCounts, shader_stage_infos, m_pipelineLayouts.at(shaderType), recipe.PipelineCache, i, m_renderPass, pPipeline, depth_mode);
+}
+
+void GLVK::VK::Pipeline::CreateComputePipeline(const vk::DescriptorSetLayout& descriptorSetLayout, const vk::PipelineShaderStageCreateInfo& shaderStageInfo, uint32_t pushConstantSize, const vk::PipelineCache& pipelineCache, const ShaderType& shaderType)
+{
+	auto push_constant_range = vk::PushConstantRange();
+	push_constant_range.offset = 0;
+	push_constant_range.size = pushConstantSize;
+	push_constant_range.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+	auto layout_info = vk::PipelineLayoutCreateInfo();
+	layout_info.pPushConstantRanges = pushConstantSize > 0 ? &push_constant_range : nullptr;
+	layout_info.pSetLayouts = &descriptorSetLayout;
+	layout_info.pushConstantRangeCount = pushConstantSize > 0 ? 1 : 0;
+	layout_info.setLayoutCount = 1;
+	auto layout = m_logicalDevice.createPipelineLayout(layout_info);
+	m_pipelineLayouts.emplace(std::make_pair(shaderType, layout));
+
+	auto iter = m_computePipelines.emplace(std::make_pair(shaderType, BuildComputePipeline(layout, shaderStageInfo, pipelineCache)));
 	if (!iter.second)
 	{
 		::ThrowIfFailed("Failed to insert into pipeline map.");
 	}
-	auto& pipeline_array = iter.first->second;
-	pipeline_array.resize(BLEND_MODE_COUNT);
-	std::future<void> worker_threads[BLEND_MODE_COUNT];
+}
 
-	for (size_t i = 0; i < BLEND_MODE_COUNT; ++i)
+void GLVK::VK::Pipeline::ReloadGraphicPipelines(const ShaderType& shaderType, const std::vector<vk::PipelineShaderStageCreateInfo>& shaderStageInfos)
+{
+	// Background compiles of this shader type still read its recipe and the old shader modules, so they have to finish first.
+	// Nothing records while reloading, so the map itself does not change under this loop.
+	for (auto& pipeline : m_graphicsPipelines)
 	{
-		auto color_attachment = vk::PipelineColorBlendAttachmentState();
-		color_attachment.alphaBlendOp = alpha_blend_op[i];
-		color_attachment.blendEnable = blend_enable[i];
-		color_attachment.colorBlendOp = color_blend_op[i];
-		color_attachment.colorWriteMask = color_write_masks[i];
-		color_attachment.dstAlphaBlendFactor = dst_alpha_blend_factor[i];
-		color_attachment.dstColorBlendFactor = dst_color_blend_factor[i];
-		color_attachment.srcAlphaBlendFactor = src_alpha_blend_factor[i];
-		color_attachment.srcColorBlendFactor = src_color_blend_factor[i];
-
-		worker_threads[i] = std::async(std::launch::async, &Pipeline::CreateGraphicPipeline, this, m_logicalDevice, color_attachment, sampleCounts, shaderStageInfos, m_pipelineLayouts.at(shaderType), pipelineCache, i, m_renderPass, &pipeline_array[i]);
+		if (GetShaderType(pipeline.first) == shaderType && pipeline.second.Compile.valid())
+			pipeline.second.Compile.wait();
 	}
 
-	for (auto& thread : worker_threads)
-		thread.wait();
+	auto lock = std::unique_lock<std::mutex>{ m_mutex };
+	std::erase_if(m_graphicsPipelines, [this, &shaderType](const auto& pipeline) {
+		if (GetShaderType(pipeline.first) != shaderType) return false;
+		if (pipeline.second.Pipeline)
+			m_logicalDevice.destroyPipeline(pipeline.second.Pipeline);
+		return true;
+		});
+
+	auto& recipe = m_recipes.at(shaderType);
+	recipe.ShaderStageInfos = shaderStageInfos;
+	auto features = recipe.DefaultFeatures;
+	auto& entry = m_graphicsPipelines[MakeKey(BlendMode::None, shaderType, features)];
+	lock.unlock();
+	CompileGraphicPipeline(BlendMode::None, shaderType, features, &entry.Pipeline);
+	++m_generation;
 }
 
-void GLVK::VK::Pipeline::CreateComputePipeline()
+void GLVK::VK::Pipeline::ReloadComputePipeline(const ShaderType& shaderType, const vk::PipelineShaderStageCreateInfo& shaderStageInfo, const vk::PipelineCache& pipelineCache)
 {
+	auto& pipeline = m_computePipelines.at(shaderType);
+	auto new_pipeline = BuildComputePipeline(m_pipelineLayouts.at(shaderType), shaderStageInfo, pipelineCache);
+	m_logicalDevice.destroyPipeline(pipeline);
+	pipeline = new_pipeline;
+	++m_generation;
+}
+
+vk::Pipeline GLVK::VK::Pipeline::BuildComputePipeline(const vk::PipelineLayout& pipelineLayout, const vk::PipelineShaderStageCreateInfo& shaderStageInfo, const vk::PipelineCache& pipelineCache) const
+{
+	auto pipeline_info = vk::ComputePipelineCreateInfo();
+	pipeline_info.basePipelineHandle = nullptr;
+	pipeline_info.basePipelineIndex = -1;
+	pipeline_info.layout = pipelineLayout;
+	pipeline_info.stage = shaderStageInfo;
+
+	auto pipeline = m_logicalDevice.createComputePipeline(pipelineCache, pipeline_info);
+	ThrowIfFailed(pipeline.result, "Failed to create compute pipeline.\n");
+	return pipeline.value;
 }
@@ -1,6 +1,10 @@
 #pragma once
+#include <atomic>
+#include <future>
 #include <mutex>
+#include <string_view>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <vulkan/vulkan.hpp>
 #include "../../UtilsCommon.h"
@@ -9,26 +13,101 @@ namespace GLVK
 {
 	namespace VK
 	{
+		/// <summary>
+		/// Write is the usual less-than test with depth writes. PrePass only writes depth and reads nothing but tightly packed positions,
+		/// and Equal draws on top of a finished pre-pass without writing depth again.
+		/// </summary>
+		enum class DepthMode
+		{
+			Write, PrePass, Equal
+		};
+
 		class Pipeline
 		{
 		public:
-			explicit Pipeline(const vk::Device& device);
+			/// <summary>
+			/// With isBackgroundCompilation a pipeline that is not built yet is compiled on its own thread, and GetPipeline() hands out
+			/// the shader type's unblended pipeline until it is ready. Otherwise the first GetPipeline() call builds it on the spot.
+			/// </summary>
+			explicit Pipeline(const vk::Device& device, bool isBackgroundCompilation = false);
 			~Pipeline();
 
-            void CreateGraphicPipeline(const vk::Device& device, const vk::PipelineColorBlendAttachmentState& colorBlendAttachment, const vk::SampleCountFlagBits& sampleCounts, const std::vector<vk::PipelineShaderStageCreateInfo>& shaderStageInfos, const vk::PipelineLayout& pipelineLayout, const vk::PipelineCache& pipelineCache, size_t blendModeIndex, const vk::RenderPass& renderPass, vk::Pipeline* pipeline);
-			void CreateRenderPass(const vk::Format& graphicsFormat, const vk::Format& depthFormat, const vk::SampleCountFlagBits& sampleCount);
-			void CreateGraphicPipelines(const vk::DescriptorSetLayout& descriptorSetLayout, const vk::SampleCountFlagBits& sampleCounts, const std::vector<vk::PipelineShaderStageCreateInfo>& shaderStageInfos, const vk::PipelineCache& pipelineCache = nullptr, const ShaderType& shaderType = ShaderType::BasicShader);
-			void CreateComputePipeline();
+            void CreateGraphicPipeline(const vk::Device& device, const vk::PipelineColorBlendAttachmentState& colorBlendAttachment, const vk::SampleCountFlagBits& sampleCounts, const std::vector<vk::PipelineShaderStageCreateInfo>& shaderStageInfos, const vk::PipelineLayout& pipelineLayout, const vk::PipelineCache& pipelineCache, size_t blendModeIndex, const vk::RenderPass& renderPass, vk::Pipeline* pipeline, DepthMode depthMode = DepthMode::Write) const;
+			/// <summary>
+			/// With isSplit the frame is drawn in two render pass instances: GetRenderPass() clears and keeps the attachments,
+			/// leaving depth readable by compute shaders, and GetResumeRenderPass() continues on top of them and presents.
+			/// </summary>
+			void CreateRenderPass(const vk::Format& graphicsFormat, const vk::Format& depthFormat, const vk::SampleCountFlagBits& sampleCount, bool isSplit = false);
+			/// <summary>
+			/// Appended as set 1 to the layouts of the graphics pipelines created afterwards.
+			/// </summary>
+			void SetTextureSetLayout(const vk::DescriptorSetLayout& descriptorSetLayout) noexcept
+			{
+				m_textureSetLayout = descriptorSetLayout;
+			}
+
+			/// <summary>
+			/// Sets up the layout and remembers how to build the shader type's pipelines. Only BlendMode::None with the default features
+			/// is built right away; other blend modes and feature permutations are built the first time they are asked for. With
+			/// hasDepthPrePass the unblended pipeline expects its depth to be laid down already and tests it for equality.
+			/// </summary>
+			void CreateGraphicPipelines(const vk::DescriptorSetLayout& descriptorSetLayout, const vk::SampleCountFlagBits& sampleCounts, const std::vector<vk::PipelineShaderStageCreateInfo>& shaderStageInfos, const vk::PipelineCache& pipelineCache = nullptr, const ShaderType& shaderType = ShaderType::BasicShader, bool hasDepthPrePass = false, ShaderFeatures defaultFeatures = 0);
+
+			/// <summary>
+			/// A single depth-only pipeline in the same subpass as the graphics pipelines, stored as BlendMode::None of ShaderType::DepthPrePass.
+			/// Its layout matches theirs, so the bound descriptor set survives switching between the two.
+			/// </summary>
+			void CreateDepthPrePassPipeline(const vk::DescriptorSetLayout& descriptorSetLayout, const vk::SampleCountFlagBits& sampleCounts, const std::vector<vk::PipelineShaderStageCreateInfo>& shaderStageInfos, const vk::PipelineCache& pipelineCache = nullptr);
+			void CreateComputePipeline(const vk::DescriptorSetLayout& descriptorSetLayout, const vk::PipelineShaderStageCreateInfo& shaderStageInfo, uint32_t pushConstantSize, const vk::PipelineCache& pipelineCache = nullptr, const ShaderType& shaderType = ShaderType::FrustumCull);
+
+			/// <summary>
+			/// Swap in new shaders for a shader type, such as after its sources were recompiled. Every pipeline built for it is destroyed,
+			/// so the device has to be idle and nothing may be recording. The default unblended one is rebuilt right away, the rest on demand.
+			/// </summary>
+			void ReloadGraphicPipelines(const ShaderType& shaderType, const std::vector<vk::PipelineShaderStageCreateInfo>& shaderStageInfos);
+			void ReloadComputePipeline(const ShaderType& shaderType, const vk::PipelineShaderStageCreateInfo& shaderStageInfo, const vk::PipelineCache& pipelineCache = nullptr);
 
 			[[nodiscard]] const vk::RenderPass& GetRenderPass() const noexcept
 			{
 				return m_renderPass;
 			}
 
-			[[nodiscard]] const vk::Pipeline& GetPipeline(const BlendMode& blendMode, const ShaderType& shaderType) const noexcept
-            {
-				return m_graphicsPipelines.at(shaderType)[size_t(blendMode)];
-            }
+			[[nodiscard]] const vk::RenderPass& GetResumeRenderPass() const noexcept
+			{
+				return m_resumeRenderPass;
+			}
+
+			/// <summary>
+			/// Safe to call from several recording threads at once. Every key asked for is remembered for SaveUsedKeys().
+			/// </summary>
+			[[nodiscard]] vk::Pipeline GetPipeline(const BlendMode& blendMode, const ShaderType& shaderType) const;
+
+			/// <summary>
+			/// The shader type's pipeline specialized for features instead of its default ones. Until a permutation is built in the
+			/// background, the default unblended pipeline stands in for it.
+			/// </summary>
+			[[nodiscard]] vk::Pipeline GetPipeline(const BlendMode& blendMode, const ShaderType& shaderType, ShaderFeatures features) const;
+			[[nodiscard]] ShaderFeatures GetDefaultFeatures(const ShaderType& shaderType) const;
+
+			/// <summary>
+			/// Start compiling every pipeline listed in a file written by SaveUsedKeys() in the background. Call it once all pipelines are set up.
+			/// </summary>
+			void Prewarm(std::string_view filePath);
+			void SaveUsedKeys(std::string_view filePath) const;
+
+			/// <summary>
+			/// Goes up whenever a background compile finishes or pipelines are reloaded, so command buffers recorded with a stand-in or
+			/// destroyed pipeline know to record again.
+			/// </summary>
+			[[nodiscard]] uint32_t GetGeneration() const noexcept
+			{
+				return m_generation;
+			}
+
+			[[nodiscard]] const vk::Pipeline& GetComputePipeline(const ShaderType& shaderType) const noexcept
+			{
+				return m_computePipelines.at(shaderType);
+			}
 
 			[[nodiscard]] const vk::PipelineLayout& GetPipelineLayout(const ShaderType& shaderType) const noexcept
             {
@@ -36,13 +115,61 @@ namespace GLVK
             }
 
 		private:
+			/// <summary>
+			/// Everything needed to build any blend mode and feature permutation of a shader type later.
+			/// </summary>
+			struct GraphicsRecipe
+			{
+				std::vector<vk::PipelineShaderStageCreateInfo> ShaderStageInfos;
+				vk::SampleCountFlagBits SampleCounts = vk::SampleCountFlagBits::e1;
+				vk::PipelineCache PipelineCache = nullptr;
+				ShaderFeatures DefaultFeatures = 0;
+				bool HasDepthPrePass = false;
+				bool IsDepthPrePass = false;
+			};
+
+			/// <summary>
+			/// Pipeline stays null while Compile is still running.
+			/// </summary>
+			struct GraphicsEntry
+			{
+				vk::Pipeline Pipeline = nullptr;
+				std::future<void> Compile;
+			};
+
+			/// <summary>
+			/// From the least significant bit: blend mode 8, shader type 8, features 16.
+			/// </summary>
+			[[nodiscard]] static uint32_t MakeKey(const BlendMode& blendMode, const ShaderType& shaderType, ShaderFeatures features) noexcept
+			{
+				return (features << 16) | (static_cast<uint32_t>(shaderType) << 8) | static_cast<uint32_t>(blendMode);
+			}
+
+			[[nodiscard]] static ShaderType GetShaderType(uint32_t key) noexcept
+			{
+				return static_cast<ShaderType>((key >> 8) & 0xff);
+			}
+
+			const vk::PipelineLayout& CreateGraphicsLayout(const vk::DescriptorSetLayout& descriptorSetLayout, const ShaderType& shaderType);
+			void AddRecipe(const ShaderType& shaderType, const GraphicsRecipe& recipe);
+			[[nodiscard]] vk::Pipeline GetFallback(const ShaderType& shaderType) const;
+			void StartCompile(uint32_t key) const;
+			void CompileGraphicPipeline(const BlendMode& blendMode, const ShaderType& shaderType, ShaderFeatures features, vk::Pipeline* pPipeline) const;
+			[[nodiscard]] vk::Pipeline BuildComputePipeline(const vk::PipelineLayout& pipelineLayout, const vk::PipelineShaderStageCreateInfo& shaderStageInfo, const vk::PipelineCache& pipelineCache) const;
+
 			inline static std::mutex m_mutex = std::mutex();
 
 			vk::RenderPass m_renderPass = nullptr;
+			vk::RenderPass m_resumeRenderPass = nullptr;
+			vk::DescriptorSetLayout m_textureSetLayout = nullptr;
 			std::unordered_map<ShaderType, vk::PipelineLayout> m_pipelineLayouts;
-			//std::vector<vk::Pipeline> m_graphicsPipelines;
-			std::unordered_map<ShaderType, std::vector<vk::Pipeline>> m_graphicsPipelines;
+			std::unordered_map<ShaderType, GraphicsRecipe> m_recipes;
+			mutable std::unordered_map<uint32_t, GraphicsEntry> m_graphicsPipelines;
+			mutable std::unordered_set<uint32_t> m_usedKeys;
+			mutable std::atomic<uint32_t> m_generation = 0;
+			std::unordered_map<ShaderType, vk::Pipeline> m_computePipelines;
 			vk::Device m_logicalDevice = nullptr;
+			bool m_isBackgroundCompilation = false;
 			bool m_ownedRenderPass = false;
 		};
 	}
@@ -0,0 +1,71 @@
+#include "RenderQueueVK.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <utility>
+
+uint64_t GLVK::VK::SortKey::Encode(DrawPass pass, ShaderType pipeline, BlendMode blendMode, uint32_t material, uint32_t geometry, float depth) noexcept
+{
+	static_assert(PASS_BITS + PIPELINE_BITS + BLEND_MODE_BITS + MATERIAL_BITS + GEOMETRY_BITS + DEPTH_BITS == 64);
+
+	// The bits of a non-negative float grow with its value, and without the sign bit its top 24 bits keep the exponent
+	// and most of the mantissa, so depth needs no far plane to be quantized against.
+	auto depth_bits = std::bit_cast<uint32_t>(std::max(depth, 0.0f)) >> (31 - DEPTH_BITS);
+	if (pass == DrawPass::Transparent) depth_bits = ((1u << DEPTH_BITS) - 1) - depth_bits;
+
+	auto key = static_cast<uint64_t>(pass) & ((1u << PASS_BITS) - 1);
+	key = (key << PIPELINE_BITS) | (static_cast<uint64_t>(pipeline) & ((1u << PIPELINE_BITS) - 1));
+	key = (key << BLEND_MODE_BITS) | (static_cast<uint64_t>(blendMode) & ((1u << BLEND_MODE_BITS) - 1));
+	key = (key << MATERIAL_BITS) | (material & ((1u << MATERIAL_BITS) - 1));
+	key = (key << GEOMETRY_BITS) | (geometry & (GEOMETRY_LIMIT - 1));
+	key = (key << DEPTH_BITS) | depth_bits;
+	return key;
+}
+
+void GLVK::VK::RenderQueue::Clear() noexcept
+{
+	m_items.clear();
+}
+
+void GLVK::VK::RenderQueue::Push(uint64_t key, uint32_t instance)
+{
+	m_items.emplace_back(RenderItem{ key, instance });
+}
+
+void GLVK::VK::RenderQueue::Compact(const std::vector<uint32_t>& positions)
+{
+	for (size_t i = 0; i < positions.size(); ++i)
+		m_items[i] = m_items[positions[i]];
+	m_items.resize(positions.size());
+}
+
+void GLVK::VK::RenderQueue::Sort()
+{
+	static constexpr size_t DIGIT_COUNT = sizeof(uint64_t);
+	static constexpr size_t BUCKET_COUNT = 256;
+
+	// One pass over the keys fills the histograms of all eight bytes.
+	auto histograms = std::array<std::array<uint32_t, BUCKET_COUNT>, DIGIT_COUNT>();
+	for (const auto& item : m_items)
+	{
+		for (size_t digit = 0; digit < DIGIT_COUNT; ++digit)
+			++histograms[digit][(item.Key >> (digit * 8)) & 0xff];
+	}
+
+	m_scratch.resize(m_items.size());
+	for (size_t digit = 0; digit < DIGIT_COUNT; ++digit)
+	{
+		// A byte that every key shares would only copy the items over unchanged.
+		auto& histogram = histograms[digit];
+		if (std::any_of(histogram.cbegin(), histogram.cend(), [this](uint32_t count) { return count == m_items.size(); })) continue;
+
+		uint32_t offset = 0;
+		for (auto& count : histogram)
+			offset += std::exchange(count, offset);
+
+		for (const auto& item : m_items)
+			m_scratch[histogram[(item.Key >> (digit * 8)) & 0xff]++] = item;
+
+		std::swap(m_items, m_scratch);
+	}
+}
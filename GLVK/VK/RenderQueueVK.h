@@ -0,0 +1,128 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "../../UtilsCommon.h"
+
+namespace GLVK
+{
+	namespace VK
+	{
+		enum class DrawPass : uint32_t
+		{
+			Opaque, Transparent
+		};
+
+		/// <summary>
+		/// Packs the state a draw needs into 64 bits, so sorting the keys orders draws by pass, then pipeline, blend mode and material,
+		/// then geometry, and finally depth. From the most significant bit: pass 2, pipeline 4, blend mode 4, material 10, geometry 20, depth 24.
+		/// Opaque draws are ordered front to back and transparent ones back to front.
+		/// </summary>
+		struct SortKey
+		{
+			inline static constexpr uint32_t DEPTH_BITS = 24;
+			inline static constexpr uint32_t GEOMETRY_BITS = 20;
+			inline static constexpr uint32_t MATERIAL_BITS = 10;
+			inline static constexpr uint32_t BLEND_MODE_BITS = 4;
+			inline static constexpr uint32_t PIPELINE_BITS = 4;
+			inline static constexpr uint32_t PASS_BITS = 2;
+			inline static constexpr uint32_t GEOMETRY_LIMIT = 1u << GEOMETRY_BITS;
+			inline static constexpr uint32_t MATERIAL_LIMIT = 1u << MATERIAL_BITS;
+
+			/// <summary>
+			/// The material only orders draws, so ids above the field's range just share a slot. The geometry has to be below GEOMETRY_LIMIT.
+			/// </summary>
+			static uint64_t Encode(DrawPass pass, ShaderType pipeline, BlendMode blendMode, uint32_t material, uint32_t geometry, float depth) noexcept;
+
+			/// <summary>
+			/// Pass, pipeline, blend mode and material: everything a command buffer has to bind before drawing.
+			/// </summary>
+			[[nodiscard]] static uint32_t GetState(uint64_t key) noexcept
+			{
+				return static_cast<uint32_t>(key >> (GEOMETRY_BITS + DEPTH_BITS));
+			}
+
+			[[nodiscard]] static uint32_t GetGeometry(uint64_t key) noexcept
+			{
+				return static_cast<uint32_t>(key >> DEPTH_BITS) & (GEOMETRY_LIMIT - 1);
+			}
+
+			[[nodiscard]] static ShaderType GetPipeline(uint64_t key) noexcept
+			{
+				return static_cast<ShaderType>((key >> (BLEND_MODE_BITS + MATERIAL_BITS + GEOMETRY_BITS + DEPTH_BITS)) & ((1u << PIPELINE_BITS) - 1));
+			}
+
+			[[nodiscard]] static uint32_t GetMaterial(uint64_t key) noexcept
+			{
+				return static_cast<uint32_t>(key >> (GEOMETRY_BITS + DEPTH_BITS)) & (MATERIAL_LIMIT - 1);
+			}
+
+			[[nodiscard]] static BlendMode GetBlendMode(uint64_t key) noexcept
+			{
+				return static_cast<BlendMode>((key >> (MATERIAL_BITS + GEOMETRY_BITS + DEPTH_BITS)) & ((1u << BLEND_MODE_BITS) - 1));
+			}
+
+			/// <summary>
+			/// The same key drawn with another pipeline, such as the depth pre-pass drawing what a batch draws.
+			/// </summary>
+			[[nodiscard]] static uint64_t SetPipeline(uint64_t key, ShaderType pipeline) noexcept
+			{
+				constexpr auto SHIFT = BLEND_MODE_BITS + MATERIAL_BITS + GEOMETRY_BITS + DEPTH_BITS;
+				constexpr auto MASK = static_cast<uint64_t>((1u << PIPELINE_BITS) - 1) << SHIFT;
+				return (key & ~MASK) | ((static_cast<uint64_t>(pipeline) << SHIFT) & MASK);
+			}
+		};
+
+		struct BindStatistics
+		{
+			/// <summary>
+			/// Pipeline and descriptor set binds the same draw list costs when every mesh and model binds its own, as Mesh::Render and Model::Render do.
+			/// </summary>
+			uint32_t UnsortedBindCount = 0;
+
+			/// <summary>
+			/// Binds recorded by the last EndDraw() and binds it left out because the state was already bound. Frames that replay
+			/// previously recorded command buffers record none.
+			/// </summary>
+			uint32_t RecordedBindCount = 0;
+			uint32_t SkippedBindCount = 0;
+		};
+
+		struct RenderItem
+		{
+			uint64_t Key = 0;
+			uint32_t Instance = 0;
+		};
+
+		/// <summary>
+		/// A frame's draws as sort key and instance pairs. Sort() is a stable least significant digit radix sort, which is linear in the
+		/// number of draws and skips every byte that is the same in all keys.
+		/// </summary>
+		class RenderQueue
+		{
+		public:
+			void Clear() noexcept;
+			void Push(uint64_t key, uint32_t instance);
+
+			/// <summary>
+			/// Keep only the items at the given positions, which must be ascending.
+			/// </summary>
+			void Compact(const std::vector<uint32_t>& positions);
+			void Sort();
+
+			[[nodiscard]] size_t GetCount() const noexcept
+			{
+				return m_items.size();
+			}
+
+			[[nodiscard]] const RenderItem& operator[](size_t index) const noexcept
+			{
+				return m_items[index];
+			}
+
+		private:
+			std::vector<RenderItem> m_items;
+			std::vector<RenderItem> m_scratch;
+		};
+	}
+}
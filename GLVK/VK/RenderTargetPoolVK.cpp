@@ -0,0 +1,131 @@
+#include "RenderTargetPoolVK.h"
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+GLVK::VK::RenderTargetPool::RenderTargetPool(const vk::Device& device, Allocator& allocator)
+	: m_logicalDevice(device), m_allocator(&allocator)
+{
+}
+
+GLVK::VK::RenderTargetPool::~RenderTargetPool()
+{
+	Clear();
+}
+
+size_t GLVK::VK::RenderTargetPool::Add(const RenderTargetDesc& desc)
+{
+	auto& target = m_targets.emplace_back();
+	target.Desc = desc;
+	return m_targets.size() - 1;
+}
+
+void GLVK::VK::RenderTargetPool::Build()
+{
+	// Memory is shared out once for the whole set of targets; registering more means clearing and building again.
+	assert(m_memories.empty());
+
+	for (auto& target : m_targets)
+	{
+		const auto& desc = target.Desc;
+		target.Target = std::make_unique<Image>(m_logicalDevice, desc.Format, desc.Samples, desc.Extent, vk::ImageType::e2D, 1, desc.Usage);
+		target.Requirements = m_logicalDevice.getImageMemoryRequirements(target.Target->GetImage());
+		target.IsLazy = (desc.Usage & vk::ImageUsageFlagBits::eTransientAttachment) && SupportsLazyAllocation(target.Requirements.memoryTypeBits);
+	}
+
+	// Largest first, so smaller targets fit into memory that is already sized for a bigger one.
+	auto order = std::vector<size_t>(m_targets.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+		return m_targets[lhs].Requirements.size > m_targets[rhs].Requirements.size;
+		});
+
+	for (auto index : order)
+	{
+		const auto& target = m_targets[index];
+		auto iter = std::find_if(m_memories.begin(), m_memories.end(), [&](const SharedMemory& memory) {
+			return CanShare(memory, target);
+			});
+
+		if (iter == m_memories.end())
+		{
+			auto& memory = m_memories.emplace_back();
+			memory.Requirements = target.Requirements;
+			memory.IsLazy = target.IsLazy;
+			memory.Targets.emplace_back(index);
+			continue;
+		}
+
+		iter->Requirements.size = std::max(iter->Requirements.size, target.Requirements.size);
+		iter->Requirements.alignment = std::max(iter->Requirements.alignment, target.Requirements.alignment);
+		iter->Requirements.memoryTypeBits &= target.Requirements.memoryTypeBits;
+		iter->Targets.emplace_back(index);
+	}
+
+	for (auto& memory : m_memories)
+	{
+		auto properties = memory.IsLazy ? vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eLazilyAllocated : vk::MemoryPropertyFlags(vk::MemoryPropertyFlagBits::eDeviceLocal);
+		memory.Memory = m_allocator->Allocate(memory.Requirements, properties, AllocationPool::FreeList, true, MemoryCategory::RenderTargets);
+
+		for (auto index : memory.Targets)
+		{
+			auto& target = m_targets[index];
+			target.Target->BindMemory(memory.Memory);
+			target.Target->CreateImageView(target.Desc.Format, target.Desc.Aspect, 1, vk::ImageViewType::e2D);
+		}
+	}
+}
+
+void GLVK::VK::RenderTargetPool::Clear()
+{
+	for (auto& target : m_targets)
+		target.Target.reset();
+
+	for (auto& memory : m_memories)
+		m_allocator->Free(memory.Memory);
+
+	m_targets.clear();
+	m_memories.clear();
+}
+
+GLVK::VK::RenderTargetPoolStatistics GLVK::VK::RenderTargetPool::GetStatistics() const noexcept
+{
+	auto statistics = RenderTargetPoolStatistics();
+	statistics.TargetCount = m_targets.size();
+	statistics.MemoryCount = m_memories.size();
+
+	for (const auto& target : m_targets)
+		statistics.BytesRequired += target.Requirements.size;
+
+	for (const auto& memory : m_memories)
+	{
+		statistics.BytesAllocated += memory.Requirements.size;
+		if (memory.IsLazy) ++statistics.LazilyAllocatedCount;
+	}
+
+	return statistics;
+}
+
+bool GLVK::VK::RenderTargetPool::SupportsLazyAllocation(uint32_t memoryTypeBits) const noexcept
+{
+	const auto& properties = m_allocator->GetMemoryProperties();
+	for (uint32_t i = 0; i < properties.memoryTypeCount; ++i)
+	{
+		if ((memoryTypeBits & (1 << i)) && (properties.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eLazilyAllocated))
+			return true;
+	}
+
+	return false;
+}
+
+bool GLVK::VK::RenderTargetPool::CanShare(const SharedMemory& memory, const RenderTarget& target) const noexcept
+{
+	if (memory.IsLazy != target.IsLazy) return false;
+	if (!(memory.Requirements.memoryTypeBits & target.Requirements.memoryTypeBits)) return false;
+
+	// Aliased targets must never be live at the same time; each one starts from an undefined layout when its first pass begins.
+	return std::none_of(memory.Targets.cbegin(), memory.Targets.cend(), [&](size_t index) {
+		const auto& other = m_targets[index].Desc;
+		return target.Desc.FirstPass <= other.LastPass && other.FirstPass <= target.Desc.LastPass;
+		});
+}
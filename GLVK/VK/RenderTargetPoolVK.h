@@ -0,0 +1,87 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include "AllocatorVK.h"
+#include "ImageVK.h"
+
+namespace GLVK
+{
+	namespace VK
+	{
+		struct RenderTargetDesc
+		{
+			vk::Format Format = vk::Format::eUndefined;
+			vk::Extent2D Extent = {};
+			vk::SampleCountFlagBits Samples = vk::SampleCountFlagBits::e1;
+			vk::ImageUsageFlags Usage = {};
+			vk::ImageAspectFlags Aspect = {};
+
+			/// <summary>
+			/// First and last pass of the frame that touch the target. Targets whose pass ranges do not overlap may share memory.
+			/// </summary>
+			uint32_t FirstPass = 0;
+			uint32_t LastPass = 0;
+		};
+
+		struct RenderTargetPoolStatistics
+		{
+			size_t TargetCount = 0;
+			size_t MemoryCount = 0;
+			size_t LazilyAllocatedCount = 0;
+			vk::DeviceSize BytesRequired = 0;
+			vk::DeviceSize BytesAllocated = 0;
+		};
+
+		/// <summary>
+		/// Owns the frame's attachments. Targets are registered up front and created together by Build(), so targets
+		/// with disjoint lifetimes can be aliased onto one allocation, and transient attachments can be placed in lazily
+		/// allocated memory, which tile-based GPUs never have to back with real memory.
+		/// </summary>
+		class RenderTargetPool
+		{
+		public:
+			RenderTargetPool(const vk::Device& device, Allocator& allocator);
+			~RenderTargetPool();
+
+			RenderTargetPool(const RenderTargetPool&) = delete;
+			RenderTargetPool& operator=(const RenderTargetPool&) = delete;
+
+			size_t Add(const RenderTargetDesc& desc);
+			void Build();
+			void Clear();
+
+			[[nodiscard]] Image& Get(size_t target) noexcept
+			{
+				return *m_targets[target].Target;
+			}
+
+			[[nodiscard]] RenderTargetPoolStatistics GetStatistics() const noexcept;
+
+		private:
+			struct RenderTarget
+			{
+				RenderTargetDesc Desc = {};
+				std::unique_ptr<Image> Target = nullptr;
+				vk::MemoryRequirements Requirements = {};
+				bool IsLazy = false;
+			};
+
+			struct SharedMemory
+			{
+				std::vector<size_t> Targets;
+				vk::MemoryRequirements Requirements = {};
+				bool IsLazy = false;
+				Allocation Memory = {};
+			};
+
+			bool SupportsLazyAllocation(uint32_t memoryTypeBits) const noexcept;
+			bool CanShare(const SharedMemory& memory, const RenderTarget& target) const noexcept;
+
+			vk::Device m_logicalDevice = nullptr;
+			Allocator* m_allocator = nullptr;
+			std::vector<RenderTarget> m_targets;
+			std::vector<SharedMemory> m_memories;
+		};
+	}
+}
@@ -0,0 +1,159 @@
+#include "ShaderCompilerVK.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <system_error>
+#include "../../UtilsCommon.h"
+#ifdef GLVK_SHADERC
+#include <shaderc/shaderc.hpp>
+#endif
+
+GLVK::VK::ShaderCompiler::ShaderCompiler(std::string_view cacheDirectory)
+	: m_cacheDirectory(cacheDirectory)
+{
+	auto error = std::error_code();
+	std::filesystem::create_directories(m_cacheDirectory, error);
+}
+
+std::vector<uint32_t> GLVK::VK::ShaderCompiler::Compile(std::string_view sourcePath, const vk::ShaderStageFlagBits& shaderStage, const std::vector<std::string>& defines)
+{
+	auto source = ReadFromFile(sourcePath);
+	if (source.empty())
+	{
+		::ThrowIfFailed("Failed to read shader source " + std::string(sourcePath) + ".");
+	}
+
+	// Everything that changes the output goes into the key, so a stale entry can never be picked up.
+	auto key = std::string();
+	key += std::to_string(CACHE_VERSION) + ' ' + std::to_string(static_cast<uint32_t>(shaderStage));
+	for (const auto& define : defines)
+		key += ' ' + define;
+	key += '\n';
+	auto hash = Hash(source, Hash(std::vector<char>(key.cbegin(), key.cend())));
+
+	auto name = std::ostringstream();
+	name << std::hex << std::setw(16) << std::setfill('0') << hash << ".spv";
+	auto cache_path = (m_cacheDirectory / name.str()).string();
+
+	auto cached = ReadFromFile(cache_path);
+	if (!cached.empty() && cached.size() % sizeof(uint32_t) == 0)
+	{
+		auto code = std::vector<uint32_t>(cached.size() / sizeof(uint32_t));
+		std::memcpy(code.data(), cached.data(), cached.size());
+		return code;
+	}
+
+	auto code = CompileSource(source, sourcePath, shaderStage, defines);
+
+	// Written next to the final name and swapped in, so a crash halfway through never leaves a truncated module behind.
+	auto temporary_path = cache_path + ".tmp";
+	auto fs = std::ofstream(temporary_path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+	fs.write(reinterpret_cast<const char*>(code.data()), static_cast<std::streamsize>(code.size() * sizeof(uint32_t)));
+	fs.close();
+	if (fs)
+	{
+		std::remove(cache_path.c_str());
+		std::rename(temporary_path.c_str(), cache_path.c_str());
+	}
+
+	return code;
+}
+
+void GLVK::VK::ShaderCompiler::Watch(std::string_view sourcePath)
+{
+	auto error = std::error_code();
+	auto file = WatchedFile();
+	file.LastWriteTime = std::filesystem::last_write_time(sourcePath, error);
+	file.Hash = Hash(ReadFromFile(sourcePath));
+	m_watchedFiles.insert_or_assign(std::string(sourcePath), file);
+}
+
+std::vector<std::string> GLVK::VK::ShaderCompiler::PollChanges(std::chrono::milliseconds interval)
+{
+	auto changed = std::vector<std::string>();
+	auto now = std::chrono::steady_clock::now();
+	if (now - m_lastPoll < interval) return changed;
+	m_lastPoll = now;
+
+	for (auto& [path, file] : m_watchedFiles)
+	{
+		// Editors often write a file in several steps; a source that cannot be read right now is looked at again next time.
+		auto error = std::error_code();
+		auto last_write_time = std::filesystem::last_write_time(path, error);
+		if (error || last_write_time == file.LastWriteTime) continue;
+
+		auto source = ReadFromFile(path);
+		if (source.empty()) continue;
+
+		file.LastWriteTime = last_write_time;
+		auto hash = Hash(source);
+		if (hash == file.Hash) continue;
+
+		file.Hash = hash;
+		changed.emplace_back(path);
+	}
+
+	return changed;
+}
+
+bool GLVK::VK::ShaderCompiler::IsSupported() noexcept
+{
+#ifdef GLVK_SHADERC
+	return true;
+#else
+	return false;
+#endif
+}
+
+uint64_t GLVK::VK::ShaderCompiler::Hash(const std::vector<char>& data, uint64_t seed) noexcept
+{
+	// 64-bit FNV-1a.
+	auto hash = seed;
+	for (auto c : data)
+	{
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+std::vector<uint32_t> GLVK::VK::ShaderCompiler::CompileSource(const std::vector<char>& source, std::string_view sourcePath, const vk::ShaderStageFlagBits& shaderStage, const std::vector<std::string>& defines)
+{
+#ifdef GLVK_SHADERC
+	auto kind = shaderc_glsl_vertex_shader;
+	switch (shaderStage)
+	{
+	case vk::ShaderStageFlagBits::eVertex:
+		kind = shaderc_glsl_vertex_shader;
+		break;
+	case vk::ShaderStageFlagBits::eFragment:
+		kind = shaderc_glsl_fragment_shader;
+		break;
+	case vk::ShaderStageFlagBits::eCompute:
+		kind = shaderc_glsl_compute_shader;
+		break;
+	default:
+		::ThrowIfFailed("Unsupported shader stage.");
+	}
+
+	auto options = shaderc::CompileOptions();
+	options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
+	options.SetOptimizationLevel(shaderc_optimization_level_performance);
+	for (const auto& define : defines)
+		options.AddMacroDefinition(define);
+
+	auto compiler = shaderc::Compiler();
+	auto result = compiler.CompileGlslToSpv(source.data(), source.size(), kind, std::string(sourcePath).c_str(), options);
+	if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+	{
+		::ThrowIfFailed("Failed to compile " + std::string(sourcePath) + ":\n" + result.GetErrorMessage());
+	}
+
+	return std::vector<uint32_t>(result.cbegin(), result.cend());
+#else
+	::ThrowIfFailed("Failed to compile " + std::string(sourcePath) + ": built without GLVK_SHADERC.");
+	return {};
+#endif
+}
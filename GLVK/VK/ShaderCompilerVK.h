@@ -0,0 +1,62 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace GLVK
+{
+	namespace VK
+	{
+		/// <summary>
+		/// Compiles GLSL sources to SPIR-V with shaderc. Results are kept in cacheDirectory under a hash of the source, stage and macros,
+		/// so unchanged shaders are read back instead of compiled. Only available when built with GLVK_SHADERC.
+		/// </summary>
+		class ShaderCompiler
+		{
+		public:
+			explicit ShaderCompiler(std::string_view cacheDirectory);
+
+			ShaderCompiler(const ShaderCompiler&) = delete;
+			ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+
+			/// <summary>
+			/// Throws with the compiler's messages when the source does not compile.
+			/// </summary>
+			[[nodiscard]] std::vector<uint32_t> Compile(std::string_view sourcePath, const vk::ShaderStageFlagBits& shaderStage, const std::vector<std::string>& defines = {});
+
+			/// <summary>
+			/// Remember the source's contents, so PollChanges() reports it once they change.
+			/// </summary>
+			void Watch(std::string_view sourcePath);
+
+			/// <summary>
+			/// Watched sources whose contents changed since they were last reported. Only touching a file does not count, and the files
+			/// are looked at no more often than every interval.
+			/// </summary>
+			[[nodiscard]] std::vector<std::string> PollChanges(std::chrono::milliseconds interval = std::chrono::milliseconds(500));
+
+			[[nodiscard]] static bool IsSupported() noexcept;
+
+		private:
+			inline static constexpr uint32_t CACHE_VERSION = 1;
+
+			struct WatchedFile
+			{
+				std::filesystem::file_time_type LastWriteTime = {};
+				uint64_t Hash = 0;
+			};
+
+			[[nodiscard]] static uint64_t Hash(const std::vector<char>& data, uint64_t seed = 14695981039346656037ull) noexcept;
+			[[nodiscard]] static std::vector<uint32_t> CompileSource(const std::vector<char>& source, std::string_view sourcePath, const vk::ShaderStageFlagBits& shaderStage, const std::vector<std::string>& defines);
+
+			std::filesystem::path m_cacheDirectory;
+			std::unordered_map<std::string, WatchedFile> m_watchedFiles;
+			std::chrono::steady_clock::time_point m_lastPoll = {};
+		};
+	}
+}
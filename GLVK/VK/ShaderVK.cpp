@@ -1,4 +1,5 @@
 #include "ShaderVK.h"
+#include <string>
 #include <string_view>
 #include "../../UtilsCommon.h"
 
@@ -6,10 +7,27 @@ GLVK::VK::Shader::Shader(const vk::ShaderStageFlagBits& shaderStage, std::string
 	: m_logicalDevice(device)
 {
 	auto data = ReadFromFile(fileName);
+	if (data.empty()) ::ThrowIfFailed("Failed to read " + std::string(fileName) + ". Build the shaders with compile_shader.py or the CMake build, or enable RuntimeShaderCompilation.\n");
+	CreateModule(shaderStage, reinterpret_cast<const uint32_t*>(data.data()), data.size());
+}
+
+GLVK::VK::Shader::Shader(const vk::ShaderStageFlagBits& shaderStage, const std::vector<uint32_t>& code, const vk::Device& device)
+	: m_logicalDevice(device)
+{
+	CreateModule(shaderStage, code.data(), code.size() * sizeof(uint32_t));
+}
+
+GLVK::VK::Shader::~Shader()
+{
+	m_logicalDevice.destroyShaderModule(m_shader);
+}
+
+void GLVK::VK::Shader::CreateModule(const vk::ShaderStageFlagBits& shaderStage, const uint32_t* pCode, size_t codeSize)
+{
 	auto info = vk::ShaderModuleCreateInfo();
-	info.codeSize = data.size();
-	info.pCode = reinterpret_cast<const uint32_t*>(data.data());
-	m_shader = device.createShaderModule(info);
+	info.codeSize = codeSize;
+	info.pCode = pCode;
+	m_shader = m_logicalDevice.createShaderModule(info);
 
 	m_shaderStageInfo = vk::PipelineShaderStageCreateInfo();
 	m_shaderStageInfo.module = m_shader;
@@ -18,7 +36,18 @@ GLVK::VK::Shader::Shader(const vk::ShaderStageFlagBits& shaderStage, std::string
 	m_shaderStageInfo.stage = shaderStage;
 }
 
-GLVK::VK::Shader::~Shader()
+GLVK::VK::FeatureSpecialization::FeatureSpecialization(ShaderFeatures features) noexcept
 {
-	m_logicalDevice.destroyShaderModule(m_shader);
+	for (size_t i = 0; i < FEATURE_COUNT; ++i)
+	{
+		m_entries[i].constantID = static_cast<uint32_t>(i);
+		m_entries[i].offset = static_cast<uint32_t>(i * sizeof(vk::Bool32));
+		m_entries[i].size = sizeof(vk::Bool32);
+		m_values[i] = (features & ToFeatureBit(static_cast<ShaderFeature>(i))) ? VK_TRUE : VK_FALSE;
+	}
+
+	m_info.dataSize = sizeof(m_values);
+	m_info.mapEntryCount = static_cast<uint32_t>(m_entries.size());
+	m_info.pData = m_values.data();
+	m_info.pMapEntries = m_entries.data();
 }
\ No newline at end of file
@@ -1,5 +1,9 @@
 #pragma once
+#include <array>
+#include <string_view>
+#include <vector>
 #include <vulkan/vulkan.hpp>
+#include "../../UtilsCommon.h"
 
 namespace GLVK
 {
@@ -9,6 +13,7 @@ namespace GLVK
 		{
 		public:
 			Shader(const vk::ShaderStageFlagBits& shaderStage, std::string_view fileName, const vk::Device& device);
+			Shader(const vk::ShaderStageFlagBits& shaderStage, const std::vector<uint32_t>& code, const vk::Device& device);
 			virtual ~Shader();
 
 			const vk::PipelineShaderStageCreateInfo& GetShaderStageInfo() const noexcept
@@ -19,8 +24,34 @@ namespace GLVK
 		private:
 			vk::ShaderModule m_shader = nullptr;
 			vk::PipelineShaderStageCreateInfo m_shaderStageInfo = {};
+			void CreateModule(const vk::ShaderStageFlagBits& shaderStage, const uint32_t* pCode, size_t codeSize);
+
 			vk::Device m_logicalDevice = nullptr;
 		};
+
+		/// <summary>
+		/// One VkBool32 specialization constant per ShaderFeature, set from a feature mask. Constants a shader does not declare are ignored,
+		/// so the same info can go to every stage. It points into itself and cannot be copied.
+		/// </summary>
+		class FeatureSpecialization
+		{
+		public:
+			explicit FeatureSpecialization(ShaderFeatures features) noexcept;
+			FeatureSpecialization(const FeatureSpecialization&) = delete;
+			FeatureSpecialization& operator=(const FeatureSpecialization&) = delete;
+
+			[[nodiscard]] const vk::SpecializationInfo& GetInfo() const noexcept
+			{
+				return m_info;
+			}
+
+		private:
+			inline static constexpr auto FEATURE_COUNT = static_cast<size_t>(ShaderFeature::End);
+
+			std::array<vk::SpecializationMapEntry, FEATURE_COUNT> m_entries = {};
+			std::array<vk::Bool32, FEATURE_COUNT> m_values = {};
+			vk::SpecializationInfo m_info = {};
+		};
 	}
 }
 
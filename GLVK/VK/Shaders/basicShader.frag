@@ -1,8 +1,16 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Set per pipeline; constant_id is the ShaderFeature index.
+layout (constant_id = 0) const bool TEXTURED = false;
+layout (constant_id = 1) const bool LIT = false;
+layout (constant_id = 3) const bool ALPHA_TEST = false;
+layout (constant_id = 4) const bool INSTANCED = false;
 
 layout (location = 1) in vec4 inNormal;
 layout (location = 2) in vec2 inTexCoord;
 layout (location = 3) in vec4 fragPos;
+layout (location = 4) in vec4 inColor;
 
 layout (location = 0) out vec4 fragColor;
 
@@ -20,25 +28,37 @@ layout (binding = 1) uniform DirectionalLight
     float specular_intensity;
 } direction_light;
 
-//layout (binding = 2) uniform sampler2D TexSampler[80];
+// The bindless texture table; pco.texture_index is a slot in it.
+layout (set = 1, binding = 0) uniform sampler2D textures[];
 
 void main()
 {
+    vec4 color = INSTANCED ? inColor : pco.object_color;
+
     // Texture
-    /*vec4 tex_color = texture(TexSampler[pco.texture_index], inTexCoord);
-    if (tex_color.a < 0.1) {
+    if (TEXTURED)
+    {
+        color *= texture(textures[pco.texture_index], inTexCoord);
+    }
+
+    if (ALPHA_TEST && color.a < 0.1)
+    {
         discard;
-    }*/
+    }
+
+    if (LIT)
+    {
+        // Ambient
+        vec4 ambient = direction_light.diffuse * direction_light.ambient_intensity;
 
-    // Ambient
-    //vec4 ambient = direction_light.diffuse * direction_light.ambient_intensity;
+        // Diffuse Light
+        vec4 light_direction = normalize(vec4(-direction_light.light_direction, 0.0));
+        vec4 normal = normalize(inNormal);
+        float intensity = max(dot(normal, light_direction), 0.0);
+        vec4 diffuse = direction_light.diffuse * intensity;
 
-    // Diffuse Light
-    /*vec4 light_direction = normalize(vec4(-direction_light.light_direction, 0.0));
-    vec4 normal = normalize(inNormal);
-    float intensity = max(dot(normal, light_direction), 0.0);
-    vec4 diffuse = direction_light.diffuse * intensity;
+        color.rgb *= (ambient + diffuse).rgb;
+    }
 
-    vec4 result = (ambient + diffuse) * vec4(1.0, 0.0, 0.0, 1.0);*/
-    fragColor = pco.object_color;
+    fragColor = color;
 }
\ No newline at end of file
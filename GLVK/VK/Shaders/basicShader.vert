@@ -1,5 +1,9 @@
 #version 450
 
+// Set per pipeline; constant_id is the ShaderFeature index.
+layout (constant_id = 4) const bool INSTANCED = false;
+layout (constant_id = 5) const bool MESH_TRANSFORM = false;
+
 layout (binding = 0) uniform ModelViewProjection
 {
     mat4 model;
@@ -17,6 +21,17 @@ layout (binding = 3) uniform DynamicBufferObject_2
     mat4 model;
 } dbo_2;
 
+struct InstanceData
+{
+    mat4 world;
+    vec4 color;
+};
+
+layout (std430, binding = 4) readonly buffer Instances
+{
+    InstanceData instances[];
+};
+
 layout (location = 0) in vec3 inPosition;
 layout (location = 1) in vec3 inNormal;
 layout (location = 2) in vec2 inTexCoord;
@@ -24,14 +39,32 @@ layout (location = 2) in vec2 inTexCoord;
 layout (location = 1) out vec4 outNormal;
 layout (location = 2) out vec2 outTexCoord;
 layout (location = 3) out vec4 fragPos;
+layout (location = 4) out vec4 outColor;
+
+// Has to match depthPrePass.vert bit for bit, since the main pass tests against its depth with an equal compare.
+invariant gl_Position;
 
 void main()
 {
+    mat4 world;
+    outColor = vec4(1.0);
+    if (INSTANCED)
+    {
+        // gl_InstanceIndex already includes the draw's firstInstance, which is where its batch starts in the buffer.
+        InstanceData instance = instances[gl_InstanceIndex];
+        world = instance.world;
+        outColor = instance.color;
+    }
+    else
+    {
+        world = MESH_TRANSFORM ? dbo_2.model : dbo.model;
+    }
+
     vec4 position = vec4(inPosition, 1.0);
-    gl_Position = mvp.projection * mvp.view * dbo.model * position;
-    
+    gl_Position = mvp.projection * mvp.view * world * position;
+
     outNormal = vec4(inNormal, 0.0);
-    outNormal = transpose(inverse(dbo.model)) * outNormal;
+    outNormal = transpose(inverse(world)) * outNormal;
     outTexCoord = inTexCoord;
-    fragPos = dbo.model * vec4(inPosition.xyz, 1.0);
+    fragPos = world * vec4(inPosition.xyz, 1.0);
 }
\ No newline at end of file
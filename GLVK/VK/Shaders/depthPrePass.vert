@@ -0,0 +1,31 @@
+#version 450
+
+layout (binding = 0) uniform ModelViewProjection
+{
+    mat4 model;
+    mat4 view;
+    mat4 projection;
+} mvp;
+
+struct InstanceData
+{
+    mat4 world;
+    vec4 color;
+};
+
+layout (std430, binding = 4) readonly buffer Instances
+{
+    InstanceData instances[];
+};
+
+layout (location = 0) in vec3 inPosition;
+
+// The main pass tests against this depth with an equal compare, so both shaders have to compute bit-identical positions.
+invariant gl_Position;
+
+void main()
+{
+    InstanceData instance = instances[gl_InstanceIndex];
+    vec4 position = vec4(inPosition, 1.0);
+    gl_Position = mvp.projection * mvp.view * instance.world * position;
+}
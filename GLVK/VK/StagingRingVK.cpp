@@ -0,0 +1,177 @@
+#include "StagingRingVK.h"
+#include <algorithm>
+#include <limits>
+#include "UtilsVK.h"
+
+GLVK::VK::StagingRing::StagingRing(const vk::Device& device, Allocator& allocator, vk::DeviceSize size)
+	: m_logicalDevice(device), m_size(size)
+{
+	m_buffer = std::make_unique<Buffer>(m_logicalDevice, vk::BufferUsageFlagBits::eTransferSrc, size);
+	m_buffer->AllocateMemory(allocator, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, AllocationPool::FreeList, MemoryCategory::Staging);
+	m_mappedData = reinterpret_cast<uint8_t*>(m_buffer->Map(size));
+}
+
+GLVK::VK::StagingRing::~StagingRing()
+{
+	for (auto& submission : m_inFlight)
+	{
+		m_logicalDevice.waitForFences(submission.Fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+		m_logicalDevice.destroyFence(submission.Fence);
+	}
+
+	for (auto& fence : m_freeFences)
+		m_logicalDevice.destroyFence(fence);
+
+	m_buffer->UnMap();
+	m_buffer.reset();
+}
+
+std::optional<GLVK::VK::StagingRegion> GLVK::VK::StagingRing::Allocate(vk::DeviceSize size, vk::DeviceSize alignment)
+{
+	if (size > m_size) return std::nullopt;
+
+	auto lock = std::lock_guard<std::mutex>{ m_mutex };
+	RecycleUnlocked();
+
+	auto offset = TryAllocate(size, alignment);
+
+	// Out of space: wait for the oldest submission to retire its regions. Regions that were never retired
+	// cannot be waited on, so once nothing is in flight the caller has to fall back to its own staging buffer.
+	while (!offset.has_value() && !m_inFlight.empty())
+	{
+		m_logicalDevice.waitForFences(m_inFlight.front().Fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+		RecycleUnlocked();
+		offset = TryAllocate(size, alignment);
+	}
+
+	if (!offset.has_value()) return std::nullopt;
+
+	auto region = StagingRegion();
+	region.Source = m_buffer.get();
+	region.Offset = offset.value();
+	region.Size = size;
+	region.MappedData = m_mappedData + offset.value();
+	return region;
+}
+
+vk::Fence GLVK::VK::StagingRing::Retire()
+{
+	auto lock = std::lock_guard<std::mutex>{ m_mutex };
+
+	auto fence = vk::Fence();
+	if (!m_freeFences.empty())
+	{
+		fence = m_freeFences.back();
+		m_freeFences.pop_back();
+	}
+	else
+	{
+		fence = m_logicalDevice.createFence(vk::FenceCreateInfo());
+	}
+
+	auto submission = InFlightSubmission();
+	submission.Submission = m_nextSubmission++;
+	submission.Fence = fence;
+	submission.End = m_head;
+	submission.Bytes = m_pendingBytes;
+	m_inFlight.emplace_back(submission);
+	m_pendingBytes = 0;
+
+	return fence;
+}
+
+void GLVK::VK::StagingRing::Recycle()
+{
+	auto lock = std::lock_guard<std::mutex>{ m_mutex };
+	RecycleUnlocked();
+}
+
+bool GLVK::VK::StagingRing::IsCompleted(uint64_t submission)
+{
+	auto lock = std::lock_guard<std::mutex>{ m_mutex };
+	if (submission >= m_nextSubmission) return false;
+
+	auto iter = std::find_if(m_inFlight.cbegin(), m_inFlight.cend(), [&](const InFlightSubmission& in_flight) {
+		return in_flight.Submission == submission;
+		});
+
+	return iter == m_inFlight.cend() || m_logicalDevice.getFenceStatus(iter->Fence) == vk::Result::eSuccess;
+}
+
+void GLVK::VK::StagingRing::Wait(uint64_t submission)
+{
+	auto lock = std::lock_guard<std::mutex>{ m_mutex };
+
+	auto iter = std::find_if(m_inFlight.cbegin(), m_inFlight.cend(), [&](const InFlightSubmission& in_flight) {
+		return in_flight.Submission == submission;
+		});
+
+	if (iter == m_inFlight.cend()) return;
+
+	m_logicalDevice.waitForFences(iter->Fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+	RecycleUnlocked();
+}
+
+std::optional<vk::DeviceSize> GLVK::VK::StagingRing::TryAllocate(vk::DeviceSize size, vk::DeviceSize alignment)
+{
+	if (m_usedBytes == 0)
+	{
+		m_head = 0;
+		m_tail = 0;
+	}
+	else if (m_head == m_tail)
+	{
+		return std::nullopt;
+	}
+
+	auto aligned_offset = AlignUp(m_head, alignment);
+
+	if (m_head >= m_tail)
+	{
+		if (aligned_offset + size <= m_size)
+		{
+			m_usedBytes += aligned_offset + size - m_head;
+			m_pendingBytes += aligned_offset + size - m_head;
+			m_head = aligned_offset + size;
+			return aligned_offset;
+		}
+
+		// Wrap around; the unused tail end of the ring is accounted to this region so it is reclaimed together with it.
+		if (size <= m_tail)
+		{
+			auto consumed = (m_size - m_head) + size;
+			m_usedBytes += consumed;
+			m_pendingBytes += consumed;
+			m_head = size;
+			return 0;
+		}
+
+		return std::nullopt;
+	}
+
+	if (aligned_offset + size <= m_tail)
+	{
+		m_usedBytes += aligned_offset + size - m_head;
+		m_pendingBytes += aligned_offset + size - m_head;
+		m_head = aligned_offset + size;
+		return aligned_offset;
+	}
+
+	return std::nullopt;
+}
+
+void GLVK::VK::StagingRing::RecycleUnlocked()
+{
+	while (!m_inFlight.empty())
+	{
+		auto& oldest = m_inFlight.front();
+		if (m_logicalDevice.getFenceStatus(oldest.Fence) != vk::Result::eSuccess)
+			break;
+
+		m_tail = oldest.End;
+		m_usedBytes -= oldest.Bytes;
+		m_logicalDevice.resetFences(oldest.Fence);
+		m_freeFences.emplace_back(oldest.Fence);
+		m_inFlight.pop_front();
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include "AllocatorVK.h"
+#include "BufferVK.h"
+
+namespace GLVK
+{
+	namespace VK
+	{
+		struct StagingRegion
+		{
+			Buffer* Source = nullptr;
+			vk::DeviceSize Offset = 0;
+			vk::DeviceSize Size = 0;
+			void* MappedData = nullptr;
+		};
+
+		/// <summary>
+		/// A persistently mapped host visible buffer that uploads carve staging space from.
+		/// Regions handed out since the last Retire() are guarded by the fence Retire() returns and become reusable once it signals.
+		/// </summary>
+		class StagingRing
+		{
+		public:
+			StagingRing(const vk::Device& device, Allocator& allocator, vk::DeviceSize size);
+			~StagingRing();
+
+			StagingRing(const StagingRing&) = delete;
+			StagingRing& operator=(const StagingRing&) = delete;
+
+			std::optional<StagingRegion> Allocate(vk::DeviceSize size, vk::DeviceSize alignment = 16);
+			vk::Fence Retire();
+			void Recycle();
+			bool IsCompleted(uint64_t submission);
+			void Wait(uint64_t submission);
+
+			[[nodiscard]] uint64_t GetLastSubmission() const noexcept
+			{
+				return m_nextSubmission - 1;
+			}
+
+			[[nodiscard]] vk::DeviceSize GetSize() const noexcept
+			{
+				return m_size;
+			}
+
+		private:
+			struct InFlightSubmission
+			{
+				uint64_t Submission;
+				vk::Fence Fence;
+				vk::DeviceSize End;
+				vk::DeviceSize Bytes;
+			};
+
+			std::optional<vk::DeviceSize> TryAllocate(vk::DeviceSize size, vk::DeviceSize alignment);
+			void RecycleUnlocked();
+
+			std::mutex m_mutex;
+			vk::Device m_logicalDevice = nullptr;
+			std::unique_ptr<Buffer> m_buffer = nullptr;
+			uint8_t* m_mappedData = nullptr;
+			vk::DeviceSize m_size = 0;
+			vk::DeviceSize m_head = 0;
+			vk::DeviceSize m_tail = 0;
+			vk::DeviceSize m_usedBytes = 0;
+			vk::DeviceSize m_pendingBytes = 0;
+			uint64_t m_nextSubmission = 1;
+			std::deque<InFlightSubmission> m_inFlight;
+			std::vector<vk::Fence> m_freeFences;
+		};
+	}
+}
@@ -0,0 +1,107 @@
+#include "TextureTableVK.h"
+#include <algorithm>
+#include "../../UtilsCommon.h"
+
+GLVK::VK::TextureTable::TextureTable(const vk::Device& device, uint32_t capacity, uint32_t retireFrameCount)
+	: m_logicalDevice(device), m_capacity(capacity), m_retireFrameCount(retireFrameCount)
+{
+	auto binding = vk::DescriptorSetLayoutBinding();
+	binding.binding = 0;
+	binding.descriptorCount = m_capacity;
+	binding.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+	binding.pImmutableSamplers = nullptr;
+	binding.stageFlags = vk::ShaderStageFlagBits::eFragment;
+
+	// Slots that were never written or whose texture is gone are fine as long as no draw samples them.
+	vk::DescriptorBindingFlags binding_flags = vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind;
+	auto binding_flags_info = vk::DescriptorSetLayoutBindingFlagsCreateInfo();
+	binding_flags_info.bindingCount = 1;
+	binding_flags_info.pBindingFlags = &binding_flags;
+
+	auto layout_info = vk::DescriptorSetLayoutCreateInfo();
+	layout_info.bindingCount = 1;
+	layout_info.flags = vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool;
+	layout_info.pBindings = &binding;
+	layout_info.pNext = &binding_flags_info;
+	m_setLayout = m_logicalDevice.createDescriptorSetLayout(layout_info);
+
+	auto pool_size = vk::DescriptorPoolSize();
+	pool_size.descriptorCount = m_capacity;
+	pool_size.type = vk::DescriptorType::eCombinedImageSampler;
+
+	auto pool_info = vk::DescriptorPoolCreateInfo();
+	pool_info.flags = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind;
+	pool_info.maxSets = 1;
+	pool_info.poolSizeCount = 1;
+	pool_info.pPoolSizes = &pool_size;
+	m_descriptorPool = m_logicalDevice.createDescriptorPool(pool_info);
+
+	auto allocate_info = vk::DescriptorSetAllocateInfo();
+	allocate_info.descriptorPool = m_descriptorPool;
+	allocate_info.descriptorSetCount = 1;
+	allocate_info.pSetLayouts = &m_setLayout;
+	m_descriptorSet = m_logicalDevice.allocateDescriptorSets(allocate_info).front();
+}
+
+GLVK::VK::TextureTable::~TextureTable()
+{
+	m_logicalDevice.destroyDescriptorPool(m_descriptorPool);
+	m_logicalDevice.destroyDescriptorSetLayout(m_setLayout);
+}
+
+uint32_t GLVK::VK::TextureTable::Add(const vk::ImageView& imageView, const vk::Sampler& sampler)
+{
+	auto slot = m_nextSlot;
+	if (!m_freeSlots.empty())
+	{
+		slot = m_freeSlots.back();
+		m_freeSlots.pop_back();
+	}
+	else if (m_nextSlot < m_capacity)
+	{
+		++m_nextSlot;
+	}
+	else
+	{
+		::ThrowIfFailed("Texture table is full.");
+	}
+
+	auto image_info = vk::DescriptorImageInfo();
+	image_info.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+	image_info.imageView = imageView;
+	image_info.sampler = sampler;
+
+	auto write_descriptor = vk::WriteDescriptorSet();
+	write_descriptor.descriptorCount = 1;
+	write_descriptor.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+	write_descriptor.dstArrayElement = slot;
+	write_descriptor.dstBinding = 0;
+	write_descriptor.dstSet = m_descriptorSet;
+	write_descriptor.pImageInfo = &image_info;
+	m_logicalDevice.updateDescriptorSets(write_descriptor, {});
+	return slot;
+}
+
+void GLVK::VK::TextureTable::Remove(uint32_t slot, std::function<void()> onRetired)
+{
+	auto& retired = m_retiredSlots.emplace_back();
+	retired.Slot = slot;
+	retired.FramesLeft = m_retireFrameCount;
+	retired.OnRetired = std::move(onRetired);
+}
+
+void GLVK::VK::TextureTable::EndFrame()
+{
+	for (auto& retired : m_retiredSlots)
+	{
+		if (retired.FramesLeft > 0) --retired.FramesLeft;
+		if (retired.FramesLeft > 0) continue;
+
+		m_freeSlots.emplace_back(retired.Slot);
+		if (retired.OnRetired) retired.OnRetired();
+	}
+
+	std::erase_if(m_retiredSlots, [](const RetiredSlot& retired) {
+		return retired.FramesLeft == 0;
+		});
+}
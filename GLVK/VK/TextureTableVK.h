@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace GLVK
+{
+	namespace VK
+	{
+		/// <summary>
+		/// One descriptor set holding every loaded texture as a partially bound array of combined image samplers, bound once as set 1
+		/// of every graphics pipeline. Shaders pick a texture by its slot, so switching textures is a push constant instead of a
+		/// descriptor set bind. The set is update-after-bind, so slots can be written while frames that use the set are in flight.
+		/// </summary>
+		class TextureTable
+		{
+		public:
+			inline static constexpr uint32_t SET_INDEX = 1;
+
+			/// <summary>
+			/// A removed slot is only handed out again after retireFrameCount calls to EndFrame(), when no frame still in flight can sample it.
+			/// </summary>
+			TextureTable(const vk::Device& device, uint32_t capacity, uint32_t retireFrameCount);
+			~TextureTable();
+
+			TextureTable(const TextureTable&) = delete;
+			TextureTable& operator=(const TextureTable&) = delete;
+
+			/// <summary>
+			/// Write a texture into a free slot and return the slot. Throws once every slot is taken.
+			/// </summary>
+			[[nodiscard]] uint32_t Add(const vk::ImageView& imageView, const vk::Sampler& sampler);
+
+			/// <summary>
+			/// Retire a slot. onRetired runs when the slot is free again, once no frame in flight can sample the texture it held,
+			/// so that is where the texture can be destroyed.
+			/// </summary>
+			void Remove(uint32_t slot, std::function<void()> onRetired = nullptr);
+			void EndFrame();
+
+			[[nodiscard]] const vk::DescriptorSetLayout& GetSetLayout() const noexcept
+			{
+				return m_setLayout;
+			}
+
+			[[nodiscard]] const vk::DescriptorSet& GetDescriptorSet() const noexcept
+			{
+				return m_descriptorSet;
+			}
+
+			[[nodiscard]] uint32_t GetCapacity() const noexcept
+			{
+				return m_capacity;
+			}
+
+		private:
+			struct RetiredSlot
+			{
+				uint32_t Slot = 0;
+				uint32_t FramesLeft = 0;
+				std::function<void()> OnRetired;
+			};
+
+			vk::Device m_logicalDevice = nullptr;
+			vk::DescriptorSetLayout m_setLayout = nullptr;
+			vk::DescriptorPool m_descriptorPool = nullptr;
+			vk::DescriptorSet m_descriptorSet = nullptr;
+			std::vector<uint32_t> m_freeSlots;
+			std::vector<RetiredSlot> m_retiredSlots;
+			uint32_t m_capacity = 0;
+			uint32_t m_nextSlot = 0;
+			uint32_t m_retireFrameCount = 0;
+		};
+	}
+}
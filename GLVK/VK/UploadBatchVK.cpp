@@ -0,0 +1,243 @@
+#include "UploadBatchVK.h"
+#include <cstring>
+
+GLVK::VK::UploadBatch::UploadBatch(const vk::Device& device, Allocator& allocator, StagingRing& stagingRing, const UploadQueues& queues)
+	: m_logicalDevice(device), m_allocator(&allocator), m_stagingRing(&stagingRing), m_queues(queues)
+{
+	// Command pools are externally synchronized, so the batch keeps its own instead of sharing the render loop's.
+	auto pool_info = vk::CommandPoolCreateInfo();
+	pool_info.flags = vk::CommandPoolCreateFlagBits::eTransient;
+	pool_info.queueFamilyIndex = m_queues.TransferFamily;
+	m_transferCommandPool = m_logicalDevice.createCommandPool(pool_info);
+
+	if (m_queues.IsDedicatedTransfer())
+	{
+		pool_info.queueFamilyIndex = m_queues.GraphicsFamily;
+		m_graphicsCommandPool = m_logicalDevice.createCommandPool(pool_info);
+	}
+}
+
+GLVK::VK::UploadBatch::~UploadBatch()
+{
+	if (m_recording) Submit();
+
+	for (auto& batch : m_inFlight)
+		m_stagingRing->Wait(batch.Submission);
+	Collect();
+
+	for (auto& semaphore : m_freeSemaphores)
+		m_logicalDevice.destroySemaphore(semaphore);
+
+	if (m_graphicsCommandPool) m_logicalDevice.destroyCommandPool(m_graphicsCommandPool);
+	m_logicalDevice.destroyCommandPool(m_transferCommandPool);
+}
+
+void GLVK::VK::UploadBatch::CopyToBuffer(const void* data, vk::DeviceSize size, Buffer& target, vk::DeviceSize targetOffset)
+{
+	auto region = Stage(data, size);
+	BeginRecording();
+	target.RecordCopyBufferToBuffer(m_transferCommandBuffer, region.Source->GetBuffer(), size, region.Offset, targetOffset);
+
+	if (!m_queues.IsDedicatedTransfer()) return;
+
+	auto barrier = vk::BufferMemoryBarrier();
+	barrier.buffer = target.GetBuffer();
+	barrier.offset = targetOffset;
+	barrier.size = size;
+	barrier.srcQueueFamilyIndex = m_queues.TransferFamily;
+	barrier.dstQueueFamilyIndex = m_queues.GraphicsFamily;
+
+	// Release on the transfer queue; the destination access is ignored for a release.
+	barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+	barrier.dstAccessMask = {};
+	m_transferCommandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, barrier, {});
+
+	// Matching acquire on the graphics queue.
+	barrier.srcAccessMask = {};
+	barrier.dstAccessMask = vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead;
+	m_acquireCommandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eVertexInput, {}, {}, barrier, {});
+}
+
+void GLVK::VK::UploadBatch::CopyToImage(const void* data, vk::DeviceSize size, Image& target, uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+	auto region = Stage(data, size);
+	BeginRecording();
+	target.RecordTransitionLayout(m_transferCommandBuffer, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, vk::ImageAspectFlagBits::eColor, mipLevels);
+	region.Source->RecordCopyBufferToImage(m_transferCommandBuffer, target.GetImage(), height, width, vk::ImageAspectFlagBits::eColor, region.Offset);
+
+	if (!m_queues.IsDedicatedTransfer())
+	{
+		target.RecordGenerateMipmaps(m_transferCommandBuffer, mipLevels);
+		return;
+	}
+
+	auto barrier = vk::ImageMemoryBarrier();
+	barrier.image = target.GetImage();
+	barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+	barrier.newLayout = vk::ImageLayout::eTransferDstOptimal;
+	barrier.srcQueueFamilyIndex = m_queues.TransferFamily;
+	barrier.dstQueueFamilyIndex = m_queues.GraphicsFamily;
+	barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.subresourceRange.levelCount = mipLevels;
+
+	barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+	barrier.dstAccessMask = {};
+	m_transferCommandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, {}, barrier);
+
+	barrier.srcAccessMask = {};
+	barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite;
+	m_acquireCommandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, barrier);
+	target.RecordGenerateMipmaps(m_acquireCommandBuffer, mipLevels);
+}
+
+GLVK::VK::UploadToken GLVK::VK::UploadBatch::Submit()
+{
+	if (!m_recording)
+	{
+		auto last_submission = m_stagingRing->GetLastSubmission();
+		return last_submission > 0 ? UploadToken(m_stagingRing, last_submission) : UploadToken();
+	}
+
+	auto batch = InFlightBatch();
+	batch.TransferCommandBuffer = m_transferCommandBuffer;
+	batch.AcquireCommandBuffer = m_acquireCommandBuffer;
+	batch.OversizedBuffers = std::move(m_oversizedBuffers);
+
+	if (!m_queues.IsDedicatedTransfer())
+	{
+		// Make every copy in the batch visible to whatever reads the resources afterwards on this queue.
+		auto barrier = vk::MemoryBarrier();
+		barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		barrier.dstAccessMask = vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead | vk::AccessFlagBits::eShaderRead;
+		m_transferCommandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader, {}, barrier, {}, {});
+	}
+
+	m_transferCommandBuffer.end();
+	if (m_acquireCommandBuffer) m_acquireCommandBuffer.end();
+
+	auto fence = m_stagingRing->Retire();
+	auto submit_info = vk::SubmitInfo();
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &m_transferCommandBuffer;
+
+	if (!m_queues.IsDedicatedTransfer())
+	{
+		auto lock = std::lock_guard<std::mutex>{ *m_queues.GraphicsQueueMutex };
+		m_queues.GraphicsQueue.submit(submit_info, fence);
+	}
+	else
+	{
+		if (!m_freeSemaphores.empty())
+		{
+			batch.Semaphore = m_freeSemaphores.back();
+			m_freeSemaphores.pop_back();
+		}
+		else
+		{
+			batch.Semaphore = m_logicalDevice.createSemaphore(vk::SemaphoreCreateInfo());
+		}
+
+		submit_info.signalSemaphoreCount = 1;
+		submit_info.pSignalSemaphores = &batch.Semaphore;
+		m_queues.TransferQueue.submit(submit_info, nullptr);
+
+		// The fence goes on the acquire submission, which cannot start before the transfer side has signalled.
+		vk::PipelineStageFlags wait_stage = vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eVertexInput;
+		auto acquire_info = vk::SubmitInfo();
+		acquire_info.commandBufferCount = 1;
+		acquire_info.pCommandBuffers = &m_acquireCommandBuffer;
+		acquire_info.waitSemaphoreCount = 1;
+		acquire_info.pWaitSemaphores = &batch.Semaphore;
+		acquire_info.pWaitDstStageMask = &wait_stage;
+
+		auto lock = std::lock_guard<std::mutex>{ *m_queues.GraphicsQueueMutex };
+		m_queues.GraphicsQueue.submit(acquire_info, fence);
+	}
+
+	batch.Submission = m_stagingRing->GetLastSubmission();
+	m_inFlight.emplace_back(std::move(batch));
+
+	m_transferCommandBuffer = nullptr;
+	m_acquireCommandBuffer = nullptr;
+	m_oversizedBuffers.clear();
+	m_recording = false;
+
+	return UploadToken(m_stagingRing, m_inFlight.back().Submission);
+}
+
+void GLVK::VK::UploadBatch::Collect()
+{
+	while (!m_inFlight.empty() && m_stagingRing->IsCompleted(m_inFlight.front().Submission))
+	{
+		auto& batch = m_inFlight.front();
+		m_logicalDevice.freeCommandBuffers(m_transferCommandPool, batch.TransferCommandBuffer);
+
+		if (batch.AcquireCommandBuffer)
+			m_logicalDevice.freeCommandBuffers(m_graphicsCommandPool, batch.AcquireCommandBuffer);
+
+		if (batch.Semaphore)
+			m_freeSemaphores.emplace_back(batch.Semaphore);
+
+		m_inFlight.pop_front();
+	}
+}
+
+GLVK::VK::StagingRegion GLVK::VK::UploadBatch::Stage(const void* data, vk::DeviceSize size)
+{
+	auto ring_region = m_stagingRing->Allocate(size);
+
+	// The ring can only reclaim space from submitted work, so flush what has been recorded so far and try again.
+	if (!ring_region.has_value() && m_recording)
+	{
+		Submit();
+		ring_region = m_stagingRing->Allocate(size);
+	}
+
+	if (ring_region.has_value())
+	{
+		memcpy(ring_region->MappedData, data, size);
+		return ring_region.value();
+	}
+
+	// Larger than the whole ring: stage through a one-off buffer that lives until the batch has executed.
+	auto& buffer = m_oversizedBuffers.emplace_back(std::make_unique<Buffer>(m_logicalDevice, vk::BufferUsageFlagBits::eTransferSrc, size));
+	buffer->AllocateMemory(*m_allocator, vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostVisible, AllocationPool::Linear, MemoryCategory::Staging);
+	auto mapped_data = buffer->Map(size);
+	memcpy(mapped_data, data, size);
+	buffer->UnMap();
+
+	auto region = StagingRegion();
+	region.Source = buffer.get();
+	region.Size = size;
+	return region;
+}
+
+void GLVK::VK::UploadBatch::BeginRecording()
+{
+	if (m_recording) return;
+
+	Collect();
+
+	m_transferCommandBuffer = AllocateCommandBuffer(m_transferCommandPool);
+	if (m_queues.IsDedicatedTransfer())
+		m_acquireCommandBuffer = AllocateCommandBuffer(m_graphicsCommandPool);
+
+	m_recording = true;
+}
+
+vk::CommandBuffer GLVK::VK::UploadBatch::AllocateCommandBuffer(const vk::CommandPool& commandPool)
+{
+	auto alloc_info = vk::CommandBufferAllocateInfo();
+	alloc_info.commandBufferCount = 1;
+	alloc_info.commandPool = commandPool;
+	alloc_info.level = vk::CommandBufferLevel::ePrimary;
+	auto cmd_buffer = m_logicalDevice.allocateCommandBuffers(alloc_info)[0];
+
+	auto begin_info = vk::CommandBufferBeginInfo();
+	begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+	cmd_buffer.begin(begin_info);
+	return cmd_buffer;
+}
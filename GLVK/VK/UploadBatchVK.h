@@ -0,0 +1,119 @@
+#pragma once
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include "BufferVK.h"
+#include "ImageVK.h"
+#include "StagingRingVK.h"
+
+namespace GLVK
+{
+	namespace VK
+	{
+		/// <summary>
+		/// Identifies one submitted upload batch. Waiting on it blocks until every copy recorded into the batch has executed.
+		/// </summary>
+		class UploadToken
+		{
+		public:
+			UploadToken() = default;
+			UploadToken(StagingRing* stagingRing, uint64_t submission)
+				: m_stagingRing(stagingRing), m_submission(submission)
+			{
+
+			}
+
+			bool IsCompleted() const
+			{
+				return !m_stagingRing || m_stagingRing->IsCompleted(m_submission);
+			}
+
+			void Wait() const
+			{
+				if (m_stagingRing) m_stagingRing->Wait(m_submission);
+			}
+
+			[[nodiscard]] uint64_t GetSubmission() const noexcept
+			{
+				return m_submission;
+			}
+
+		private:
+			StagingRing* m_stagingRing = nullptr;
+			uint64_t m_submission = 0;
+		};
+
+		struct UploadQueues
+		{
+			vk::Queue TransferQueue = nullptr;
+			uint32_t TransferFamily = 0;
+			vk::Queue GraphicsQueue = nullptr;
+			uint32_t GraphicsFamily = 0;
+
+			/// <summary>
+			/// Guards every submission to the graphics queue, which is shared with the render loop.
+			/// </summary>
+			std::mutex* GraphicsQueueMutex = nullptr;
+
+			[[nodiscard]] bool IsDedicatedTransfer() const noexcept
+			{
+				return TransferFamily != GraphicsFamily;
+			}
+		};
+
+		/// <summary>
+		/// Records buffer copies, image transitions and mip generation into one command buffer that is submitted once with a fence.
+		/// Staging memory comes from the staging ring; if the ring fills up mid batch the recorded work is submitted early and recording continues.
+		/// With a dedicated transfer family, copies run on the transfer queue and ownership is released to the graphics family;
+		/// a second command buffer on the graphics queue acquires the resources and generates mipmaps, since blits need a graphics queue.
+		/// </summary>
+		class UploadBatch
+		{
+		public:
+			UploadBatch(const vk::Device& device, Allocator& allocator, StagingRing& stagingRing, const UploadQueues& queues);
+			~UploadBatch();
+
+			UploadBatch(const UploadBatch&) = delete;
+			UploadBatch& operator=(const UploadBatch&) = delete;
+
+			void CopyToBuffer(const void* data, vk::DeviceSize size, Buffer& target, vk::DeviceSize targetOffset = 0);
+			void CopyToImage(const void* data, vk::DeviceSize size, Image& target, uint32_t width, uint32_t height, uint32_t mipLevels);
+			UploadToken Submit();
+			void Collect();
+
+			[[nodiscard]] bool IsEmpty() const noexcept
+			{
+				return !m_recording;
+			}
+
+		private:
+			struct InFlightBatch
+			{
+				uint64_t Submission;
+				vk::CommandBuffer TransferCommandBuffer;
+				vk::CommandBuffer AcquireCommandBuffer;
+				vk::Semaphore Semaphore;
+				std::vector<std::unique_ptr<Buffer>> OversizedBuffers;
+			};
+
+			StagingRegion Stage(const void* data, vk::DeviceSize size);
+			void BeginRecording();
+			vk::CommandBuffer AllocateCommandBuffer(const vk::CommandPool& commandPool);
+
+			vk::Device m_logicalDevice = nullptr;
+			Allocator* m_allocator = nullptr;
+			StagingRing* m_stagingRing = nullptr;
+			UploadQueues m_queues = {};
+			vk::CommandPool m_transferCommandPool = nullptr;
+			vk::CommandPool m_graphicsCommandPool = nullptr;
+			vk::CommandBuffer m_transferCommandBuffer = nullptr;
+			vk::CommandBuffer m_acquireCommandBuffer = nullptr;
+			bool m_recording = false;
+			std::vector<std::unique_ptr<Buffer>> m_oversizedBuffers;
+			std::vector<vk::Semaphore> m_freeSemaphores;
+			std::deque<InFlightBatch> m_inFlight;
+		};
+	}
+}
@@ -1,9 +1,13 @@
 #pragma once
+#include <array>
+#include <limits>
 #include <optional>
 #include <stdexcept>
+#include <string>
 #include <string_view>
 #include <vector>
 #include <vulkan/vulkan.hpp>
+#include "../../Structures/MeshData.h"
 #include "../../Structures/Vertex.h"
 
 namespace GLVK
@@ -14,6 +18,11 @@ namespace GLVK
 		{
 			std::optional<uint32_t> GraphicsQueue;
 			std::optional<uint32_t> PresentQueue;
+
+			/// <summary>
+			/// A transfer-only family when the device exposes one, otherwise the graphics family.
+			/// </summary>
+			std::optional<uint32_t> TransferQueue;
 			
 			constexpr bool IsCompleted() const noexcept
 			{
@@ -21,6 +30,125 @@ namespace GLVK
 			}
 		};
 
+		struct GraphicsSettings
+		{
+			/// <summary>
+			/// Size of the persistently mapped ring that all buffer and texture uploads are staged through.
+			/// Uploads larger than this fall back to a temporary staging buffer.
+			/// </summary>
+			vk::DeviceSize StagingBufferSize = 32ull * 1024 * 1024;
+
+			/// <summary>
+			/// How many frames the CPU may record ahead of the GPU. Each one owns its own uniform buffers, descriptor set and sync objects.
+			/// </summary>
+			uint32_t FramesInFlight = 2;
+
+			/// <summary>
+			/// Vertex and index capacity of the geometry pool that every mesh is sub-allocated from.
+			/// </summary>
+			uint32_t GeometryPoolVertexCount = 1024 * 1024;
+			uint32_t GeometryPoolIndexCount = 4 * 1024 * 1024;
+
+			/// <summary>
+			/// Whether meshes keep their vertices and indices in system memory after upload. Individual models can override it.
+			/// </summary>
+			MeshDataRetention MeshRetention = MeshDataRetention::Keep;
+
+			/// <summary>
+			/// Worker threads that record the frame's draw list into secondary command buffers. Zero uses one per hardware thread but the main one.
+			/// A worker is only woken when it gets at least MinDrawsPerRecordingThread draws.
+			/// </summary>
+			uint32_t RecordingThreadCount = 0;
+			uint32_t MinDrawsPerRecordingThread = 256;
+
+			/// <summary>
+			/// Initial number of per-instance entries in each frame's instance buffer. The buffer doubles when a frame needs more.
+			/// </summary>
+			uint32_t InstanceCapacity = 16 * 1024;
+
+			/// <summary>
+			/// Issue the frame's draws from an indirect buffer instead of recording them one by one. Ignored on devices without
+			/// drawIndirectFirstInstance, since every draw starts at its own instance.
+			/// </summary>
+			bool IndirectDraws = true;
+			uint32_t IndirectDrawCapacity = 1024;
+
+			/// <summary>
+			/// Cull instances against the view frustum in a compute pass before drawing. Only available on the indirect draw path,
+			/// since the pass writes the surviving instance counts into the indirect commands.
+			/// </summary>
+			bool GpuCulling = true;
+
+			/// <summary>
+			/// Also cull instances hidden behind nearer geometry, against a depth pyramid built in the middle of the frame. Needs GPU culling,
+			/// a multisampled depth buffer and a depth format that can be sampled.
+			/// </summary>
+			bool OcclusionCulling = true;
+
+			/// <summary>
+			/// Cull instances against the view frustum on the CPU when the compute pass is not used, so culled meshes never reach the instance buffer.
+			/// </summary>
+			bool CpuCulling = true;
+
+			/// <summary>
+			/// Lay down depth for every unblended draw before shading anything, reading a position-only copy of the vertices, so the main
+			/// pass tests with an equal compare and only visible fragments are shaded. Pays off when the fragment shader dominates.
+			/// </summary>
+			bool DepthPrePass = false;
+
+			/// <summary>
+			/// File the pipeline cache is loaded from at start-up and saved to on shutdown. Empty keeps it in memory only.
+			/// </summary>
+			std::string PipelineCachePath = "pipeline_cache.bin";
+
+			/// <summary>
+			/// Pipelines other than the unblended ones are built the first time a draw needs them. In the background, the draw uses
+			/// the unblended pipeline until then instead of stalling the frame. The pipelines a run used are saved to PipelineKeysPath
+			/// and compiled in the background at the next start-up; an empty path turns that off.
+			/// </summary>
+			bool BackgroundPipelineCompilation = true;
+			std::string PipelineKeysPath = "pipeline_keys.txt";
+
+			/// <summary>
+			/// Compile the shaders from their GLSL sources at start-up instead of loading the prebuilt SPIR-V, keeping the results in
+			/// ShaderCachePath. With ShaderHotReload, sources saved while the engine runs are recompiled and only the pipelines built
+			/// from them are rebuilt. Needs a build with shaderc; without it the prebuilt SPIR-V is loaded, with a warning for every
+			/// file older than its source.
+			/// </summary>
+			bool RuntimeShaderCompilation = true;
+			bool ShaderHotReload = true;
+			std::string ShaderCachePath = "shader_cache";
+
+			/// <summary>
+			/// Slots in the bindless texture table. Clamped to the device's update-after-bind limits, and to what fits in the material
+			/// field of a sort key, since that is how instanced draws carry their texture.
+			/// </summary>
+			uint32_t TextureTableCapacity = 1023;
+
+			/// <summary>
+			/// How many simplified levels every imported mesh gets and how coarse they may become.
+			/// </summary>
+			LodGenerationSettings LodGeneration = {};
+
+			/// <summary>
+			/// The coarsest level whose error projects to at most LodPixelError * 2^LodBias pixels is drawn, so a positive bias switches earlier.
+			/// A coarser level than last frame's is only taken once its error is LodHysteresis below that limit, which stops meshes near a
+			/// threshold from flickering between two levels.
+			/// </summary>
+			float LodPixelError = 1.0f;
+			float LodBias = 0.0f;
+			float LodHysteresis = 0.25f;
+		};
+
+		/// <summary>
+		/// Instances and triangles submitted per level of detail by the last EndDraw(). With GPU culling they are counted before culling.
+		/// </summary>
+		struct LodStatistics
+		{
+			std::array<uint32_t, MeshLod::MAX_LEVEL_COUNT> InstanceCounts = {};
+			std::array<uint64_t, MeshLod::MAX_LEVEL_COUNT> TriangleCounts = {};
+		};
+
 		struct SwapchainDetails
         {
 		    vk::SurfaceCapabilitiesKHR SurfaceCapabilities;
@@ -42,6 +170,59 @@ namespace GLVK
 			alignas(16) glm::vec4 ObjectColor;
 		};
 
+		/// <summary>
+		/// One entry of the instance storage buffer, laid out as the std430 InstanceData struct in basicShader.vert.
+		/// </summary>
+		struct InstanceData
+		{
+			alignas(16) glm::mat4 World;
+			alignas(16) glm::vec4 Color;
+		};
+
+		/// <summary>
+		/// Input of frustumCull.comp: an instance, its world space bounding sphere (xyz center, w radius), the batch that draws it
+		/// and its occlusion visibility flag. The flag follows the instance's place in the draw list, which unlike its sorted slot
+		/// does not change with the camera.
+		/// </summary>
+		struct CullInstanceData
+		{
+			alignas(16) InstanceData Instance;
+			alignas(16) glm::vec4 BoundingSphere;
+			alignas(4) uint32_t BatchIndex;
+			alignas(4) uint32_t VisibilityIndex;
+		};
+
+		struct CullPushConstant
+		{
+			glm::vec4 Planes[6];
+			uint32_t InstanceCount;
+			uint32_t BatchCount;
+
+			/// <summary>
+			/// With occlusion culling, 0 draws what was visible last frame and 1 tests everything against the depth pyramid.
+			/// </summary>
+			uint32_t Phase;
+		};
+
+		/// <summary>
+		/// The OcclusionData uniform block of frustumCull.comp, std140.
+		/// </summary>
+		struct OcclusionData
+		{
+			alignas(16) glm::mat4 ViewProjection;
+			alignas(8) glm::vec2 PyramidSize;
+			alignas(4) uint32_t LevelCount;
+		};
+
+		struct HiZPushConstant
+		{
+			int32_t SourceWidth;
+			int32_t SourceHeight;
+			int32_t DestinationWidth;
+			int32_t DestinationHeight;
+			uint32_t FromDepth;
+		};
+
 		inline std::vector<vk::VertexInputAttributeDescription> GetVertexInputAttributeDescription(uint32_t binding) noexcept
 		{
 			auto descs = std::vector<vk::VertexInputAttributeDescription>(3);
@@ -123,7 +304,8 @@ namespace GLVK
 		/// <param name="device">The logical device.</param>
 		/// <param name="commandPool">The command pool.</param>
 		/// <param name="graphicsQueue">The queue used to submit the command buffer.</param>
-		inline void ExecuteCommandBuffer(vk::CommandBuffer& commandBuffer, const vk::Device& device, const vk::CommandPool& commandPool, const vk::Queue& graphicsQueue)
+		/// <param name="fence">Optional fence signalled by the submission. When provided only this fence is waited on instead of the whole queue.</param>
+		inline void ExecuteCommandBuffer(vk::CommandBuffer& commandBuffer, const vk::Device& device, const vk::CommandPool& commandPool, const vk::Queue& graphicsQueue, const vk::Fence& fence = nullptr)
 		{
 			commandBuffer.end();
 
@@ -136,11 +318,26 @@ namespace GLVK
 			submit_info.signalSemaphoreCount = 0;
 			submit_info.waitSemaphoreCount = 0;
 
-			graphicsQueue.submit(submit_info, nullptr);
-			graphicsQueue.waitIdle();
+			graphicsQueue.submit(submit_info, fence);
+
+			if (fence)
+				device.waitForFences(fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+			else
+				graphicsQueue.waitIdle();
+
 			device.freeCommandBuffers(commandPool, commandBuffer);
 		}
 
+		constexpr vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment) noexcept
+		{
+			return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+		}
+
+		constexpr vk::DeviceSize AlignDown(vk::DeviceSize value, vk::DeviceSize alignment) noexcept
+		{
+			return alignment > 1 ? value / alignment * alignment : value;
+		}
+
 		inline void* AllocateAlignedMemory(size_t size, size_t alignment)
 		{
 #ifdef _WIN32
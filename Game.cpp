@@ -42,9 +42,6 @@ void Game::LoadContent()
 	////m_graphics->LoadModel("Models/Wolf/Wolf.fbx");
 	m_sceneManager->LoadContent();
 	m_graphics->Initialize();
-	m_graphics->BeginDraw();
-	m_sceneManager->Render(m_deltaTime);
-	m_graphics->EndDraw();
 }
 
 bool Game::IsInitialized() const noexcept
@@ -75,6 +72,9 @@ void Game::Render()
 	
 	try
 	{
+		m_graphics->BeginDraw();
+		m_sceneManager->Render(m_deltaTime);
+		m_graphics->EndDraw();
 		m_window->Render(m_deltaTime);
 	}
 	catch (const std::exception&)
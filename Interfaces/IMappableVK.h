@@ -1,5 +1,7 @@
 #pragma once
+#include <cstdint>
 #include <vulkan/vulkan.hpp>
+#include "../GLVK/VK/AllocatorVK.h"
 
 namespace GLVK
 {
@@ -13,30 +15,39 @@ namespace GLVK
 			{
 
 			}
-			
+
 			virtual ~IMappable()
 			{
 				if (m_mappedMemory)
 					UnMap();
 
-				if (m_deviceMemory)
+				if (m_allocator)
 				{
-					m_logicalDevice.freeMemory(m_deviceMemory);
+					m_allocator->Free(m_allocation);
 				}
 			}
 
-			virtual const vk::DeviceMemory& AllocateMemory(const vk::PhysicalDevice& physicalDevice, const vk::MemoryPropertyFlags& memoryProperties) = 0;
+			virtual const vk::DeviceMemory& AllocateMemory(Allocator& allocator, const vk::MemoryPropertyFlags& memoryProperties, AllocationPool pool = AllocationPool::FreeList, MemoryCategory category = MemoryCategory::Other) = 0;
 
 			void* Map(vk::DeviceSize size, vk::DeviceSize offset = 0)
 			{
 				if (m_mappedMemory) return m_mappedMemory;
-				m_mappedMemory = m_logicalDevice.mapMemory(m_deviceMemory, offset, size);
+
+				// Host visible blocks are persistently mapped by the allocator, so mapping only resolves our slice of it.
+				if (m_allocation.MappedData)
+				{
+					m_mappedMemory = reinterpret_cast<uint8_t*>(m_allocation.MappedData) + offset;
+					return m_mappedMemory;
+				}
+
+				m_mappedMemory = m_logicalDevice.mapMemory(m_deviceMemory, m_allocation.Offset + offset, size);
 				return m_mappedMemory;
 			}
 
 			void UnMap()
 			{
-				m_logicalDevice.unmapMemory(m_deviceMemory);
+				if (!m_allocation.MappedData)
+					m_logicalDevice.unmapMemory(m_deviceMemory);
 				m_mappedMemory = nullptr;
 			}
 
@@ -50,27 +61,17 @@ namespace GLVK
 				return m_mappedMemory;
 			}
 
-		protected:
-			uint32_t GetMemoryTypeIndex(const vk::PhysicalDevice& physicalDevice, uint32_t memoryType, const vk::MemoryPropertyFlags& memoryProperties)
+			[[nodiscard]] const Allocation& GetAllocation() const noexcept
 			{
-				auto properties = physicalDevice.getMemoryProperties();
-				for (uint32_t i = 0; i < properties.memoryTypeCount; ++i)
-				{
-					if ((memoryType & (1 << i)) &&
-						(properties.memoryTypes[i].propertyFlags & memoryProperties) == memoryProperties)
-					{
-						return i;
-					}
-				}
-				return 0;
+				return m_allocation;
 			}
 
-			const vk::DeviceMemory& MapDeviceMemory(const vk::MemoryRequirements& requirements, const vk::PhysicalDevice& physicalDevice, const vk::MemoryPropertyFlags& memoryProperties)
+		protected:
+			const vk::DeviceMemory& MapDeviceMemory(const vk::MemoryRequirements& requirements, Allocator& allocator, const vk::MemoryPropertyFlags& memoryProperties, AllocationPool pool, bool isImage, MemoryCategory category)
 			{
-				auto allocate_info = vk::MemoryAllocateInfo();
-				allocate_info.allocationSize = requirements.size;
-				allocate_info.memoryTypeIndex = GetMemoryTypeIndex(physicalDevice, requirements.memoryTypeBits, memoryProperties);
-				m_deviceMemory = m_logicalDevice.allocateMemory(allocate_info);
+				m_allocator = &allocator;
+				m_allocation = allocator.Allocate(requirements, memoryProperties, pool, isImage, category);
+				m_deviceMemory = m_allocation.Memory;
 				return m_deviceMemory;
 			}
 
@@ -78,7 +79,8 @@ namespace GLVK
 			vk::Device m_logicalDevice = nullptr;
 			vk::DeviceMemory m_deviceMemory = nullptr;
 			void* m_mappedMemory = nullptr;
+			Allocator* m_allocator = nullptr;
+			Allocation m_allocation = {};
 		};
 	}
 }
-
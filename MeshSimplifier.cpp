@@ -0,0 +1,353 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <tuple>
+
+namespace
+{
+	struct Vector3D
+	{
+		double X = 0.0;
+		double Y = 0.0;
+		double Z = 0.0;
+
+		Vector3D(const Vector3& vector) noexcept
+			: X(vector.x), Y(vector.y), Z(vector.z)
+		{
+		}
+
+		Vector3D(double x, double y, double z) noexcept
+			: X(x), Y(y), Z(z)
+		{
+		}
+
+		Vector3D operator-(const Vector3D& other) const noexcept
+		{
+			return Vector3D(X - other.X, Y - other.Y, Z - other.Z);
+		}
+
+		[[nodiscard]] double Dot(const Vector3D& other) const noexcept
+		{
+			return X * other.X + Y * other.Y + Z * other.Z;
+		}
+
+		[[nodiscard]] Vector3D Cross(const Vector3D& other) const noexcept
+		{
+			return Vector3D(Y * other.Z - Z * other.Y, Z * other.X - X * other.Z, X * other.Y - Y * other.X);
+		}
+
+		[[nodiscard]] double Length() const noexcept
+		{
+			return std::sqrt(Dot(*this));
+		}
+	};
+
+	/// <summary>
+	/// The symmetric 4x4 error quadric of Garland and Heckbert, summed from the planes of the triangles around a vertex and weighted by their area.
+	/// </summary>
+	struct Quadric
+	{
+		double A00 = 0.0, A11 = 0.0, A22 = 0.0, A01 = 0.0, A02 = 0.0, A12 = 0.0;
+		double B0 = 0.0, B1 = 0.0, B2 = 0.0;
+		double C = 0.0;
+		double Weight = 0.0;
+
+		static Quadric FromPlane(const Vector3D& normal, double distance, double weight) noexcept
+		{
+			auto quadric = Quadric();
+			quadric.A00 = weight * normal.X * normal.X;
+			quadric.A11 = weight * normal.Y * normal.Y;
+			quadric.A22 = weight * normal.Z * normal.Z;
+			quadric.A01 = weight * normal.X * normal.Y;
+			quadric.A02 = weight * normal.X * normal.Z;
+			quadric.A12 = weight * normal.Y * normal.Z;
+			quadric.B0 = weight * normal.X * distance;
+			quadric.B1 = weight * normal.Y * distance;
+			quadric.B2 = weight * normal.Z * distance;
+			quadric.C = weight * distance * distance;
+			quadric.Weight = weight;
+			return quadric;
+		}
+
+		Quadric& operator+=(const Quadric& other) noexcept
+		{
+			A00 += other.A00; A11 += other.A11; A22 += other.A22;
+			A01 += other.A01; A02 += other.A02; A12 += other.A12;
+			B0 += other.B0; B1 += other.B1; B2 += other.B2;
+			C += other.C;
+			Weight += other.Weight;
+			return *this;
+		}
+
+		Quadric operator+(const Quadric& other) const noexcept
+		{
+			auto quadric = *this;
+			quadric += other;
+			return quadric;
+		}
+
+		/// <summary>
+		/// Area weighted mean of the squared distances from the point to the summed planes.
+		/// </summary>
+		[[nodiscard]] double Evaluate(const Vector3D& point) const noexcept
+		{
+			auto x = point.X, y = point.Y, z = point.Z;
+			auto error = A00 * x * x + A11 * y * y + A22 * z * z
+				+ 2.0 * (A01 * x * y + A02 * x * z + A12 * y * z)
+				+ 2.0 * (B0 * x + B1 * y + B2 * z) + C;
+			return Weight > 0.0 ? std::max(error, 0.0) / Weight : 0.0;
+		}
+	};
+
+	struct Collapse
+	{
+		uint32_t From = 0;
+		uint32_t To = 0;
+		double Error = 0.0;
+	};
+
+	/// <summary>
+	/// Map every vertex to the first vertex with the same position, so vertices split along UV or normal seams count as one for the topology.
+	/// </summary>
+	std::vector<uint32_t> WeldPositions(const std::vector<Vertex>& vertices)
+	{
+		auto order = std::vector<uint32_t>(vertices.size());
+		std::iota(order.begin(), order.end(), 0u);
+		std::sort(order.begin(), order.end(), [&vertices](uint32_t a, uint32_t b) {
+			const auto& first = vertices[a].Position;
+			const auto& second = vertices[b].Position;
+			return std::tie(first.x, first.y, first.z, a) < std::tie(second.x, second.y, second.z, b);
+			});
+
+		auto welded = std::vector<uint32_t>(vertices.size());
+		for (size_t i = 0, first = 0; i < order.size(); ++i)
+		{
+			const auto& position = vertices[order[i]].Position;
+			const auto& first_position = vertices[order[first]].Position;
+			if (position.x != first_position.x || position.y != first_position.y || position.z != first_position.z) first = i;
+			welded[order[i]] = order[first];
+		}
+		return welded;
+	}
+
+	/// <summary>
+	/// Seam vertices, and every vertex on an edge that does not have exactly two triangles: open borders and non-manifold fans.
+	/// </summary>
+	std::vector<uint8_t> FindLockedVertices(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& welded)
+	{
+		auto is_locked = std::vector<uint8_t>(welded.size(), 0);
+		for (size_t i = 0; i < welded.size(); ++i)
+		{
+			if (welded[i] != i) is_locked[welded[i]] = 1;
+		}
+
+		auto edges = std::vector<std::pair<uint32_t, uint32_t>>();
+		edges.reserve(indices.size());
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			for (size_t j = 0; j < 3; ++j)
+			{
+				auto a = welded[indices[i + j]];
+				auto b = welded[indices[i + (j + 1) % 3]];
+				edges.emplace_back(std::min(a, b), std::max(a, b));
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+
+		for (size_t i = 0; i < edges.size();)
+		{
+			auto next = i + 1;
+			while (next < edges.size() && edges[next] == edges[i]) ++next;
+			if (next - i != 2)
+			{
+				is_locked[edges[i].first] = 1;
+				is_locked[edges[i].second] = 1;
+			}
+			i = next;
+		}
+		return is_locked;
+	}
+
+	/// <summary>
+	/// For every welded vertex, the triangles that use it, as offsets into one shared list.
+	/// </summary>
+	void BuildAdjacency(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& welded, std::vector<uint32_t>& offsets, std::vector<uint32_t>& triangles)
+	{
+		offsets.assign(welded.size() + 1, 0);
+		for (auto index : indices)
+			++offsets[welded[index] + 1];
+		std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+		auto cursors = std::vector<uint32_t>(offsets.begin(), offsets.end() - 1);
+		triangles.resize(indices.size());
+		for (size_t i = 0; i < indices.size(); ++i)
+			triangles[cursors[welded[indices[i]]]++] = static_cast<uint32_t>(i / 3);
+	}
+}
+
+std::vector<uint32_t> SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount, float maxError, float* resultError)
+{
+	auto result = indices;
+	if (resultError) *resultError = 0.0f;
+	if (result.size() <= targetIndexCount || vertices.empty()) return result;
+
+	auto welded = WeldPositions(vertices);
+	auto is_locked = FindLockedVertices(result, welded);
+
+	auto quadrics = std::vector<Quadric>(vertices.size());
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		auto p0 = Vector3D(vertices[result[i]].Position);
+		auto normal = (Vector3D(vertices[result[i + 1]].Position) - p0).Cross(Vector3D(vertices[result[i + 2]].Position) - p0);
+		auto length = normal.Length();
+		if (length <= 0.0) continue;
+
+		normal = Vector3D(normal.X / length, normal.Y / length, normal.Z / length);
+		auto quadric = Quadric::FromPlane(normal, -normal.Dot(p0), length * 0.5);
+		for (size_t j = 0; j < 3; ++j)
+			quadrics[welded[result[i + j]]] += quadric;
+	}
+
+	auto error_limit = static_cast<double>(maxError) * maxError;
+	auto max_collapse_error = 0.0;
+	auto targets = std::vector<uint32_t>(vertices.size());
+	std::iota(targets.begin(), targets.end(), 0u);
+	auto is_touched = std::vector<uint8_t>(vertices.size());
+	auto offsets = std::vector<uint32_t>();
+	auto triangles = std::vector<uint32_t>();
+	auto collapses = std::vector<Collapse>();
+
+	// Moving a vertex onto its neighbor must not turn any of its remaining triangles over or fold it nearly flat.
+	auto would_flip = [&](uint32_t from, uint32_t to, const Vector3D& position) {
+		for (auto i = offsets[from]; i < offsets[from + 1]; ++i)
+		{
+			auto triangle = triangles[i] * 3;
+			Vector3D before[3] = { vertices[result[triangle]].Position, vertices[result[triangle + 1]].Position, vertices[result[triangle + 2]].Position };
+			Vector3D after[3] = { before[0], before[1], before[2] };
+
+			auto is_removed = false;
+			for (size_t j = 0; j < 3; ++j)
+			{
+				auto vertex = welded[result[triangle + j]];
+				if (vertex == to) is_removed = true;
+				if (vertex == from) after[j] = position;
+			}
+			if (is_removed) continue;
+
+			auto normal_before = (before[1] - before[0]).Cross(before[2] - before[0]);
+			auto normal_after = (after[1] - after[0]).Cross(after[2] - after[0]);
+			if (normal_before.Dot(normal_after) <= 0.25 * normal_before.Length() * normal_after.Length()) return true;
+		}
+		return false;
+	};
+
+	// Each pass sorts every edge by the cheaper of its two collapse directions and takes the cheapest ones whose neighborhoods do not overlap.
+	while (result.size() > targetIndexCount)
+	{
+		BuildAdjacency(result, welded, offsets, triangles);
+
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (size_t j = 0; j < 3; ++j)
+			{
+				auto a = result[i + j];
+				auto b = result[i + (j + 1) % 3];
+				auto quadric = quadrics[welded[a]] + quadrics[welded[b]];
+				auto to_b = is_locked[welded[a]] ? -1.0 : quadric.Evaluate(vertices[b].Position);
+				auto to_a = is_locked[welded[b]] ? -1.0 : quadric.Evaluate(vertices[a].Position);
+
+				if (to_b >= 0.0 && (to_a < 0.0 || to_b <= to_a))
+					collapses.emplace_back(Collapse{ a, b, to_b });
+				else if (to_a >= 0.0)
+					collapses.emplace_back(Collapse{ b, a, to_a });
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+			return a.Error < b.Error;
+			});
+
+		// An interior collapse removes two triangles, so stop once the estimate reaches the target instead of overshooting it.
+		auto triangles_to_remove = (result.size() - targetIndexCount) / 3;
+		size_t triangles_removed = 0;
+		size_t collapse_count = 0;
+		std::fill(is_touched.begin(), is_touched.end(), 0);
+
+		for (const auto& collapse : collapses)
+		{
+			if (collapse.Error > error_limit || triangles_removed >= triangles_to_remove) break;
+
+			auto from = welded[collapse.From];
+			auto to = welded[collapse.To];
+			if (from == to || is_touched[from] || is_touched[to]) continue;
+			if (would_flip(from, to, vertices[collapse.To].Position)) continue;
+
+			// An unlocked vertex is never on a seam, so it is the only vertex at its position and can simply be redirected.
+			targets[collapse.From] = collapse.To;
+			quadrics[to] += quadrics[from];
+			max_collapse_error = std::max(max_collapse_error, collapse.Error);
+
+			for (auto i = offsets[from]; i < offsets[from + 1]; ++i)
+			{
+				for (size_t j = 0; j < 3; ++j)
+					is_touched[welded[result[triangles[i] * 3 + j]]] = 1;
+			}
+
+			triangles_removed += 2;
+			++collapse_count;
+		}
+
+		if (collapse_count == 0) break;
+
+		size_t count = 0;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			auto a = targets[result[i]];
+			auto b = targets[result[i + 1]];
+			auto c = targets[result[i + 2]];
+			if (welded[a] == welded[b] || welded[b] == welded[c] || welded[a] == welded[c]) continue;
+
+			result[count++] = a;
+			result[count++] = b;
+			result[count++] = c;
+		}
+		result.resize(count);
+	}
+
+	if (resultError) *resultError = static_cast<float>(std::sqrt(max_collapse_error));
+	return result;
+}
+
+std::vector<MeshLod> GenerateLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const LodGenerationSettings& settings, float radius)
+{
+	auto lods = std::vector<MeshLod>();
+	auto level_count = std::min(settings.LevelCount, MeshLod::MAX_LEVEL_COUNT);
+	if (level_count < 2 || radius <= 0.0f || indices.size() < 3) return lods;
+
+	lods.emplace_back(MeshLod{ 0, static_cast<uint32_t>(indices.size()), 0.0f });
+
+	auto max_error = settings.MaxError * radius;
+	auto error = 0.0f;
+	auto previous = indices;
+	for (uint32_t level = 1; level < level_count; ++level)
+	{
+		auto target = static_cast<size_t>(static_cast<float>(previous.size() / 3) * settings.Reduction) * 3;
+		if (target < static_cast<size_t>(settings.MinTriangleCount) * 3) break;
+
+		// Every level is simplified from the one before, so its distance from the full resolution surface is at most the sum of the steps.
+		auto level_error = 0.0f;
+		auto simplified = SimplifyMesh(vertices, previous, target, max_error - error, &level_error);
+
+		// A level that barely differs from the last one only costs memory.
+		if (simplified.size() * 10 > previous.size() * 9) break;
+
+		error += level_error;
+		lods.emplace_back(MeshLod{ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(simplified.size()), error });
+		indices.insert(indices.end(), simplified.cbegin(), simplified.cend());
+		previous = std::move(simplified);
+	}
+
+	if (lods.size() == 1) lods.clear();
+	return lods;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Structures/MeshData.h"
+#include "Structures/Vertex.h"
+
+/// <summary>
+/// Collapse edges of an indexed triangle list in order of increasing quadric error until at most targetIndexCount indices remain, or until
+/// the next collapse would move the surface further than maxError. The result indexes the same vertices, so levels can share one vertex range.
+/// Vertices on open borders and on UV or normal seams are never moved, which keeps the silhouette and the texture mapping intact.
+/// </summary>
+std::vector<uint32_t> SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount, float maxError, float* resultError = nullptr);
+
+/// <summary>
+/// Append simplified levels behind the full resolution triangles in indices and return the level table, with the original list as level 0.
+/// Returns an empty table when not even one level could be generated.
+/// </summary>
+std::vector<MeshLod> GenerateLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const LodGenerationSettings& settings, float radius);
@@ -69,19 +69,15 @@ inline void GameScene<Texture, Buffer>::Render(float deltaTime)
     if constexpr (std::is_same_v<Texture, GLVK::VK::Image> && std::is_same_v<Buffer, GLVK::VK::Buffer>)
     {
         auto graphics_ptr = dynamic_cast<GLVK::VK::GraphicsEngine*>(m_graphics);
-        auto cmd_buffers = graphics_ptr->GetCommandBufferOrLists();
 
-        for (auto& buffer : cmd_buffers)
+        for (auto& mesh : m_meshes)
         {
-            for (auto& mesh : m_meshes)
-            {
-                mesh->Render<vk::CommandBuffer>(deltaTime, buffer, static_cast<uint32_t>(graphics_ptr->GetDynamicOffset()), graphics_ptr->GetPipeline(), graphics_ptr->GetDescriptorSet(), graphics_ptr->GetPushConstant());
-            }
+            graphics_ptr->Draw(mesh);
+        }
 
-            for (auto& model : m_models)
-            {
-                model->Render<vk::CommandBuffer>(deltaTime, buffer, static_cast<uint32_t>(graphics_ptr->GetDynamicOffset()), graphics_ptr->GetPipeline(), graphics_ptr->GetDescriptorSet(), graphics_ptr->GetPushConstant());
-            }
+        for (auto& model : m_models)
+        {
+            graphics_ptr->Draw(model);
         }
     }
 }
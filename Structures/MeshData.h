@@ -0,0 +1,223 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include "Vertex.h"
+
+/// <summary>
+/// What happens to a mesh's CPU-side vertices and indices once they have been uploaded to the GPU.
+/// </summary>
+enum class MeshDataRetention
+{
+	Keep, Release, Compress
+};
+
+struct BoundingBox
+{
+	Vector3 Min = Vector3(std::numeric_limits<float>::max());
+	Vector3 Max = Vector3(std::numeric_limits<float>::lowest());
+
+	static BoundingBox FromVertices(const std::vector<Vertex>& vertices) noexcept
+	{
+		auto bounds = BoundingBox();
+		for (const auto& vertex : vertices)
+		{
+			bounds.Min = Vector3(std::min(bounds.Min.x, vertex.Position.x), std::min(bounds.Min.y, vertex.Position.y), std::min(bounds.Min.z, vertex.Position.z));
+			bounds.Max = Vector3(std::max(bounds.Max.x, vertex.Position.x), std::max(bounds.Max.y, vertex.Position.y), std::max(bounds.Max.z, vertex.Position.z));
+		}
+		return bounds;
+	}
+
+	[[nodiscard]] bool IsValid() const noexcept
+	{
+		return Min.x <= Max.x && Min.y <= Max.y && Min.z <= Max.z;
+	}
+
+	[[nodiscard]] Vector3 GetCenter() const noexcept
+	{
+		return Vector3((Min.x + Max.x) * 0.5f, (Min.y + Max.y) * 0.5f, (Min.z + Max.z) * 0.5f);
+	}
+
+	[[nodiscard]] Vector3 GetExtents() const noexcept
+	{
+		return Vector3((Max.x - Min.x) * 0.5f, (Max.y - Min.y) * 0.5f, (Max.z - Min.z) * 0.5f);
+	}
+};
+
+/// <summary>
+/// Centered on the mesh's bounding box, with the distance to its farthest vertex as radius, which is tighter than the box's half diagonal.
+/// </summary>
+struct BoundingSphere
+{
+	Vector3 Center = Vector3(0.0f);
+	float Radius = -1.0f;
+
+	static BoundingSphere FromVertices(const std::vector<Vertex>& vertices, const BoundingBox& bounds) noexcept
+	{
+		auto sphere = BoundingSphere();
+		if (!bounds.IsValid()) return sphere;
+
+		sphere.Center = bounds.GetCenter();
+		auto radius_squared = 0.0f;
+		for (const auto& vertex : vertices)
+		{
+			auto dx = vertex.Position.x - sphere.Center.x;
+			auto dy = vertex.Position.y - sphere.Center.y;
+			auto dz = vertex.Position.z - sphere.Center.z;
+			radius_squared = std::max(radius_squared, dx * dx + dy * dy + dz * dz);
+		}
+		sphere.Radius = std::sqrt(radius_squared);
+		return sphere;
+	}
+
+	[[nodiscard]] bool IsValid() const noexcept
+	{
+		return Radius >= 0.0f;
+	}
+};
+
+/// <summary>
+/// One level of detail: a range of the mesh's index list that draws a simplified version of the same vertices.
+/// Error is the object space distance the level may deviate from the full resolution surface.
+/// </summary>
+struct MeshLod
+{
+	inline static constexpr uint32_t MAX_LEVEL_COUNT = 6;
+
+	uint32_t FirstIndex = 0;
+	uint32_t IndexCount = 0;
+	float Error = 0.0f;
+};
+
+/// <summary>
+/// How imported meshes are simplified. Each level aims for Reduction times the previous level's triangles, and generation stops
+/// early when a level would deviate more than MaxError times the mesh's radius or drop below MinTriangleCount triangles.
+/// </summary>
+struct LodGenerationSettings
+{
+	uint32_t LevelCount = 4;
+	float Reduction = 0.5f;
+	float MaxError = 0.05f;
+	uint32_t MinTriangleCount = 64;
+};
+
+/// <summary>
+/// Lossless compact copy of a mesh's vertices and indices, kept so geometry can be uploaded again after the CPU arrays were released.
+/// Every vertex component is XORed with the same component of the previous vertex and indices are delta coded, then both are
+/// written as variable length integers, so repeated attributes and coherent index lists shrink to a byte or two each.
+/// </summary>
+struct CompressedMeshData
+{
+	uint32_t VertexCount = 0;
+	uint32_t IndexCount = 0;
+	std::vector<uint8_t> Bytes;
+
+	[[nodiscard]] bool IsEmpty() const noexcept
+	{
+		return VertexCount == 0 && IndexCount == 0;
+	}
+
+	static CompressedMeshData Compress(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+	{
+		auto compressed = CompressedMeshData();
+		compressed.VertexCount = static_cast<uint32_t>(vertices.size());
+		compressed.IndexCount = static_cast<uint32_t>(indices.size());
+		compressed.Bytes.reserve(vertices.size() * COMPONENT_COUNT * 2 + indices.size() * 2);
+
+		uint32_t previous[COMPONENT_COUNT] = {};
+		for (const auto& vertex : vertices)
+		{
+			uint32_t current[COMPONENT_COUNT] = {};
+			GetComponents(vertex, current);
+
+			for (size_t i = 0; i < COMPONENT_COUNT; ++i)
+			{
+				WriteVarint(compressed.Bytes, current[i] ^ previous[i]);
+				previous[i] = current[i];
+			}
+		}
+
+		uint32_t previous_index = 0;
+		for (auto index : indices)
+		{
+			auto delta = static_cast<int32_t>(index - previous_index);
+			WriteVarint(compressed.Bytes, static_cast<uint32_t>((delta << 1) ^ (delta >> 31)));
+			previous_index = index;
+		}
+
+		compressed.Bytes.shrink_to_fit();
+		return compressed;
+	}
+
+	void Decompress(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) const
+	{
+		vertices.resize(VertexCount);
+		indices.resize(IndexCount);
+		size_t position = 0;
+
+		uint32_t previous[COMPONENT_COUNT] = {};
+		for (auto& vertex : vertices)
+		{
+			for (size_t i = 0; i < COMPONENT_COUNT; ++i)
+				previous[i] ^= ReadVarint(position);
+
+			SetComponents(vertex, previous);
+		}
+
+		uint32_t previous_index = 0;
+		for (auto& index : indices)
+		{
+			auto zigzag = ReadVarint(position);
+			auto delta = static_cast<int32_t>(zigzag >> 1) ^ -static_cast<int32_t>(zigzag & 1);
+			previous_index += static_cast<uint32_t>(delta);
+			index = previous_index;
+		}
+	}
+
+private:
+	inline static constexpr size_t COMPONENT_COUNT = 8;
+
+	static void GetComponents(const Vertex& vertex, uint32_t* components) noexcept
+	{
+		const float values[COMPONENT_COUNT] = {
+			vertex.Position.x, vertex.Position.y, vertex.Position.z,
+			vertex.Normal.x, vertex.Normal.y, vertex.Normal.z,
+			vertex.TexCoord.x, vertex.TexCoord.y
+		};
+		memcpy(components, values, sizeof(values));
+	}
+
+	static void SetComponents(Vertex& vertex, const uint32_t* components) noexcept
+	{
+		float values[COMPONENT_COUNT] = {};
+		memcpy(values, components, sizeof(values));
+		vertex.Position = Vector3(values[0], values[1], values[2]);
+		vertex.Normal = Vector3(values[3], values[4], values[5]);
+		vertex.TexCoord = Vector2(values[6], values[7]);
+	}
+
+	static void WriteVarint(std::vector<uint8_t>& bytes, uint32_t value)
+	{
+		while (value >= 0x80)
+		{
+			bytes.emplace_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		bytes.emplace_back(static_cast<uint8_t>(value));
+	}
+
+	uint32_t ReadVarint(size_t& position) const noexcept
+	{
+		uint32_t value = 0;
+		for (uint32_t shift = 0; position < Bytes.size(); shift += 7)
+		{
+			auto byte = Bytes[position++];
+			value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+			if (!(byte & 0x80)) break;
+		}
+		return value;
+	}
+};
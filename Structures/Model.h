@@ -12,12 +12,15 @@
 #include <type_traits>
 #include <utility>
 #include <vector>
+#include "../GLVK/VK/GeometryPoolVK.h"
 #include "../GLVK/VK/PipelineVK.h"
 #include "../GLVK/VK/UtilsVK.h"
 #include "../Interfaces/IDisposable.h"
 #include "../Interfaces/IGraphics.h"
 #include "../Interfaces/IResourceManager.h"
+#include "../MeshSimplifier.h"
 #include "../Structures/Matrix.h"
+#include "../Structures/MeshData.h"
 #include "../Structures/Vertex.h"
 
 template <Disposable Texture, Disposable Buffer>
@@ -27,25 +30,26 @@ struct Mesh
 public:
 	Mesh() = default;
 
-	Mesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Texture*>& textures, std::vector<uint32_t>& textureIndices, std::shared_ptr<Buffer>& vertexBuffer = nullptr, std::shared_ptr<Buffer>& indexBuffer = nullptr)
+	Mesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Texture*>& textures, std::vector<uint32_t>& textureIndices, const std::shared_ptr<GLVK::VK::GeometryRange>& geometry = nullptr)
 		: Vertices(vertices),
 		Indices(indices),
 		Textures(textures),
 		TextureIndices(textureIndices),
-		VertexBuffer(vertexBuffer),
-		IndexBuffer(indexBuffer)
+		Geometry(geometry)
 	{
 
 	}
 
 	Mesh(const Mesh& mesh)
-		: Vertices(mesh.Vertices), Indices(mesh.Indices), Textures(mesh.Textures), TextureIndices(mesh.TextureIndices)
+		: Vertices(mesh.Vertices), Indices(mesh.Indices), Textures(mesh.Textures), TextureIndices(mesh.TextureIndices), Geometry(mesh.Geometry),
+		Bounds(mesh.Bounds), Sphere(mesh.Sphere), Lods(mesh.Lods), VertexCount(mesh.VertexCount), IndexCount(mesh.IndexCount), CompressedData(mesh.CompressedData)
 	{
 
 	}
 
 	explicit Mesh(Mesh&& mesh) noexcept
-		: Vertices(std::move(mesh.Vertices)), Indices(std::move(mesh.Indices)), Textures(std::move(mesh.Textures)), TextureIndices(std::move(mesh.TextureIndices)), VertexBuffer(std::move(mesh.VertexBuffer)), IndexBuffer(std::move(mesh.IndexBuffer))
+		: Vertices(std::move(mesh.Vertices)), Indices(std::move(mesh.Indices)), Textures(std::move(mesh.Textures)), TextureIndices(std::move(mesh.TextureIndices)), Geometry(std::move(mesh.Geometry)),
+		Bounds(mesh.Bounds), Sphere(mesh.Sphere), Lods(std::move(mesh.Lods)), VertexCount(mesh.VertexCount), IndexCount(mesh.IndexCount), CompressedData(std::move(mesh.CompressedData))
 	{
 	}
 
@@ -57,6 +61,13 @@ public:
 		Indices = mesh.Indices;
 		Textures = mesh.Textures;
 		TextureIndices = mesh.TextureIndices;
+		Geometry = mesh.Geometry;
+		Bounds = mesh.Bounds;
+		Sphere = mesh.Sphere;
+		Lods = mesh.Lods;
+		VertexCount = mesh.VertexCount;
+		IndexCount = mesh.IndexCount;
+		CompressedData = mesh.CompressedData;
 
 		return *this;
 	}
@@ -69,8 +80,13 @@ public:
 		std::swap(Indices, mesh.Indices);
 		std::swap(Textures, mesh.Textures);
 		std::swap(TextureIndices, mesh.TextureIndices);
-		std::swap(VertexBuffer, mesh.VertexBuffer);
-		std::swap(IndexBuffer, mesh.IndexBuffer);
+		std::swap(Geometry, mesh.Geometry);
+		std::swap(Bounds, mesh.Bounds);
+		std::swap(Sphere, mesh.Sphere);
+		std::swap(Lods, mesh.Lods);
+		std::swap(VertexCount, mesh.VertexCount);
+		std::swap(IndexCount, mesh.IndexCount);
+		std::swap(CompressedData, mesh.CompressedData);
 
 		return *this;
 	}
@@ -80,8 +96,7 @@ public:
 		for (auto& texture : Textures)
 			texture->Dispose();
 
-		VertexBuffer->Dispose();
-		IndexBuffer->Dispose();
+		Geometry.reset();
 	}
 
 	template <typename T = glm::mat4>
@@ -129,19 +144,21 @@ public:
 	}
 
 	template <typename T>
-	auto Render(float deltaTime, const T& commandBuffer, uint32_t dynamicOffset, const GLVK::VK::Pipeline* pipeline, const vk::DescriptorSet& descriptorSet, GLVK::VK::PushConstant& pushConstant) -> typename std::enable_if_t<std::is_same_v<T, vk::CommandBuffer>, void>
+	auto Render(float deltaTime, const T& commandBuffer, uint32_t dynamicOffset, const GLVK::VK::Pipeline* pipeline, const vk::DescriptorSet& descriptorSet, const vk::DescriptorSet& textureSet, GLVK::VK::PushConstant& pushConstant) -> typename std::enable_if_t<std::is_same_v<T, vk::CommandBuffer>, void>
 	{
 		uint32_t dynamic_offset = ModelIndex * dynamicOffset;
 
-		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline->GetPipeline(BlendMode::None, ShaderType::BasicShaderForMesh));
+		auto features = pipeline->GetDefaultFeatures(ShaderType::BasicShaderForMesh);
+		if (!TextureIndices.empty()) features |= ToFeatureBit(ShaderFeature::Textured);
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline->GetPipeline(BlendMode::None, ShaderType::BasicShaderForMesh, features));
 
-		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->GetPipelineLayout(ShaderType::BasicShaderForMesh), 0, { descriptorSet }, { dynamic_offset, dynamic_offset });
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->GetPipelineLayout(ShaderType::BasicShaderForMesh), 0, { descriptorSet, textureSet }, { dynamic_offset, dynamic_offset });
 
+		pushConstant.TextureIndex = TextureIndices.empty() ? 0 : TextureIndices.front();
 		pushConstant.ObjectColor = Color;
 		commandBuffer.pushConstants<GLVK::VK::PushConstant>(pipeline->GetPipelineLayout(ShaderType::BasicShaderForMesh), vk::ShaderStageFlagBits::eFragment, 0, { pushConstant });
-		commandBuffer.bindVertexBuffers(0, VertexBuffer->GetBuffer(), { 0 });
-		commandBuffer.bindIndexBuffer(IndexBuffer->GetBuffer(), 0, vk::IndexType::eUint32);
-		commandBuffer.drawIndexed(static_cast<uint32_t>(Indices.size()), 1, 0, 0, 0);
+		auto lod = GetLod(0);
+		commandBuffer.drawIndexed(lod.IndexCount, 1, Geometry->FirstIndex + lod.FirstIndex, static_cast<int32_t>(Geometry->FirstVertex), 0);
 	}
 
 	template <typename T>
@@ -150,12 +167,47 @@ public:
 
 	}
 
+	[[nodiscard]] uint32_t GetLodCount() const noexcept
+	{
+		return Lods.empty() ? 1 : static_cast<uint32_t>(Lods.size());
+	}
+
+	/// <summary>
+	/// A level's index range relative to the mesh's first index. Meshes without generated levels only have level 0, their whole index list.
+	/// </summary>
+	[[nodiscard]] MeshLod GetLod(uint32_t level) const noexcept
+	{
+		if (Lods.empty()) return MeshLod{ 0, Geometry ? Geometry->IndexCount : IndexCount, 0.0f };
+		return Lods[std::min(level, static_cast<uint32_t>(Lods.size() - 1))];
+	}
+
 	std::vector<Vertex> Vertices;
 	std::vector<uint32_t> Indices;
 	std::vector<Texture*> Textures;
 	std::vector<unsigned int> TextureIndices;
-	std::shared_ptr<Buffer> VertexBuffer;
-	std::shared_ptr<Buffer> IndexBuffer;
+
+	/// <summary>
+	/// Where the mesh lives in the shared geometry pool; the pool's buffers are bound once per command buffer.
+	/// </summary>
+	std::shared_ptr<GLVK::VK::GeometryRange> Geometry;
+
+	/// <summary>
+	/// Computed at import and again whenever the vertices are uploaded, so they stay valid after the CPU arrays were released.
+	/// </summary>
+	BoundingBox Bounds = {};
+	BoundingSphere Sphere = {};
+
+	/// <summary>
+	/// Generated at import. Indices holds every level back to back, level 0 first, and the levels share all of the mesh's vertices.
+	/// </summary>
+	std::vector<MeshLod> Lods;
+	uint32_t VertexCount = 0;
+	uint32_t IndexCount = 0;
+
+	/// <summary>
+	/// Only set under MeshDataRetention::Compress; shared between copies of the mesh.
+	/// </summary>
+	std::shared_ptr<const CompressedMeshData> CompressedData;
 	
 	Vector3 Position = Vector3();
 	float ScaleX = 0.0f;
@@ -166,6 +218,11 @@ public:
 	float RotationZ = 0.0f;
 	Vector4 Color = Vector4();
 	uint32_t ModelIndex = 0;
+
+	/// <summary>
+	/// The level drawn last frame, which the next selection starts from. Not copied, since every copy is placed on its own.
+	/// </summary>
+	uint32_t SelectedLod = 0;
 };
 
 template <Disposable Texture, Disposable Buffer>
@@ -234,7 +291,7 @@ public:
 			mesh.Dispose();
 	}
 
-	void Load(std::string_view fileName, IGraphics* graphics, const Vector3& position, const Vector3& scale, const Vector3& rotation, const Vector4& color, bool flipUV = true)
+	void Load(std::string_view fileName, IGraphics* graphics, const Vector3& position, const Vector3& scale, const Vector3& rotation, const Vector4& color, const LodGenerationSettings& lodSettings = {}, bool flipUV = true)
 	{
 		Position = position;
 		ScaleX = scale.x;
@@ -253,7 +310,7 @@ public:
 			throw std::runtime_error(importer.GetErrorString());
 		}
 
-		ProcessNode(scene->mRootNode, scene, this, graphics, fileName);
+		ProcessNode(scene->mRootNode, scene, this, graphics, fileName, lodSettings);
 	}
 
 	template <typename T = glm::mat4>
@@ -301,21 +358,31 @@ public:
 	}
 
 	template <typename T>
-	auto Render(float deltaTime, const T& commandBuffer, uint32_t dynamicOffset, const GLVK::VK::Pipeline* pipeline, const vk::DescriptorSet& descriptorSet, GLVK::VK::PushConstant& pushConstant) -> typename std::enable_if_t<std::is_same_v<T, vk::CommandBuffer>, void>
+	auto Render(float deltaTime, const T& commandBuffer, uint32_t dynamicOffset, const GLVK::VK::Pipeline* pipeline, const vk::DescriptorSet& descriptorSet, const vk::DescriptorSet& textureSet, GLVK::VK::PushConstant& pushConstant) -> typename std::enable_if_t<std::is_same_v<T, vk::CommandBuffer>, void>
 	{
 		uint32_t dynamic_offset = ModelIndex * dynamicOffset;
 
-		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline->GetPipeline(BlendMode::None, ShaderType::BasicShader));
-
-		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->GetPipelineLayout(ShaderType::BasicShader), 0, { descriptorSet }, { dynamic_offset, dynamic_offset });
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->GetPipelineLayout(ShaderType::BasicShader), 0, { descriptorSet, textureSet }, { dynamic_offset, dynamic_offset });
 
+		// Meshes only differ in their texture, which is a push constant into the bound texture table, so only switching
+		// between textured and untextured meshes binds another pipeline.
+		auto default_features = pipeline->GetDefaultFeatures(ShaderType::BasicShader);
+		auto bound_pipeline = vk::Pipeline();
 		for (const auto& mesh : Meshes)
 		{
+			auto features = mesh.TextureIndices.empty() ? default_features : default_features | ToFeatureBit(ShaderFeature::Textured);
+			auto mesh_pipeline = pipeline->GetPipeline(BlendMode::None, ShaderType::BasicShader, features);
+			if (mesh_pipeline != bound_pipeline)
+			{
+				commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, mesh_pipeline);
+				bound_pipeline = mesh_pipeline;
+			}
+
+			pushConstant.TextureIndex = mesh.TextureIndices.empty() ? 0 : mesh.TextureIndices.front();
 			pushConstant.ObjectColor = Color;
 			commandBuffer.pushConstants<GLVK::VK::PushConstant>(pipeline->GetPipelineLayout(ShaderType::BasicShader), vk::ShaderStageFlagBits::eFragment, 0, { pushConstant });
-			commandBuffer.bindVertexBuffers(0, mesh.VertexBuffer->GetBuffer(), { 0 });
-			commandBuffer.bindIndexBuffer(mesh.IndexBuffer->GetBuffer(), 0, vk::IndexType::eUint32);
-			commandBuffer.drawIndexed(static_cast<uint32_t>(mesh.Indices.size()), 1, 0, 0, 0);
+			auto lod = mesh.GetLod(0);
+			commandBuffer.drawIndexed(lod.IndexCount, 1, mesh.Geometry->FirstIndex + lod.FirstIndex, static_cast<int32_t>(mesh.Geometry->FirstVertex), 0);
 		}
 	}
 
@@ -340,7 +407,7 @@ public:
 private:
 	inline static constexpr unsigned int DEFAULT_FLAGS = aiProcess_GenNormals | aiProcess_Triangulate | aiProcess_CalcTangentSpace | aiProcess_JoinIdenticalVertices | aiProcess_SortByPType;
 
-	static Mesh<Texture, Buffer> ProcessMesh(aiMesh* mesh, const aiScene* scene, IGraphics* graphics, std::string_view fileName)
+	static Mesh<Texture, Buffer> ProcessMesh(aiMesh* mesh, const aiScene* scene, IGraphics* graphics, std::string_view fileName, const LodGenerationSettings& lodSettings)
 	{
 		std::vector<Vertex> vertices;
 		std::vector<uint32_t> indices;
@@ -408,6 +475,9 @@ private:
 			}
 		}
 
+		_mesh.Bounds = BoundingBox::FromVertices(vertices);
+		_mesh.Sphere = BoundingSphere::FromVertices(vertices, _mesh.Bounds);
+		_mesh.Lods = GenerateLods(vertices, indices, lodSettings, _mesh.Sphere.Radius);
 		_mesh.Vertices = vertices;
 		_mesh.Indices = indices;
 		_mesh.Textures = textures;
@@ -415,12 +485,12 @@ private:
 		return _mesh;
 	}
 
-	static void ProcessNode(aiNode* node, const aiScene* scene, Model<Texture, Buffer>* model, IGraphics* graphics, std::string_view fileName)
+	static void ProcessNode(aiNode* node, const aiScene* scene, Model<Texture, Buffer>* model, IGraphics* graphics, std::string_view fileName, const LodGenerationSettings& lodSettings)
 	{
 		for (unsigned int i = 0; i < node->mNumMeshes; ++i)
 		{
 			auto mesh = scene->mMeshes[node->mMeshes[i]];
-			Mesh<Texture, Buffer>& _mesh = model->Meshes.emplace_back(ProcessMesh(mesh, scene, graphics, fileName));
+			Mesh<Texture, Buffer>& _mesh = model->Meshes.emplace_back(ProcessMesh(mesh, scene, graphics, fileName, lodSettings));
 			_mesh.Color = model->Color;
 			_mesh.Position = model->Position;
 			_mesh.ScaleX = model->ScaleX;
@@ -433,7 +503,7 @@ private:
 
 		for (unsigned int i = 0; i < node->mNumChildren; ++i)
 		{
-			ProcessNode(node->mChildren[i], scene, model, graphics, fileName);
+			ProcessNode(node->mChildren[i], scene, model, graphics, fileName, lodSettings);
 		}
 	}
 };
\ No newline at end of file
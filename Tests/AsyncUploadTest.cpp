@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "../GLVK/WindowGLVK.h"
+#include "../GLVK/VK/GraphicsEngineVK.h"
+#include "../Interfaces/IResourceManager.h"
+
+// Streams a mesh several times the size of the staging ring while the render loop keeps running, and fails if the loop
+// stalls on the upload. Meant for a software driver such as lavapipe, where the copies are slow enough to span many frames.
+
+namespace
+{
+	// About 75 MB of vertices and 56 MB of indices, four times the default staging ring.
+	constexpr uint32_t GRID_SIZE = 1536;
+	constexpr int WARM_UP_FRAMES = 10;
+	constexpr int MIN_FRAMES_DURING_UPLOAD = 2;
+	constexpr auto UPLOAD_TIMEOUT = std::chrono::seconds(120);
+
+	ShapeData CreateGrid(uint32_t size)
+	{
+		auto shape = ShapeData();
+		shape.Vertices.reserve(static_cast<size_t>(size) * size);
+		shape.Indices.reserve(static_cast<size_t>(size - 1) * (size - 1) * 6);
+
+		for (uint32_t y = 0; y < size; ++y)
+		{
+			for (uint32_t x = 0; x < size; ++x)
+			{
+				auto u = static_cast<float>(x) / static_cast<float>(size - 1);
+				auto v = static_cast<float>(y) / static_cast<float>(size - 1);
+				auto height = std::sin(u * 40.0f) * std::cos(v * 40.0f) * 0.02f;
+				shape.Vertices.emplace_back(Vector3(u - 0.5f, height, v - 0.5f), Vector3(0.0f, 1.0f, 0.0f), Vector2(u, v));
+			}
+		}
+
+		for (uint32_t y = 0; y + 1 < size; ++y)
+		{
+			for (uint32_t x = 0; x + 1 < size; ++x)
+			{
+				auto corner = y * size + x;
+				shape.Indices.insert(shape.Indices.end(), { corner, corner + size, corner + 1, corner + 1, corner + size, corner + size + 1 });
+			}
+		}
+
+		return shape;
+	}
+}
+
+int main()
+{
+	using namespace std::chrono;
+
+	auto window = std::make_unique<GLVK::Window>(L"Async Upload Test", 640, 480, false);
+	auto resource_manager = std::make_unique<IResourceManager>();
+	auto graphics = std::unique_ptr<GLVK::VK::GraphicsEngine>();
+	auto is_passed = false;
+
+	try
+	{
+		window->Initialize();
+
+		auto settings = GLVK::VK::GraphicsSettings();
+		settings.GeometryPoolVertexCount = 4 * 1024 * 1024;
+		settings.GeometryPoolIndexCount = 16 * 1024 * 1024;
+		settings.PipelineCachePath.clear();
+		settings.PipelineKeysPath.clear();
+		graphics = std::make_unique<GLVK::VK::GraphicsEngine>(reinterpret_cast<GLFWwindow*>(window->GetHandle()), window->GetWidth(), window->GetHeight(), resource_manager.get(), settings);
+		window->Setup(graphics.get());
+
+		auto meshes = std::vector<GLVK::VK::MESH*>();
+		auto cube = graphics->CreateMesh(PrimitiveType::Cube, Vector3::Zero(), Vector3(2.0f), Vector3(30.0f), Vector4(1.0f, 0.0f, 1.0f, 1.0f));
+		meshes.emplace_back(dynamic_cast<GLVK::VK::MESH*>(std::get<0>(cube)));
+		graphics->Initialize();
+
+		auto last_frame_time = steady_clock::now();
+		auto render_frame = [&]() {
+			auto now = steady_clock::now();
+			glfwPollEvents();
+			graphics->Update(duration<float, seconds::period>(now - last_frame_time).count());
+			graphics->BeginDraw();
+			for (auto* mesh : meshes)
+				graphics->Draw(mesh);
+			graphics->EndDraw();
+			graphics->Render();
+			last_frame_time = now;
+		};
+
+		for (auto i = 0; i < WARM_UP_FRAMES; ++i)
+			render_frame();
+
+		auto grid = graphics->CreateMesh(CreateGrid(GRID_SIZE), Vector3(0.0f, 1.0f, 0.0f), Vector3(8.0f), Vector3::Zero(), Vector4(0.5f, 1.0f, 0.4f, 1.0f));
+		auto* grid_mesh = meshes.emplace_back(dynamic_cast<GLVK::VK::MESH*>(std::get<0>(grid)));
+
+		// Frames are timed from the moment the upload is handed over until the grid is drawn.
+		auto upload_start = steady_clock::now();
+		auto previous_frame_end = upload_start;
+		auto longest_frame = duration<double, std::milli>(0.0);
+		auto frame_count = 0;
+		while (graphics->IsUploadPending(*grid_mesh))
+		{
+			if (steady_clock::now() - upload_start > UPLOAD_TIMEOUT)
+				throw std::runtime_error("The upload did not finish in time.");
+
+			render_frame();
+			auto frame_end = steady_clock::now();
+			longest_frame = std::max(longest_frame, duration<double, std::milli>(frame_end - previous_frame_end));
+			previous_frame_end = frame_end;
+			++frame_count;
+		}
+		auto upload_time = duration<double, std::milli>(steady_clock::now() - upload_start);
+
+		// The grid is drawn from the next frame on; it is the only mesh besides the cube, so it adds exactly one instanced draw.
+		render_frame();
+		auto is_grid_drawn = graphics->GetDrawCallCount() == 2;
+		for (auto i = 0; i < WARM_UP_FRAMES; ++i)
+			render_frame();
+
+		std::cout << "Upload: " << upload_time.count() << " ms, " << frame_count << " frames presented meanwhile, longest frame " << longest_frame.count() << " ms\n";
+
+		// A loop that blocks on the upload presents at most one frame in that time, and that frame takes about as long as the upload.
+		is_passed = frame_count >= MIN_FRAMES_DURING_UPLOAD && longest_frame < upload_time * 0.5 && is_grid_drawn;
+		if (!is_grid_drawn)
+			std::cout << "The grid was not drawn after its upload was submitted.\n";
+	}
+	catch (const std::exception& ex)
+	{
+		std::cout << ex.what() << '\n';
+		is_passed = false;
+	}
+
+	resource_manager.reset();
+	graphics.reset();
+	window.reset();
+
+	std::cout << (is_passed ? "PASSED" : "FAILED") << '\n';
+	return is_passed ? 0 : 1;
+}
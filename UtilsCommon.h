@@ -21,9 +21,25 @@ enum class BlendMode
 
 enum class ShaderType
 {
-	BasicShader, BasicShaderForMesh
+	BasicShader, BasicShaderForMesh, Instanced, FrustumCull, HiZBuild, DepthPrePass
 };
 
+/// <summary>
+/// Optional parts of the basic shaders. Each one is a boolean specialization constant whose constant_id is its value here, so a
+/// permutation compiles the branches it does not use out. Skinned is reserved, since there is no bone data yet.
+/// </summary>
+enum class ShaderFeature : uint32_t
+{
+	Textured, Lit, Skinned, AlphaTest, Instanced, MeshTransform, End
+};
+
+using ShaderFeatures = uint32_t;
+
+[[nodiscard]] constexpr ShaderFeatures ToFeatureBit(ShaderFeature feature) noexcept
+{
+	return 1u << static_cast<uint32_t>(feature);
+}
+
 enum class PrimitiveType
 {
 	Board, Cube, Rect, Sphere, Cylinder, Capsule
@@ -40,7 +56,6 @@ struct DynamicBufferModels
 {
 	std::vector<uint32_t> ModelIndices;
 	std::vector<glm::mat4> Models;
-	glm::mat4* Buffer;
 };
 
 struct ShapeData
@@ -4,14 +4,15 @@ import shutil
 
 os.chdir('./GLVK/VK/Shaders')
 os.system('glslangValidator -V basicShader.vert')
-os.system('glslangValidator -V basicShader_mesh.vert -o basicShader_mesh.spv')
 os.system('glslangValidator -V basicShader.frag')
+os.system('glslangValidator -V frustumCull.comp -o frustum_cull.spv')
+os.system('glslangValidator -V -DOCCLUSION frustumCull.comp -o occlusion_cull.spv')
+os.system('glslangValidator -V hizBuild.comp -o hiz_build.spv')
+os.system('glslangValidator -V depthPrePass.vert -o depth_prepass.spv')
 os.chdir('../../../')
 shutil.copyfile('./GLVK/VK/Shaders/vert.spv', 'x64/Debug/GLVK/VK/Shaders/vert.spv')
-shutil.copyfile('./GLVK/VK/Shaders/basicShader_mesh.spv', 'x64/Debug/GLVK/VK/Shaders/basicShader_mesh.spv')
 shutil.copyfile('./GLVK/VK/Shaders/frag.spv', 'x64/Debug/GLVK/VK/Shaders/frag.spv')
-
-if os.path.isdir('cmake-build-debug'):
-    shutil.copyfile('./GLVK/VK/Shaders/vert.spv', 'cmake-build-debug/GLVK/VK/Shaders/vert.spv')
-    shutil.copyfile('./GLVK/VK/Shaders/basicShader_mesh.spv', 'cmake-build-debug/GLVK/VK/Shaders/basicShader_mesh.spv')
-    shutil.copyfile('./GLVK/VK/Shaders/frag.spv', 'cmake-build-debug/GLVK/VK/Shaders/frag.spv')
\ No newline at end of file
+shutil.copyfile('./GLVK/VK/Shaders/frustum_cull.spv', 'x64/Debug/GLVK/VK/Shaders/frustum_cull.spv')
+shutil.copyfile('./GLVK/VK/Shaders/occlusion_cull.spv', 'x64/Debug/GLVK/VK/Shaders/occlusion_cull.spv')
+shutil.copyfile('./GLVK/VK/Shaders/hiz_build.spv', 'x64/Debug/GLVK/VK/Shaders/hiz_build.spv')
+shutil.copyfile('./GLVK/VK/Shaders/depth_prepass.spv', 'x64/Debug/GLVK/VK/Shaders/depth_prepass.spv')
\ No newline at end of file